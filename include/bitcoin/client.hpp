@@ -16,9 +16,25 @@
 
 #include <bitcoin/system.hpp>
 #include <bitcoin/protocol.hpp>
+#include <bitcoin/client/asio_client.hpp>
+#include <bitcoin/client/block_decoder.hpp>
+#include <bitcoin/client/coin_selection.hpp>
+#include <bitcoin/client/confirmation_tracker.hpp>
 #include <bitcoin/client/define.hpp>
+#include <bitcoin/client/double_spend_detector.hpp>
+#include <bitcoin/client/gateway.hpp>
 #include <bitcoin/client/history.hpp>
+#include <bitcoin/client/index_cache.hpp>
 #include <bitcoin/client/obelisk_client.hpp>
+#include <bitcoin/client/prevout_resolver.hpp>
+#include <bitcoin/client/request_ids.hpp>
+#include <bitcoin/client/response_cache.hpp>
+#include <bitcoin/client/sharded_client.hpp>
+#include <bitcoin/client/shared_cache.hpp>
+#include <bitcoin/client/subscription_pool.hpp>
+#include <bitcoin/client/time_index.hpp>
+#include <bitcoin/client/transaction_graph.hpp>
+#include <bitcoin/client/unspent_set.hpp>
 #include <bitcoin/client/version.hpp>
 
 #endif
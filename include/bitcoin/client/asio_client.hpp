@@ -0,0 +1,230 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_ASIO_CLIENT_HPP
+#define LIBBITCOIN_CLIENT_ASIO_CLIENT_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <bitcoin/system.hpp>
+#include <bitcoin/client/define.hpp>
+#include <bitcoin/client/history.hpp>
+#include <bitcoin/client/obelisk_client.hpp>
+
+namespace libbitcoin {
+namespace client {
+
+/// Runs the client on an asio io context, watching its socket descriptors in
+/// place of wait() and monitor() (see obelisk_client::process_ready), with
+/// fetches completed through asio completion tokens, such as callbacks,
+/// use_future, yield_context, or use_awaitable (C++20). Each fetch fails with
+/// error::channel_timeout at its deadline, which is enforced by the client
+/// (see obelisk_client::set_request_timeout), releasing its handler and
+/// request id. The client and this adapter must
+/// only be used from the io context thread, and the adapter must outlive its
+/// operations. Subscriptions of the client are notified from the io context.
+/// Where descriptors are not supported by asio the client is polled.
+class BCC_API asio_client
+{
+public:
+    /// Adapt the connected client, setting its request timeout to the
+    /// deadline of each fetch.
+    asio_client(system::asio::service& service, obelisk_client& client,
+        uint32_t timeout_milliseconds=30000);
+
+    /// Stop watching the client.
+    ~asio_client();
+
+    /// This class is not copyable.
+    asio_client(const asio_client&) = delete;
+    void operator=(const asio_client&) = delete;
+
+    /// Start watching the client's sockets and timers (after subscribing to
+    /// the block and transaction streams).
+    void start();
+
+    /// Stop watching the client, leaving its descriptors open.
+    void stop();
+
+    /// Process the client promptly, as after a request is made directly on
+    /// the client from the io context thread.
+    void schedule();
+
+    // Fetchers.
+    //-------------------------------------------------------------------------
+
+    template <typename Token>
+    BOOST_ASIO_INITFN_RESULT_TYPE(Token, void(system::code, size_t))
+    async_fetch_last_height(Token&& token)
+    {
+        return initiate<size_t>(std::forward<Token>(token),
+            [this](obelisk_client::height_handler handler)
+            {
+                client_.blockchain_fetch_last_height(handler);
+            });
+    }
+
+    template <typename Token>
+    BOOST_ASIO_INITFN_RESULT_TYPE(Token, void(system::code, size_t))
+    async_fetch_block_height(const system::hash_digest& block_hash,
+        Token&& token)
+    {
+        return initiate<size_t>(std::forward<Token>(token),
+            [this, block_hash](obelisk_client::height_handler handler)
+            {
+                client_.blockchain_fetch_block_height(handler, block_hash);
+            });
+    }
+
+    template <typename Token>
+    BOOST_ASIO_INITFN_RESULT_TYPE(Token,
+        void(system::code, system::chain::header))
+    async_fetch_block_header(uint32_t height, Token&& token)
+    {
+        return initiate<system::chain::header>(std::forward<Token>(token),
+            [this, height](obelisk_client::block_header_handler handler)
+            {
+                client_.blockchain_fetch_block_header(handler, height);
+            });
+    }
+
+    template <typename Token>
+    BOOST_ASIO_INITFN_RESULT_TYPE(Token,
+        void(system::code, system::chain::block))
+    async_fetch_block(uint32_t height, Token&& token)
+    {
+        return initiate<system::chain::block>(std::forward<Token>(token),
+            [this, height](obelisk_client::block_handler handler)
+            {
+                client_.blockchain_fetch_block(handler, height);
+            });
+    }
+
+    template <typename Token>
+    BOOST_ASIO_INITFN_RESULT_TYPE(Token,
+        void(system::code, system::chain::transaction))
+    async_fetch_transaction(const system::hash_digest& tx_hash,
+        Token&& token)
+    {
+        return initiate<system::chain::transaction>(
+            std::forward<Token>(token),
+            [this, tx_hash](obelisk_client::transaction_handler handler)
+            {
+                client_.blockchain_fetch_transaction2(handler, tx_hash);
+            });
+    }
+
+    template <typename Token>
+    BOOST_ASIO_INITFN_RESULT_TYPE(Token,
+        void(system::code, client::history::list))
+    async_fetch_history(const system::hash_digest& key, uint32_t from_height,
+        Token&& token)
+    {
+        return initiate<client::history::list>(std::forward<Token>(token),
+            [this, key, from_height](obelisk_client::history_handler handler)
+            {
+                client_.blockchain_fetch_history4(handler, key, from_height);
+            });
+    }
+
+    template <typename Token>
+    BOOST_ASIO_INITFN_RESULT_TYPE(Token, void(system::code, bool))
+    async_broadcast(const system::chain::transaction& tx, Token&& token)
+    {
+        return initiate<bool>(std::forward<Token>(token),
+            [this, tx](std::function<void(const system::code&, bool)> handler)
+            {
+                client_.transaction_pool_broadcast(
+                    [handler](const system::code& ec)
+                    {
+                        handler(ec, !ec);
+                    }, tx);
+            });
+    }
+
+private:
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+    typedef boost::asio::posix::stream_descriptor descriptor;
+    typedef std::unique_ptr<descriptor> descriptor_ptr;
+#endif
+
+    // Complete the fetch through the executor of its handler.
+    template <typename Handler, typename Value>
+    void complete(std::shared_ptr<Handler> handler, const system::code& ec,
+        const Value& value)
+    {
+        const auto executor = boost::asio::get_associated_executor(*handler,
+            service_.get_executor());
+
+        boost::asio::dispatch(executor, [handler, ec, value]()
+        {
+            (*handler)(ec, value);
+        });
+    }
+
+    // The handler of the token, which may be move only, is shared by the
+    // client handler of the fetch, which the client completes once, by its
+    // response or at its deadline.
+    template <typename Value, typename Token, typename Fetch>
+    BOOST_ASIO_INITFN_RESULT_TYPE(Token, void(system::code, Value))
+    initiate(Token&& token, Fetch fetch)
+    {
+        typedef void signature(system::code, Value);
+        typedef boost::asio::async_completion<Token, signature> completion;
+        typedef typename completion::completion_handler_type handler_type;
+
+        completion init(token);
+        const auto handler = std::make_shared<handler_type>(
+            std::move(init.completion_handler));
+
+        fetch([this, handler](const system::code& ec, const Value& value)
+        {
+            complete(handler, ec, value);
+        });
+
+        schedule();
+        return init.result.get();
+    }
+
+    // Process the client and rearm the timer.
+    void process();
+    void expire(const boost::system::error_code& ec);
+
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+    void watch(descriptor& socket);
+#endif
+
+    system::asio::service& service_;
+    obelisk_client& client_;
+    boost::asio::steady_timer timer_;
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+    std::vector<descriptor_ptr> descriptors_;
+#endif
+    bool scheduled_;
+    bool stopped_;
+};
+
+} // namespace client
+} // namespace libbitcoin
+
+#endif
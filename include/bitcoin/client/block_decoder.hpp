@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_BLOCK_DECODER_HPP
+#define LIBBITCOIN_CLIENT_BLOCK_DECODER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <bitcoin/system.hpp>
+#include <bitcoin/client/define.hpp>
+
+namespace libbitcoin {
+namespace client {
+
+/// Decodes block responses on worker threads. Each decode is reserved when
+/// the block is requested and its handler is invoked by deliver() in the
+/// order of reservation, regardless of the order of responses or of decode
+/// completion (see obelisk_client::set_decode_threads). The merkle root of
+/// each decoded block may also be verified by the workers. Thread safe.
+class BCC_API block_decoder
+{
+public:
+    typedef std::function<void(const system::code&,
+        const system::chain::block&)> block_handler;
+
+    /// Start the given number of worker threads (at least one), optionally
+    /// failing blocks with error::merkle_mismatch if the merkle root of their
+    /// transactions does not match the header.
+    block_decoder(size_t threads, bool verify_merkle=false);
+
+    /// Stop and join the workers, undelivered handlers are not invoked.
+    ~block_decoder();
+
+    /// This class is not copyable.
+    block_decoder(const block_decoder&) = delete;
+    void operator=(const block_decoder&) = delete;
+
+    /// Reserve the next position in delivery order for the handler.
+    uint64_t reserve(block_handler handler);
+
+    /// Decode a block response (error code followed by the block).
+    void decode(uint64_t ticket, system::data_chunk&& payload);
+
+    /// Complete the reservation with an error and no decode.
+    void fail(uint64_t ticket, const system::code& ec);
+
+    /// Invoke the handlers of completed decodes that are not preceded by an
+    /// incomplete reservation, returning the number invoked.
+    size_t deliver();
+
+    /// Complete all reservations with the error, including those in
+    /// decode, and deliver them all.
+    void clear(const system::code& ec);
+
+    /// The number of reservations not yet delivered.
+    size_t pending() const;
+
+    /// The size of the payloads held for reservations not yet delivered.
+    size_t bytes() const;
+
+    /// The number of worker threads.
+    size_t threads() const;
+
+private:
+    struct slot
+    {
+        block_handler handler;
+        system::code ec;
+        system::chain::block block;
+        size_t size;
+        bool complete;
+    };
+
+    typedef std::shared_ptr<slot> slot_ptr;
+    typedef std::pair<slot_ptr, system::data_chunk> job;
+
+    // Requires mutex_ to be locked.
+    slot_ptr find(uint64_t ticket) const;
+
+    void work();
+
+    const bool verify_merkle_;
+
+    // Reservations from first_ in delivery order.
+    std::deque<slot_ptr> slots_;
+    uint64_t first_;
+    size_t bytes_;
+    std::deque<job> jobs_;
+    bool stopped_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace client
+} // namespace libbitcoin
+
+#endif
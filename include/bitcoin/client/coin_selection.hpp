@@ -0,0 +1,93 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_COIN_SELECTION_HPP
+#define LIBBITCOIN_CLIENT_COIN_SELECTION_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <bitcoin/system.hpp>
+#include <bitcoin/client/define.hpp>
+
+namespace libbitcoin {
+namespace client {
+
+/// Coin selection over a large unspent output set. The set is referenced, not
+/// copied, and indexed by value as 32 bit positions, so it must outlive the
+/// selection and not change during it. Not thread safe.
+class BCC_API coin_selection
+{
+public:
+    typedef std::chrono::steady_clock::time_point time_point;
+    typedef std::vector<uint32_t> positions;
+
+    /// Index the unspent outputs by value.
+    coin_selection(const system::chain::points_value& unspent);
+
+    /// Use an index maintained by the owner of the set, of the positions of
+    /// its nonzero outputs by descending value, with their total value. The
+    /// index is referenced, not copied.
+    coin_selection(const system::chain::points_value& unspent,
+        const positions& descending, uint64_t value);
+
+    coin_selection(const coin_selection&) = delete;
+
+    /// Select outputs of at least the target value. A selection exceeding the
+    /// target by no more than cost_of_change (requiring no change output) is
+    /// sought by branch and bound for up to half of the budget, otherwise the
+    /// knapsack approximation is used. Returns false if the value is
+    /// insufficient.
+    bool select(system::chain::points_value& out, uint64_t target,
+        uint64_t cost_of_change,
+        const system::asio::milliseconds& budget) const;
+
+    /// Depth first search for the selection in [target, target +
+    /// cost_of_change] with the least excess. Returns false if none is found
+    /// by the deadline or within max_tries.
+    bool branch_and_bound(system::chain::points_value& out, uint64_t target,
+        uint64_t cost_of_change, const time_point& deadline,
+        size_t max_tries=100000) const;
+
+    /// The lesser excess of the smallest single output covering the target
+    /// and a randomized approximation of the best subset of smaller outputs.
+    /// Returns false if the value is insufficient.
+    bool knapsack(system::chain::points_value& out, uint64_t target,
+        const time_point& deadline, size_t iterations=1000) const;
+
+    /// The total value of the unspent outputs.
+    uint64_t value() const;
+
+private:
+    uint64_t value_at(uint32_t position) const;
+    void emit(system::chain::points_value& out,
+        const positions& selected) const;
+
+    const system::chain::points_value& unspent_;
+
+    // Positions of nonzero outputs by descending value, if indexed here.
+    positions sorted_;
+    const positions& descending_;
+    uint64_t value_;
+};
+
+} // namespace client
+} // namespace libbitcoin
+
+#endif
@@ -0,0 +1,107 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_CONFIRMATION_TRACKER_HPP
+#define LIBBITCOIN_CLIENT_CONFIRMATION_TRACKER_HPP
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <bitcoin/system.hpp>
+#include <bitcoin/client/define.hpp>
+
+namespace libbitcoin {
+namespace client {
+
+/// Tracks the confirmation depth of transactions using only the block stream,
+/// so that any number of transactions may be awaited without server queries.
+/// Feed with obelisk_client::subscribe_block (height overload). Thread safe.
+class BCC_API confirmation_tracker
+{
+public:
+    static const size_t unconfirmed = bc::max_size_t;
+
+    /// Invoked once for each requested depth as it is reached, where depth one
+    /// is the block of inclusion. Invoked with zero depth if the transaction
+    /// is reorganized out after having been reported, in which case its
+    /// depths are reported again once it is reconfirmed.
+    typedef std::function<void(const system::code&, size_t height,
+        size_t depth)> confirmation_handler;
+
+    /// Construct a tracker retaining the given number of recent block hashes
+    /// for detection of reorganizations.
+    confirmation_tracker(size_t reorganization_limit=100);
+
+    /// Track a transaction until all of the depths have been reported.
+    /// The height of an already confirmed transaction may be provided.
+    void track(const system::hash_digest& tx_hash,
+        const std::vector<size_t>& depths, confirmation_handler handler,
+        size_t height=unconfirmed);
+
+    /// Stop tracking the transaction, without invoking its handler.
+    bool untrack(const system::hash_digest& tx_hash);
+
+    /// Handle a block announced by the block stream.
+    void handle_block(size_t height, const system::chain::block& block);
+
+    /// The height of the most recent block, or unconfirmed if none.
+    size_t top_height() const;
+
+    /// The number of transactions being tracked.
+    size_t size() const;
+
+private:
+    struct entry
+    {
+        size_t height;
+        std::vector<size_t> depths;
+        size_t reported;
+        confirmation_handler handler;
+    };
+
+    struct notification
+    {
+        confirmation_handler handler;
+        size_t height;
+        size_t depth;
+    };
+
+    typedef std::unordered_map<system::hash_digest, entry> entry_map;
+    typedef std::map<size_t, system::hash_list> height_map;
+    typedef std::vector<notification> notifications;
+
+    // These require mutex_ to be exclusively locked.
+    void confirm(const system::hash_digest& tx_hash, entry& value,
+        size_t height);
+    void reorganize(size_t height, notifications& out);
+    void report(notifications& out);
+
+    const size_t reorganization_limit_;
+    size_t top_;
+    entry_map entries_;
+    height_map confirmed_;
+    std::map<size_t, system::hash_digest> blocks_;
+    mutable system::upgrade_mutex mutex_;
+};
+
+} // namespace client
+} // namespace libbitcoin
+
+#endif
@@ -0,0 +1,137 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_DOUBLE_SPEND_DETECTOR_HPP
+#define LIBBITCOIN_CLIENT_DOUBLE_SPEND_DETECTOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <bitcoin/system.hpp>
+#include <bitcoin/client/define.hpp>
+
+namespace libbitcoin {
+namespace client {
+
+/// Detects conflicting spends of watched outpoints using only the transaction
+/// and block streams. Every spend seen on the transaction stream is indexed in
+/// a fixed capacity open addressing table of 16 byte slots, so that memory is
+/// bounded and each input costs constant time. Once full, the oldest spend is
+/// evicted for each new spend, as spends that never confirm would otherwise
+/// fill the table. Feed with obelisk_client::subscribe_transaction and
+/// subscribe_block. Thread safe.
+class BCC_API double_spend_detector
+{
+public:
+    /// Invoked with the watched outpoint, its watched spender and the
+    /// conflicting spender. The conflicting spender is null_hash if it was
+    /// seen before the watch, as the index retains only a short identifier.
+    typedef std::function<void(const system::chain::output_point& point,
+        const system::hash_digest& spender,
+        const system::hash_digest& conflict)> conflict_handler;
+
+    /// Construct a detector indexing up to capacity unconfirmed spends.
+    double_spend_detector(size_t capacity=1048576);
+
+    /// Watch the outpoints spent by an incoming payment until confirmed.
+    void watch(const system::chain::transaction& payment,
+        conflict_handler handler);
+
+    /// Watch an outpoint spent by the given transaction until confirmed.
+    void watch(const system::chain::output_point& point,
+        const system::hash_digest& spender, conflict_handler handler);
+
+    /// Stop watching the outpoint, without invoking its handler.
+    bool unwatch(const system::chain::output_point& point);
+
+    /// Handle a transaction announced by the transaction stream.
+    void handle_transaction(const system::chain::transaction& tx);
+
+    /// Handle a block announced by the block stream. Confirmed spends are
+    /// removed from the index, and watches of confirmed outpoints end.
+    void handle_block(const system::chain::block& block);
+
+    /// The number of unconfirmed spends indexed.
+    size_t size() const;
+
+    /// The maximum number of unconfirmed spends indexed.
+    size_t capacity() const;
+
+    /// The number of unconfirmed spends evicted to index newer spends.
+    size_t evicted() const;
+
+    /// The number of outpoints watched.
+    size_t watched() const;
+
+private:
+    // Key zero denotes an empty slot.
+    struct slot
+    {
+        uint64_t key;
+        uint64_t spender;
+    };
+
+    struct watch_entry
+    {
+        system::hash_digest spender;
+        conflict_handler handler;
+    };
+
+    struct notification
+    {
+        conflict_handler handler;
+        system::chain::output_point point;
+        system::hash_digest spender;
+        system::hash_digest conflict;
+    };
+
+    typedef std::unordered_map<system::chain::output_point, watch_entry>
+        watch_map;
+    typedef std::vector<notification> notifications;
+
+    static uint64_t key(const system::chain::output_point& point);
+    static uint64_t short_id(const system::hash_digest& hash);
+
+    // These require mutex_ to be exclusively locked.
+    size_t bucket(uint64_t key) const;
+    size_t find(uint64_t key) const;
+    void insert(uint64_t key, uint64_t spender);
+    void erase(size_t index);
+    void evict();
+    void add_watch(const system::chain::output_point& point,
+        const system::hash_digest& spender, conflict_handler handler,
+        notifications& out);
+
+    const size_t capacity_;
+    const size_t mask_;
+    const size_t shift_;
+    std::vector<slot> slots_;
+    size_t size_;
+    size_t evicted_;
+    std::deque<uint64_t> insertions_;
+    watch_map watches_;
+    mutable system::upgrade_mutex mutex_;
+};
+
+} // namespace client
+} // namespace libbitcoin
+
+#endif
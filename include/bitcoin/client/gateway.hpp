@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_GATEWAY_HPP
+#define LIBBITCOIN_CLIENT_GATEWAY_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <bitcoin/protocol.hpp>
+#include <bitcoin/system.hpp>
+#include <bitcoin/client/asio_client.hpp>
+#include <bitcoin/client/define.hpp>
+#include <bitcoin/client/obelisk_client.hpp>
+#include <bitcoin/client/response_cache.hpp>
+
+namespace libbitcoin {
+namespace client {
+
+/// A local server for downstream clients, speaking the server's query and
+/// key subscription protocol on a router socket and served by one upstream
+/// connection. Query responses are cached for a time to live and concurrent
+/// identical queries are sent upstream once, while broadcasts and validations
+/// are forwarded. An upstream request that is not answered by its deadline
+/// answers each of its waiters with error::channel_timeout. Each key is
+/// subscribed upstream once, with notifications fanned out to its downstream
+/// subscribers, which must renew within the subscription expiration. The
+/// gateway is run on the io context (see asio_client), and must only be used
+/// from its thread.
+class BCC_API gateway
+{
+public:
+    gateway(system::asio::service& service, size_t cache_capacity=100000000,
+        uint32_t cache_time_to_live_milliseconds=1000,
+        uint32_t subscription_expiration_minutes=10,
+        uint32_t request_timeout_milliseconds=30000);
+
+    /// Stop the gateway.
+    ~gateway();
+
+    /// This class is not copyable.
+    gateway(const gateway&) = delete;
+    void operator=(const gateway&) = delete;
+
+    /// Connect upstream and bind the downstream endpoint, false on failure.
+    bool start(const connection_settings& upstream,
+        const system::config::endpoint& downstream);
+
+    /// Stop serving downstream clients.
+    void stop();
+
+    /// The number of queries answered from the cache.
+    size_t cache_hits() const;
+
+    /// The number of queries joined to an identical query in flight.
+    size_t coalesced() const;
+
+    /// The number of queries sent upstream.
+    size_t upstream_requests() const;
+
+    /// The number of keys subscribed upstream.
+    size_t upstream_subscriptions() const;
+
+private:
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    // The downstream client of a request.
+    struct requester
+    {
+        system::data_chunk identity;
+        bool delimited;
+        uint32_t id;
+    };
+
+    struct subscriber
+    {
+        requester origin;
+        time_point expiry;
+        bool confirmed;
+    };
+
+    struct key_subscription
+    {
+        uint32_t upstream;
+        bool subscribed;
+        std::vector<subscriber> subscribers;
+    };
+
+    typedef std::unordered_map<std::string, std::vector<requester>>
+        inflight_map;
+    typedef std::unordered_map<system::hash_digest, key_subscription>
+        subscription_map;
+
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+    typedef boost::asio::posix::stream_descriptor descriptor;
+#endif
+
+    static bool is_query(const std::string& command);
+
+    // Receive all requests ready on the router socket.
+    void receive();
+    void schedule();
+    void handle(const requester& origin, const std::string& command,
+        const system::data_chunk& payload);
+
+    void query(const requester& origin, const std::string& command,
+        const system::data_chunk& payload);
+    void forward(const requester& origin, const std::string& command,
+        const system::data_chunk& payload);
+    void subscribe(const requester& origin, const system::data_chunk& payload);
+    void unsubscribe(const requester& origin,
+        const system::data_chunk& payload);
+    void notify(const system::hash_digest& key, const system::code& ec,
+        uint16_t sequence, size_t height, const system::hash_digest& tx_hash);
+    void release(const system::hash_digest& key);
+
+    void send(const requester& origin, const std::string& command,
+        const system::data_chunk& payload);
+
+    // Expire subscribers that have not renewed.
+    void sweep(const boost::system::error_code& ec);
+
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+    void watch();
+#endif
+
+    system::asio::service& service_;
+    obelisk_client client_;
+    asio_client adapter_;
+    response_cache cache_;
+    const std::chrono::minutes expiration_;
+
+    protocol::zmq::context context_;
+    protocol::zmq::socket router_;
+    boost::asio::steady_timer timer_;
+
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+    std::unique_ptr<descriptor> descriptor_;
+#endif
+
+    inflight_map inflight_;
+    subscription_map subscriptions_;
+    size_t cache_hits_;
+    size_t coalesced_;
+    size_t upstream_requests_;
+    bool scheduled_;
+    bool stopped_;
+};
+
+} // namespace client
+} // namespace libbitcoin
+
+#endif
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_INDEX_CACHE_HPP
+#define LIBBITCOIN_CLIENT_INDEX_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <bitcoin/system.hpp>
+#include <bitcoin/client/define.hpp>
+
+namespace libbitcoin {
+namespace client {
+
+/// Block hash to height and txid to (height, position) indexes, filled from
+/// query responses and the block stream (see obelisk_client::set_index_cache).
+/// Entries within the reorganization limit of the top block are invalidated
+/// upon reorganization, and only entries below it are persisted. Nothing is
+/// cached or served until the block stream has set the top height, streamed
+/// transactions are cached only once looked up, and the oldest entries are
+/// evicted beyond the capacity.
+/// Thread safe.
+class BCC_API index_cache
+{
+public:
+    /// Construct a cache treating entries deeper than the given number of
+    /// blocks as final, holding up to capacity blocks and transactions.
+    index_cache(size_t reorganization_limit=100, size_t capacity=1000000);
+
+    /// The height of the block, false if not cached.
+    bool find_height(const system::hash_digest& block_hash,
+        size_t& out_height) const;
+
+    /// The height and position of the transaction, false if not cached, in
+    /// which case the transaction is cached once seen in the block stream.
+    bool find_transaction(const system::hash_digest& tx_hash,
+        size_t& out_height, size_t& out_position) const;
+
+    /// Cache a block height response.
+    void store_height(const system::hash_digest& block_hash, size_t height);
+
+    /// Cache a transaction index response.
+    void store_transaction(const system::hash_digest& tx_hash, size_t height,
+        size_t position);
+
+    /// Handle a block announced by the block stream, caching its hash and
+    /// looked up transactions, and invalidating entries of reorganized blocks.
+    void handle_block(size_t height, const system::chain::block& block);
+
+    /// Write the final entries to the file, false on failure.
+    bool save(const std::string& path) const;
+
+    /// Read entries from a file written by save, false on failure.
+    bool load(const std::string& path);
+
+    /// The number of blocks and transactions cached.
+    size_t size() const;
+
+private:
+    struct position
+    {
+        uint32_t height;
+        uint32_t index;
+    };
+
+    typedef std::unordered_map<system::hash_digest, uint32_t> height_map;
+    typedef std::unordered_map<system::hash_digest, position> position_map;
+    typedef std::unordered_set<system::hash_digest> hash_set;
+    typedef std::deque<system::hash_digest> hash_queue;
+
+    // This requires mutex_ to be locked.
+    bool find(const system::hash_digest& tx_hash, size_t& out_height,
+        size_t& out_position) const;
+
+    // These require mutex_ to be exclusively locked.
+    void admit(const system::hash_digest& hash);
+    void want(const system::hash_digest& tx_hash) const;
+    bool is_final(size_t height) const;
+    void track(size_t height, const system::hash_digest& hash);
+    void invalidate(size_t height);
+    void prune();
+
+    const size_t reorganization_limit_;
+    const size_t capacity_;
+    size_t top_;
+    height_map heights_;
+    position_map transactions_;
+
+    // Keys in the order cached, and transactions looked up but not cached.
+    hash_queue admitted_;
+    mutable hash_set wanted_;
+    mutable hash_queue wanted_order_;
+
+    // Keys cached at each height not yet final, and recent block hashes.
+    std::map<size_t, system::hash_list> recent_;
+    std::map<size_t, system::hash_digest> blocks_;
+    mutable system::upgrade_mutex mutex_;
+};
+
+} // namespace client
+} // namespace libbitcoin
+
+#endif
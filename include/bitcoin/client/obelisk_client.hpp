@@ -19,9 +19,24 @@
 #ifndef LIBBITCOIN_CLIENT_OBELISK_CLIENT_HPP
 #define LIBBITCOIN_CLIENT_OBELISK_CLIENT_HPP
 
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
 #include <bitcoin/system.hpp>
+#include <bitcoin/client/block_decoder.hpp>
+#include <bitcoin/client/coin_selection.hpp>
 #include <bitcoin/client/define.hpp>
 #include <bitcoin/client/history.hpp>
+#include <bitcoin/client/index_cache.hpp>
+#include <bitcoin/client/request_ids.hpp>
+#include <bitcoin/client/shared_cache.hpp>
 #include <bitcoin/protocol.hpp>
 
 namespace libbitcoin {
@@ -46,8 +61,15 @@ class BCC_API obelisk_client
 public:
     static const auto null_subscription = bc::max_uint32;
 
+#ifdef _WIN32
+    typedef uintptr_t file_descriptor;
+#else
+    typedef int file_descriptor;
+#endif
+
+    // The payload is owned by the caller and may be moved from.
     typedef std::function<void(const std::string&, uint32_t,
-        const system::data_chunk&)> command_handler;
+        system::data_chunk&)> command_handler;
     typedef std::unordered_map<std::string, command_handler> command_map;
 
     // Subscription/notification handler types.
@@ -55,8 +77,23 @@ public:
 
     typedef std::function<void(const system::code&, uint16_t, size_t,
         const system::hash_digest&)> update_handler;
+
+    /// A key notification, as coalesced by a debounced subscription.
+    struct key_update
+    {
+        typedef std::vector<key_update> list;
+
+        uint16_t sequence;
+        size_t height;
+        system::hash_digest tx_hash;
+    };
+
+    typedef std::function<void(const system::code&, const key_update::list&)>
+        coalesced_update_handler;
     typedef std::function<void(const system::chain::block&)>
         block_update_handler;
+    typedef std::function<void(size_t, const system::chain::block&)>
+        block_height_update_handler;
     typedef std::function<void(const system::chain::transaction&)>
         transaction_update_handler;
 
@@ -66,6 +103,7 @@ public:
     typedef std::function<void(const system::code&)> result_handler;
     typedef std::function<void(const system::code&, size_t)> height_handler;
     typedef std::function<void(const system::code&, size_t, size_t)> transaction_index_handler;
+    typedef std::function<void(const system::code&, const system::chain::input_point&)> spend_handler;
     typedef std::function<void(const system::code&, const system::chain::block&)> block_handler;
     typedef std::function<void(const system::code&, const system::chain::header&)> block_header_handler;
     typedef std::function<void(const system::code&, const system::message::compact_filter&)> compact_filter_handler;
@@ -76,6 +114,23 @@ public:
     typedef std::function<void(const system::code&, const client::history::list&)> history_handler;
     typedef std::function<void(const system::code&, const system::hash_list&)> hash_list_handler;
     typedef std::function<void(const system::code&, const std::string&)> version_handler;
+    typedef std::function<void(const system::code&, const system::data_chunk&)> payload_handler;
+    typedef std::function<void(const system::code&, const system::asio::milliseconds&)> acceptance_handler;
+
+    typedef std::chrono::steady_clock::time_point time_point;
+    typedef std::unordered_map<uint32_t, update_handler> update_handler_map;
+
+    /// A server subscription shared by all local subscribers of its key.
+    struct key_subscription
+    {
+        system::hash_digest key;
+        update_handler_map handlers;
+
+        /// Renewal is (re)sent at renew, having become due at due.
+        time_point renew;
+        time_point due;
+        bool renewing;
+    };
 
     // Used for mapping specific requests to specific handlers
     // (allowing support for different handlers for different client
@@ -83,22 +138,35 @@ public:
     typedef std::unordered_map<uint32_t, result_handler> result_handler_map;
     typedef std::unordered_map<uint32_t, height_handler> height_handler_map;
     typedef std::unordered_map<uint32_t, transaction_index_handler> transaction_index_handler_map;
+    typedef std::unordered_map<uint32_t, spend_handler> spend_handler_map;
     typedef std::unordered_map<uint32_t, block_handler> block_handler_map;
+    typedef std::unordered_map<uint32_t, uint64_t> block_decode_map;
     typedef std::unordered_map<uint32_t, block_header_handler> block_header_handler_map;
     typedef std::unordered_map<uint32_t, compact_filter_handler> compact_filter_handler_map;
     typedef std::unordered_map<uint32_t, compact_filter_checkpoint_handler> compact_filter_checkpoint_handler_map;
     typedef std::unordered_map<uint32_t, compact_filter_headers_handler> compact_filter_headers_handler_map;
     typedef std::unordered_map<uint32_t, transaction_handler> transaction_handler_map;
     typedef std::unordered_map<uint32_t, history_handler> history_handler_map;
-    typedef std::unordered_map<uint32_t, std::pair<update_handler,
-        system::data_chunk>> subscription_handler_map;
+    typedef std::unordered_map<uint32_t, points_value_handler> points_value_handler_map;
+    typedef std::unordered_map<uint32_t, key_subscription>
+        subscription_handler_map;
+    typedef std::unordered_map<system::hash_digest, uint32_t>
+        subscription_key_map;
+    typedef std::unordered_map<uint32_t, uint32_t> local_subscription_map;
+    typedef std::pair<time_point, uint32_t> renewal;
+    typedef std::priority_queue<renewal, std::vector<renewal>,
+        std::greater<renewal>> renewal_queue;
     typedef std::unordered_map<uint32_t, std::pair<result_handler,
         uint32_t>> unsubscription_handler_map;
     typedef std::unordered_map<uint32_t, hash_list_handler> hash_list_handler_map;
     typedef std::unordered_map<uint32_t, version_handler> version_handler_map;
+    typedef std::unordered_map<uint32_t, payload_handler> payload_handler_map;
 
-    /// Construct an instance of the client.
-    obelisk_client(int32_t retries=5);
+    /// Construct an instance of the client, with at most request_limit
+    /// requests and subscriptions outstanding. Requests beyond the limit fail
+    /// immediately with error::network_unreachable.
+    obelisk_client(int32_t retries=5,
+        size_t request_limit=client::request_ids::capacity);
 
     ~obelisk_client();
 
@@ -118,16 +186,101 @@ public:
     void wait(uint32_t timeout_milliseconds=30000);
 
     /// Monitor for subscription notifications, until timeout.
+    /// Key subscriptions are renewed with the server while monitoring.
     void monitor(uint32_t timeout_milliseconds=30000);
 
+    /// The descriptors to watch for readability when embedding the client in
+    /// an external event loop, in place of wait() and monitor(). Readiness is
+    /// edge triggered, and process_ready() must be called upon it. Obtain
+    /// after connecting and subscribing to the block and transaction streams.
+    std::vector<file_descriptor> file_descriptors();
+
+    /// Process all messages ready on the client's sockets, and the timers of
+    /// monitor(), without blocking. Returns the time after which it must be
+    /// called again if no descriptor becomes ready, milliseconds::max() if
+    /// there is no timer, in which case only readiness need be awaited (the
+    /// value must not be converted to a poll timeout). Requests time out only
+    /// if a request timeout is set, otherwise wait(0) fails any outstanding.
+    system::asio::milliseconds process_ready();
+
+    /// Fail each request not answered within the timeout of its sending with
+    /// error::channel_timeout, releasing its handler and id, zero for no
+    /// timeout (default). Deadlines are enforced by wait() and process_ready()
+    /// and do not apply to subscriptions.
+    void set_request_timeout(const system::asio::milliseconds& timeout);
+
+    /// Determines if any requests have not been handled.
+    bool requests_outstanding();
+
+    /// Set the server's key subscription expiration period, which should match
+    /// the server's configuration. Zero disables renewal (default 10 minutes).
+    void set_subscription_expiration(uint32_t minutes);
+
+    /// Set the server's key subscription expiration period in milliseconds.
+    void set_subscription_expiration(
+        const system::asio::milliseconds& period);
+
+    /// The delay between the most recent key subscription renewal becoming
+    /// due and its acknowledgement by the server.
+    system::asio::milliseconds renewal_lag() const;
+
+    /// Answer block height and transaction index queries from the cache when
+    /// possible, filling it from responses and the block stream. Set before
+    /// connecting. The cache may be shared between clients.
+    void set_index_cache(std::shared_ptr<client::index_cache> cache);
+
+    /// Answer block and block header queries by hash from the host's shared
+    /// memory cache when possible, filling it from responses. A cached block
+    /// is subject to merkle verification (see set_decode_threads), and one
+    /// that fails is fetched from the server. Set before connecting.
+    void set_shared_cache(std::shared_ptr<client::shared_cache> cache);
+
+    /// Limit the memory of in-flight block and history responses to about
+    /// the given number of bytes, zero for no limit (default). While a
+    /// request's expected response would exceed the budget its sending is
+    /// delayed by wait() until earlier responses complete. At least one such
+    /// request is always in flight.
+    void set_memory_budget(size_t bytes);
+
+    /// The memory reserved for in-flight block and history responses and
+    /// held by block decoding, in bytes.
+    size_t memory_usage() const;
+
+    /// Retain transaction witnesses (default). If not, the fetch_transaction2
+    /// fetches use the original commands, which respond without witness, and
+    /// witnesses of streamed and fetched transactions are skipped in parsing.
+    void set_witness(bool witness);
+
+    /// Decode fetched blocks on the given number of worker threads, zero to
+    /// decode on the thread calling wait() (default). Block handlers remain
+    /// invoked by wait(), in the order of the fetch requests. If verifying,
+    /// blocks whose merkle root does not match their transactions fail with
+    /// error::merkle_mismatch. Set while no block fetch is outstanding.
+    void set_decode_threads(size_t threads, bool verify_merkle=false);
+
     // Fetchers.
     //-------------------------------------------------------------------------
 
     void server_version(version_handler handler);
 
+    /// Send a query command of the server with the payload in its wire
+    /// format, completing with the response payload undecoded, which begins
+    /// with the server's error code. Not for (un)subscription commands.
+    void send_command(payload_handler handler, const std::string& command,
+        const system::data_chunk& payload);
+
     void transaction_pool_broadcast(result_handler handler,
         const system::chain::transaction& tx);
 
+    /// Broadcast the transaction and complete when it is observed on the
+    /// transaction stream (see subscribe_transaction), with the latency from
+    /// broadcast, or upon timeout. Broadcast failure is completed by wait()
+    /// and acceptance or timeout by monitor(). A transaction already awaited
+    /// fails with error::duplicate_transaction.
+    void transaction_pool_broadcast_and_await(acceptance_handler handler,
+        const system::chain::transaction& tx,
+        uint32_t timeout_milliseconds=30000);
+
     void transaction_pool_validate2(result_handler handler,
         const system::chain::transaction& tx);
 
@@ -165,6 +318,10 @@ public:
     void blockchain_fetch_transaction_index(transaction_index_handler handler,
         const system::hash_digest& tx_hash);
 
+    /// The input spending the output, error::not_found if unspent.
+    void blockchain_fetch_spend(spend_handler handler,
+        const system::chain::output_point& outpoint);
+
     void blockchain_fetch_block_height(height_handler handler,
         const system::hash_digest& block_hash);
 
@@ -203,16 +360,35 @@ public:
         const system::hash_digest& key, uint64_t satoshi,
         system::wallet::select_outputs::algorithm algorithm);
 
+    /// Select through coin_selection over the decoded unspent outputs,
+    /// preferring a selection that requires no change output. The selection
+    /// is empty if the value is insufficient.
+    void blockchain_fetch_unspent_outputs(points_value_handler handler,
+        const system::hash_digest& key, uint64_t satoshi,
+        uint64_t cost_of_change, const system::asio::milliseconds& budget);
+
     // Subscribers.
     //-------------------------------------------------------------------------
 
     // Subscribe to a payment key.  Return value can be used to unsubscribe.
+    // Subscribers to the same key share a single server subscription.
     uint32_t subscribe_key(update_handler handler,
         const system::hash_digest& key);
 
+    // Subscribe to a payment key, coalescing the notifications received within
+    // the debounce window following each first notification into one call.
+    // Subscription success and failure are not coalesced (empty update list).
+    // Buffered updates are delivered when the subscriber is unsubscribed.
+    uint32_t subscribe_key(coalesced_update_handler handler,
+        const system::hash_digest& key, uint32_t debounce_milliseconds);
+
     bool subscribe_block(const system::config::endpoint& address,
         block_update_handler on_update);
 
+    // Subscribe to the block stream, with the height of each block.
+    bool subscribe_block(const system::config::endpoint& address,
+        block_height_update_handler on_update);
+
     bool subscribe_transaction(const system::config::endpoint& address,
         transaction_update_handler on_update);
 
@@ -222,16 +398,75 @@ public:
     bool unsubscribe_key(result_handler handler, uint32_t subscription);
 
 private:
+    // A broadcast transaction awaiting its appearance on the stream.
+    struct acceptance
+    {
+        acceptance_handler handler;
+        time_point broadcast;
+        time_point deadline;
+    };
+
+    typedef std::unordered_map<system::hash_digest, acceptance>
+        acceptance_map;
+    typedef std::pair<time_point, system::hash_digest> acceptance_deadline;
+    typedef std::priority_queue<acceptance_deadline,
+        std::vector<acceptance_deadline>, std::greater<acceptance_deadline>>
+        acceptance_queue;
+
+    // The deadline of a sent request, with its id and command.
+    typedef std::tuple<time_point, uint32_t, std::string> request_deadline;
+    typedef std::priority_queue<request_deadline,
+        std::vector<request_deadline>, std::greater<request_deadline>>
+        request_queue;
+
+    // A request delayed by the memory budget.
+    struct deferred_request
+    {
+        std::string command;
+        uint32_t id;
+        system::data_chunk payload;
+    };
+
+    typedef std::unordered_map<uint32_t, size_t> admission_map;
+    typedef std::unordered_map<std::string, size_t> estimate_map;
+
+    // Notifications buffered by a debounced subscription.
+    struct debounce
+    {
+        coalesced_update_handler handler;
+        system::asio::milliseconds window;
+        time_point flush;
+        key_update::list updates;
+        uint32_t subscription;
+    };
+
+    typedef std::shared_ptr<debounce> debounce_ptr;
+    typedef std::unordered_map<uint32_t, debounce_ptr> debounce_map;
+    typedef std::pair<time_point, std::weak_ptr<debounce>> debounce_flush;
+
+    struct later_flush
+    {
+        bool operator()(const debounce_flush& left,
+            const debounce_flush& right) const
+        {
+            return left.first > right.first;
+        }
+    };
+
+    typedef std::priority_queue<debounce_flush, std::vector<debounce_flush>,
+        later_flush> flush_queue;
+
     // Attach handlers for all supported client-server operations.
     void attach_handlers();
 
+    // Wrap the handler to fill the shared cache from successful responses.
+    block_handler cache_block(block_handler handler) const;
+    block_header_handler cache_header(block_header_handler handler) const;
+
     // Used to handle a request immediately, on early detection of error.
     void handle_immediate(const std::string& command, uint32_t id,
         const system::code& ec);
 
-    // Determines if any requests have not been handled.
-    bool requests_outstanding();
-
     // Determines if any notification requests have not been handled.
     bool subscribe_requests_outstanding();
 
@@ -246,6 +481,20 @@ private:
     bool send_request(const std::string& command, uint32_t id,
         const system::data_chunk& payload, bool subscription=false);
 
+    // Sends a request with a large response subject to the memory budget,
+    // or defers it until admit_requests() has room for it.
+    void send_budgeted_request(const std::string& command, uint32_t id,
+        const system::data_chunk& payload);
+
+    // Sends deferred requests for which there is room in the memory budget.
+    void admit_requests();
+
+    // Releases the memory reserved for the request upon its response of the
+    // given size, which if not zero (unsuccessful) refines the estimate for
+    // the command.
+    void release_request(const std::string& command, uint32_t id,
+        size_t response_size);
+
     // Forward incoming client router requests to the server.
     void forward_message(protocol::zmq::socket& source,
         protocol::zmq::socket& sink);
@@ -253,10 +502,46 @@ private:
     // Process server responses.
     void process_response(protocol::zmq::socket& socket);
 
+    // Process a message of the block or transaction stream.
+    void process_block();
+    void process_transaction();
+
     // After notifying the server of unsubscribe, this terminates any client
     // side monitoring state for the subscription.
     bool terminate_unsubscriber(uint32_t subscription);
 
+    // Resends subscriptions that are due for renewal, returning the time
+    // remaining until the next renewal is due.
+    system::asio::milliseconds renew_subscriptions();
+
+    // Completes the acceptance of a transaction seen on the stream.
+    void accept_transaction(const system::hash_digest& tx_hash);
+
+    // Fails requests whose deadline has passed, returning the time remaining
+    // until the next request deadline.
+    system::asio::milliseconds expire_requests();
+
+    // Completes broadcasts whose acceptance has timed out, returning the time
+    // remaining until the next acceptance deadline.
+    system::asio::milliseconds expire_acceptances();
+
+    // Invokes debounced subscribers with updates whose window has elapsed,
+    // returning the time remaining until the next window elapses.
+    system::asio::milliseconds flush_updates();
+
+    // Invokes a debounced subscriber with its buffered updates as it is
+    // unsubscribed, after which its updates are no longer buffered.
+    void flush_unsubscribed(uint32_t subscription);
+
+    // Schedules the renewal of a server subscription.
+    // Must be called with subscription_lock_ exclusively locked.
+    void schedule_renewal(uint32_t subscription, key_subscription& value,
+        const time_point& from);
+
+    // Removes a server subscription and all of its local subscribers.
+    // Must be called with subscription_lock_ exclusively locked.
+    void remove_subscription(subscription_handler_map::iterator it);
+
     protocol::zmq::context context_;
 
     // Sockets that connect to external libbitcoin services.
@@ -275,31 +560,63 @@ private:
     protocol::zmq::socket subscribe_dealer_;
     protocol::zmq::socket subscribe_router_;
 
-    block_update_handler on_block_update_;
+    block_height_update_handler on_block_update_;
     transaction_update_handler on_transaction_update_;
     int32_t retries_;
     bool secure_;
     system::config::endpoint worker_;
     system::config::endpoint subscribe_worker_;
-    uint32_t last_request_index_;
+    client::request_ids request_ids_;
     command_map command_handlers_;
     result_handler_map result_handlers_;
     height_handler_map height_handlers_;
     transaction_index_handler_map transaction_index_handlers_;
+    spend_handler_map spend_handlers_;
     block_handler_map block_handlers_;
+    block_decode_map block_decodes_;
+    std::unique_ptr<client::block_decoder> block_decoder_;
+    bool verify_merkle_;
+    bool witness_;
+    size_t memory_budget_;
+    std::atomic<size_t> memory_reserved_;
+    std::deque<deferred_request> deferred_requests_;
+    admission_map admissions_;
+    estimate_map response_estimates_;
+    system::asio::milliseconds request_timeout_;
+    request_queue request_deadlines_;
     block_header_handler_map block_header_handlers_;
     compact_filter_handler_map compact_filter_handlers_;
     compact_filter_checkpoint_handler_map compact_filter_checkpoint_handlers_;
     compact_filter_headers_handler_map compact_filter_headers_handlers_;
     transaction_handler_map transaction_handlers_;
     history_handler_map history_handlers_;
+    points_value_handler_map unspent_handlers_;
     subscription_handler_map subscription_handlers_;
+    subscription_key_map subscription_keys_;
+    local_subscription_map local_subscriptions_;
+    renewal_queue renewals_;
+    system::asio::milliseconds subscription_expiration_;
+    std::atomic<int64_t> renewal_lag_;
+    std::shared_ptr<client::index_cache> index_cache_;
+    std::shared_ptr<client::shared_cache> shared_cache_;
     unsubscription_handler_map unsubscription_handlers_;
     hash_list_handler_map hash_list_handlers_;
     version_handler_map version_handlers_;
+    payload_handler_map payload_handlers_;
 
-    // Protects subscription_handlers_
+    acceptance_map acceptances_;
+    acceptance_queue acceptance_deadlines_;
+
+    // Protects subscription_handlers_, subscription_keys_,
+    // local_subscriptions_, renewals_, unsubscription_handlers_,
+    // acceptances_ and acceptance_deadlines_.
     system::upgrade_mutex subscription_lock_;
+
+    // Protects flushes_, debounces_ and the updates buffered by debounced
+    // subscribers.
+    flush_queue flushes_;
+    debounce_map debounces_;
+    system::upgrade_mutex update_lock_;
 };
 
 } // namespace client
@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_PREVOUT_RESOLVER_HPP
+#define LIBBITCOIN_CLIENT_PREVOUT_RESOLVER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <bitcoin/system.hpp>
+#include <bitcoin/client/define.hpp>
+#include <bitcoin/client/obelisk_client.hpp>
+
+namespace libbitcoin {
+namespace client {
+
+/// Resolves the values of the outputs spent by transactions, and from them
+/// fees and fee rates. The distinct previous transactions of a batch are
+/// fetched with a bounded number of requests in flight, requests for the same
+/// transaction are coalesced across batches, and output values are cached.
+/// Fetches are completed by obelisk_client::wait, during which further
+/// requests are issued as others complete. Not thread safe.
+class BCC_API prevout_resolver
+{
+public:
+    struct resolution
+    {
+        typedef std::vector<resolution> list;
+
+        /// The value of the output spent by each input (empty for coinbase).
+        std::vector<uint64_t> values;
+
+        /// The input value less the output value (zero for coinbase).
+        uint64_t fee;
+
+        /// The fee in satoshis per virtual byte.
+        double fee_rate;
+    };
+
+    typedef std::function<void(const system::code&, const resolution&)>
+        resolution_handler;
+    typedef std::function<void(const system::code&, const resolution::list&)>
+        batch_handler;
+    typedef std::function<void(obelisk_client::transaction_handler,
+        const system::hash_digest&)> fetcher;
+
+    /// Resolve using transaction_pool_fetch_transaction2 of the client, which
+    /// returns confirmed and unconfirmed transactions.
+    prevout_resolver(obelisk_client& client, size_t maximum_in_flight=64,
+        size_t cache_limit=10000);
+
+    /// Resolve using the given transaction fetch.
+    prevout_resolver(fetcher fetch, size_t maximum_in_flight=64,
+        size_t cache_limit=10000);
+
+    /// Resolve a transaction.
+    void resolve(resolution_handler handler,
+        const system::chain::transaction& tx);
+
+    /// Resolve a batch of transactions, such as those of a block, in order.
+    /// The handler is invoked once, with the first error if any.
+    void resolve(batch_handler handler,
+        const system::chain::transaction::list& txs);
+
+    /// The number of fetches in flight.
+    size_t in_flight() const;
+
+    /// The number of transactions with cached output values.
+    size_t cached() const;
+
+private:
+    typedef std::pair<uint32_t, uint32_t> input_position;
+    typedef std::vector<uint64_t> output_values;
+
+    struct batch
+    {
+        system::chain::transaction::list txs;
+        resolution::list resolutions;
+        std::unordered_map<system::hash_digest,
+            std::vector<input_position>> missing;
+        batch_handler handler;
+        bool complete;
+    };
+
+    typedef std::shared_ptr<batch> batch_ptr;
+
+    bool fill(batch& job, const system::hash_digest& tx_hash,
+        const output_values& values, system::code& ec) const;
+    void finish(batch& job, const system::code& ec) const;
+    void handle_fetch(const system::hash_digest& tx_hash,
+        const system::code& ec, const system::chain::transaction& tx);
+    void cache(const system::hash_digest& tx_hash,
+        const output_values& values);
+    void pump();
+
+    fetcher fetch_;
+    const size_t maximum_in_flight_;
+    const size_t cache_limit_;
+    size_t in_flight_;
+    bool pumping_;
+
+    std::unordered_map<system::hash_digest, output_values> cache_;
+    std::deque<system::hash_digest> cache_order_;
+    std::unordered_map<system::hash_digest, std::vector<batch_ptr>> waiting_;
+    std::deque<system::hash_digest> queue_;
+};
+
+} // namespace client
+} // namespace libbitcoin
+
+#endif
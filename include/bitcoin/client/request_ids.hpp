@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_REQUEST_IDS_HPP
+#define LIBBITCOIN_CLIENT_REQUEST_IDS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <bitcoin/system.hpp>
+#include <bitcoin/client/define.hpp>
+
+namespace libbitcoin {
+namespace client {
+
+/// Allocates 32 bit request ids as a slot index and the generation of the
+/// slot. An id is never reused while allocated, and a released slot is not
+/// reused until reuse_delay other slots have been released, so a released id
+/// recurs only after hundreds of millions of allocations. A response to a
+/// released id is recognized as stale in constant time. Slot zero is not
+/// used, so zero is never an id, nor is obelisk_client::null_subscription.
+/// Thread safe.
+class BCC_API request_ids
+{
+public:
+    static const uint32_t slot_bits = 20;
+
+    /// The number of ids that may be allocated at once.
+    static const size_t capacity = (size_t(1) << slot_bits) - 2;
+
+    /// The number of released slots retained before one is reused.
+    static const size_t reuse_delay = 65536;
+
+    /// Construct an allocator of at most limit (up to capacity) ids at once.
+    request_ids(size_t limit=capacity);
+
+    /// Allocate an id, zero if limit ids are allocated.
+    uint32_t allocate();
+
+    /// Release an allocated id, false if it is not allocated (stale).
+    bool release(uint32_t id);
+
+    /// True if the id is allocated, false if it is stale.
+    bool is_allocated(uint32_t id) const;
+
+    /// The number of ids allocated.
+    size_t size() const;
+
+private:
+    struct slot
+    {
+        uint16_t generation;
+        bool allocated;
+    };
+
+    // Requires mutex_ to be locked.
+    bool is_current(uint32_t id) const;
+
+    std::vector<slot> slots_;
+    std::deque<uint32_t> released_;
+    const size_t limit_;
+    size_t allocated_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace client
+} // namespace libbitcoin
+
+#endif
@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_RESPONSE_CACHE_HPP
+#define LIBBITCOIN_CLIENT_RESPONSE_CACHE_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <bitcoin/system.hpp>
+#include <bitcoin/client/define.hpp>
+
+namespace libbitcoin {
+namespace client {
+
+/// Server response payloads by command and request payload, each retained
+/// for a time to live, with the least recently used evicted beyond the
+/// capacity (see gateway). Thread safe.
+class BCC_API response_cache
+{
+public:
+    /// Construct a cache of at most the given size of responses, in bytes.
+    response_cache(size_t capacity, uint32_t time_to_live_milliseconds);
+
+    /// The response to the request, false if not cached or expired.
+    bool find(const std::string& command, const system::data_chunk& request,
+        system::data_chunk& out_response);
+
+    /// Cache the response, unless larger than the capacity.
+    void store(const std::string& command, const system::data_chunk& request,
+        const system::data_chunk& response);
+
+    /// Remove all responses.
+    void clear();
+
+    /// The number of responses cached.
+    size_t size() const;
+
+    /// The size of the responses cached, in bytes.
+    size_t bytes() const;
+
+    /// The key of a request, equal for requests of equal command and payload.
+    static std::string to_key(const std::string& command,
+        const system::data_chunk& request);
+
+private:
+    typedef std::chrono::steady_clock::time_point time_point;
+    typedef std::list<std::string> usage_list;
+
+    struct entry
+    {
+        system::data_chunk response;
+        time_point expiry;
+        usage_list::iterator usage;
+    };
+
+    typedef std::unordered_map<std::string, entry> entry_map;
+
+    // Requires mutex_ to be locked.
+    void erase(entry_map::iterator it);
+
+    const size_t capacity_;
+    const std::chrono::milliseconds time_to_live_;
+
+    // Protected by mutex_, usage_ in order of use, most recent first.
+    entry_map entries_;
+    usage_list usage_;
+    size_t bytes_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace client
+} // namespace libbitcoin
+
+#endif
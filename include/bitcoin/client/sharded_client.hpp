@@ -0,0 +1,307 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_SHARDED_CLIENT_HPP
+#define LIBBITCOIN_CLIENT_SHARDED_CLIENT_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include <bitcoin/system.hpp>
+#include <bitcoin/client/asio_client.hpp>
+#include <bitcoin/client/define.hpp>
+#include <bitcoin/client/index_cache.hpp>
+#include <bitcoin/client/obelisk_client.hpp>
+
+namespace libbitcoin {
+namespace client {
+
+/// A client of shards, each an obelisk_client with its own sockets run by
+/// its own thread (see asio_client), so that throughput scales with cores.
+/// Fetches are routed to shards in turn and key subscriptions by key, so
+/// subscribers of a key still share one server subscription. The block and
+/// transaction streams, and so broadcast and await, are on the first shard.
+/// Handlers are invoked on the thread of their shard. Each fetch fails with
+/// error::channel_timeout at its deadline, enforced by the client of its shard
+/// so that its request id is released, and any outstanding upon stop fail
+/// with it. Configure before connecting. Thread safe, though stop() must not
+/// be called from a handler, nor subscribe or unsubscribe from one.
+class BCC_API sharded_client
+{
+public:
+    typedef obelisk_client::result_handler result_handler;
+    typedef obelisk_client::height_handler height_handler;
+    typedef obelisk_client::transaction_index_handler
+        transaction_index_handler;
+    typedef obelisk_client::spend_handler spend_handler;
+    typedef obelisk_client::block_handler block_handler;
+    typedef obelisk_client::block_header_handler block_header_handler;
+    typedef obelisk_client::compact_filter_handler compact_filter_handler;
+    typedef obelisk_client::compact_filter_checkpoint_handler
+        compact_filter_checkpoint_handler;
+    typedef obelisk_client::compact_filter_headers_handler
+        compact_filter_headers_handler;
+    typedef obelisk_client::transaction_handler transaction_handler;
+    typedef obelisk_client::points_value_handler points_value_handler;
+    typedef obelisk_client::history_handler history_handler;
+    typedef obelisk_client::hash_list_handler hash_list_handler;
+    typedef obelisk_client::version_handler version_handler;
+    typedef obelisk_client::acceptance_handler acceptance_handler;
+    typedef obelisk_client::update_handler update_handler;
+    typedef obelisk_client::coalesced_update_handler coalesced_update_handler;
+    typedef obelisk_client::block_update_handler block_update_handler;
+    typedef obelisk_client::block_height_update_handler
+        block_height_update_handler;
+    typedef obelisk_client::transaction_update_handler
+        transaction_update_handler;
+
+    /// Construct the given number of shards, zero for one per core.
+    sharded_client(size_t shards=0, int32_t retries=5,
+        uint32_t timeout_milliseconds=30000);
+
+    /// Stop the shards.
+    ~sharded_client();
+
+    /// This class is not copyable.
+    sharded_client(const sharded_client&) = delete;
+    void operator=(const sharded_client&) = delete;
+
+    /// Connect each shard to the endpoint and start the shards.
+    bool connect(const system::config::endpoint& address);
+
+    /// Connect each shard using the provided settings and start the shards.
+    bool connect(const connection_settings& settings);
+
+    /// Stop and join the shards, failing outstanding requests.
+    void stop();
+
+    /// The number of shards.
+    size_t shards() const;
+
+    // Configuration, as of each shard.
+    //-------------------------------------------------------------------------
+
+    void set_subscription_expiration(uint32_t minutes);
+    void set_index_cache(std::shared_ptr<client::index_cache> cache);
+    void set_witness(bool witness);
+    void set_decode_threads(size_t threads, bool verify_merkle=false);
+
+    /// Limit the memory of in-flight responses, divided among the shards.
+    void set_memory_budget(size_t bytes);
+
+    // Metrics, aggregated over the shards.
+    //-------------------------------------------------------------------------
+
+    /// The memory used for in-flight responses by all shards, in bytes.
+    size_t memory_usage() const;
+
+    /// The greatest key subscription renewal lag among the shards.
+    system::asio::milliseconds renewal_lag() const;
+
+    /// The number of fetches sent by the shards and not yet completed.
+    size_t requests_outstanding() const;
+
+    // Fetchers.
+    //-------------------------------------------------------------------------
+
+    void server_version(version_handler handler);
+
+    void transaction_pool_broadcast(result_handler handler,
+        const system::chain::transaction& tx);
+
+    void transaction_pool_broadcast_and_await(acceptance_handler handler,
+        const system::chain::transaction& tx,
+        uint32_t timeout_milliseconds=30000);
+
+    void transaction_pool_validate2(result_handler handler,
+        const system::chain::transaction& tx);
+
+    void transaction_pool_fetch_transaction(transaction_handler handler,
+        const system::hash_digest& tx_hash);
+
+    void transaction_pool_fetch_transaction2(transaction_handler handler,
+        const system::hash_digest& tx_hash);
+
+    void blockchain_broadcast(result_handler handler,
+        const system::chain::block& block);
+
+    void blockchain_validate(result_handler handler,
+        const system::chain::block& block);
+
+    void blockchain_fetch_transaction(transaction_handler handler,
+        const system::hash_digest& tx_hash);
+
+    void blockchain_fetch_transaction2(transaction_handler handler,
+        const system::hash_digest& tx_hash);
+
+    void blockchain_fetch_last_height(height_handler handler);
+
+    void blockchain_fetch_block(block_handler handler, uint32_t height);
+
+    void blockchain_fetch_block(block_handler handler,
+        const system::hash_digest& block_hash);
+
+    void blockchain_fetch_block_header(block_header_handler handler,
+        uint32_t height);
+
+    void blockchain_fetch_block_header(block_header_handler handler,
+        const system::hash_digest& block_hash);
+
+    void blockchain_fetch_transaction_index(transaction_index_handler handler,
+        const system::hash_digest& tx_hash);
+
+    void blockchain_fetch_spend(spend_handler handler,
+        const system::chain::output_point& outpoint);
+
+    void blockchain_fetch_block_height(height_handler handler,
+        const system::hash_digest& block_hash);
+
+    void blockchain_fetch_block_transaction_hashes(
+        hash_list_handler handler, uint32_t height);
+
+    void blockchain_fetch_block_transaction_hashes(
+        hash_list_handler handler, const system::hash_digest& block_hash);
+
+    void blockchain_fetch_compact_filter(compact_filter_handler handler,
+        uint8_t filter_type, uint32_t height);
+
+    void blockchain_fetch_compact_filter(compact_filter_handler handler,
+        uint8_t filter_type, const system::hash_digest& block_hash);
+
+    void blockchain_fetch_compact_filter_headers(
+        compact_filter_headers_handler handler, uint8_t filter_type,
+        uint32_t start_height, const system::hash_digest& stop_hash);
+
+    void blockchain_fetch_compact_filter_headers(
+        compact_filter_headers_handler handler, uint8_t filter_type,
+        uint32_t start_height, uint32_t stop_height);
+
+    void blockchain_fetch_compact_filter_checkpoint(
+        compact_filter_checkpoint_handler handler, uint8_t filter_type,
+        const system::hash_digest& stop_hash);
+
+    void blockchain_fetch_history4(history_handler handler,
+        const system::hash_digest& key, uint32_t from_height=0);
+
+    void blockchain_fetch_unspent_outputs(points_value_handler handler,
+        const system::hash_digest& key, uint64_t satoshi,
+        system::wallet::select_outputs::algorithm algorithm);
+
+    void blockchain_fetch_unspent_outputs(points_value_handler handler,
+        const system::hash_digest& key, uint64_t satoshi,
+        uint64_t cost_of_change, const system::asio::milliseconds& budget);
+
+    // Subscribers.
+    //-------------------------------------------------------------------------
+
+    uint32_t subscribe_key(update_handler handler,
+        const system::hash_digest& key);
+
+    uint32_t subscribe_key(coalesced_update_handler handler,
+        const system::hash_digest& key, uint32_t debounce_milliseconds);
+
+    bool subscribe_block(const system::config::endpoint& address,
+        block_update_handler on_update);
+
+    bool subscribe_block(const system::config::endpoint& address,
+        block_height_update_handler on_update);
+
+    bool subscribe_transaction(const system::config::endpoint& address,
+        transaction_update_handler on_update);
+
+    // Unsubscribers.
+    //-------------------------------------------------------------------------
+
+    bool unsubscribe_key(result_handler handler, uint32_t subscription);
+
+private:
+    typedef boost::asio::executor_work_guard<
+        system::asio::service::executor_type> work_guard;
+
+    // A client and the thread that runs it.
+    struct shard
+    {
+        shard(int32_t retries, uint32_t timeout_milliseconds);
+
+        obelisk_client client;
+        system::asio::service service;
+        asio_client adapter;
+        std::unique_ptr<work_guard> work;
+        std::thread thread;
+    };
+
+    typedef std::unique_ptr<shard> shard_ptr;
+    typedef std::pair<size_t, uint32_t> shard_subscription;
+    typedef std::unordered_map<uint32_t, shard_subscription>
+        subscription_map;
+
+    // Select the next shard in turn, or the index of the shard of the key.
+    shard& next();
+    size_t select(const system::hash_digest& key) const;
+
+    // Run the work on the thread of the shard.
+    void post(shard& target, std::function<void(obelisk_client&)> work);
+
+    // Run the work on the thread of the shard and await its result, or run
+    // it here if the shard is not started or this is its thread.
+    template <typename Result>
+    Result execute(shard& target,
+        std::function<Result(obelisk_client&)> work);
+
+    // Count the fetch as outstanding until the client completes it, once,
+    // upon response, deadline (see obelisk_client::set_request_timeout) or
+    // stop.
+    template <typename... Args>
+    std::function<void(const system::code&, Args...)> track(
+        std::function<void(const system::code&, Args...)> handler)
+    {
+        ++outstanding_;
+        const auto outstanding = &outstanding_;
+        return [handler, outstanding](const system::code& ec, Args... args)
+        {
+            --(*outstanding);
+            handler(ec, args...);
+        };
+    }
+
+    bool start();
+    uint32_t add_subscription(size_t index, uint32_t subscription);
+
+    std::vector<shard_ptr> shards_;
+    std::atomic<size_t> turn_;
+    std::atomic<size_t> outstanding_;
+    std::atomic<bool> started_;
+
+    // Protected by subscription_mutex_.
+    subscription_map subscriptions_;
+    uint32_t last_subscription_;
+    mutable std::mutex subscription_mutex_;
+};
+
+} // namespace client
+} // namespace libbitcoin
+
+#endif
@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_SHARED_CACHE_HPP
+#define LIBBITCOIN_CLIENT_SHARED_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <boost/interprocess/mapped_region.hpp>
+#include <bitcoin/system.hpp>
+#include <bitcoin/client/define.hpp>
+
+namespace libbitcoin {
+namespace client {
+
+/// Block headers and blocks by block hash in a named shared memory segment,
+/// readable and filled by any process on the host that opens it (see
+/// obelisk_client::set_shared_cache). Entries are appended to an arena and
+/// indexed by an open addressing table whose slots are claimed and published
+/// atomically, so neither reading nor filling takes a lock. Probing is
+/// bounded, so a lookup stays cheap as the table fills. Entries are never
+/// removed, and an entry that finds no slot near its position or no room in
+/// the arena is dropped. Thread and process safe.
+class BCC_API shared_cache
+{
+public:
+    enum class entry : uint32_t
+    {
+        header = 1,
+        block = 2
+    };
+
+    /// Open the named segment, creating it with the given number of index
+    /// slots and arena size if it does not exist.
+    shared_cache(const std::string& name, size_t slots=65536,
+        size_t arena=268435456);
+
+    /// This class is not copyable.
+    shared_cache(const shared_cache&) = delete;
+    void operator=(const shared_cache&) = delete;
+
+    /// Remove the named segment, which remains mapped by open caches.
+    static bool remove(const std::string& name);
+
+    /// False if the segment could not be created or opened.
+    bool valid() const;
+
+    /// The serialized entry, false if not cached.
+    bool find(entry type, const system::hash_digest& block_hash,
+        system::data_chunk& out_data) const;
+
+    /// Cache the serialized entry, false if dropped.
+    bool store(entry type, const system::hash_digest& block_hash,
+        const system::data_chunk& data);
+
+    /// The cached header or block, false if not cached or if it does not
+    /// deserialize to the block hash.
+    bool find_header(const system::hash_digest& block_hash,
+        system::chain::header& out_header) const;
+    bool store_header(const system::chain::header& header);
+
+    bool find_block(const system::hash_digest& block_hash,
+        system::chain::block& out_block) const;
+    bool store_block(const system::chain::block& block);
+
+    /// The number of entries cached.
+    size_t size() const;
+
+    /// The size of the arena used, in bytes.
+    size_t bytes() const;
+
+    /// The size of the arena, in bytes.
+    size_t capacity() const;
+
+    /// The number of entries dropped because the segment was full.
+    size_t dropped() const;
+
+private:
+    struct segment;
+    struct slot;
+
+    // Map the segment, creating it if not found, false on failure.
+    bool open(const std::string& name, size_t slots, size_t arena);
+    bool fill(slot& row, entry type, const system::hash_digest& block_hash,
+        const system::data_chunk& data);
+
+    boost::interprocess::mapped_region region_;
+    segment* segment_;
+    slot* slots_;
+    uint8_t* arena_;
+};
+
+} // namespace client
+} // namespace libbitcoin
+
+#endif
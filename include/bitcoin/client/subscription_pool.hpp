@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_SUBSCRIPTION_POOL_HPP
+#define LIBBITCOIN_CLIENT_SUBSCRIPTION_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <bitcoin/system.hpp>
+#include <bitcoin/client/asio_client.hpp>
+#include <bitcoin/client/define.hpp>
+#include <bitcoin/client/obelisk_client.hpp>
+#include <bitcoin/client/request_ids.hpp>
+
+namespace libbitcoin {
+namespace client {
+
+/// Subscribes keys across a set of servers, each key to the server that
+/// follows it on a consistent hash ring of the servers, so that adding or
+/// removing a server moves only the keys it gains or loses. Notifications of
+/// all servers are merged into one handler, with their key. A key that moves
+/// is notified of its subscription to the new server (success and a null
+/// transaction hash), upon which its history may be refetched to cover the
+/// move. A key whose subscription fails is resubscribed, and a server that
+/// fails error_limit subscriptions without notifying a transaction between
+/// them is removed as gone, its keys moving to the others. Servers are
+/// run on the io context (see asio_client), and the pool must only be used
+/// from its thread.
+class BCC_API subscription_pool
+{
+public:
+    typedef std::function<void(const system::code&,
+        const system::hash_digest& key, uint16_t sequence, size_t height,
+        const system::hash_digest& tx_hash)> key_update_handler;
+
+    /// The default number of ring positions of each server.
+    static const size_t default_replicas = 100;
+
+    /// The default number of subscription errors in a row of a server.
+    static const size_t default_error_limit = 3;
+
+    /// Each server is subscribed with at most request_limit ids at once
+    /// (see obelisk_client), beyond which its subscriptions fail.
+    subscription_pool(system::asio::service& service,
+        key_update_handler handler, size_t replicas=default_replicas,
+        size_t error_limit=default_error_limit,
+        size_t request_limit=request_ids::capacity);
+
+    /// This class is not copyable.
+    subscription_pool(const subscription_pool&) = delete;
+    void operator=(const subscription_pool&) = delete;
+
+    /// Connect to the server and move to it the keys that it now follows.
+    bool add_server(const connection_settings& settings);
+
+    /// Move the keys of the server to those that now follow them, and
+    /// disconnect from it. False if the server is not in the pool.
+    bool remove_server(const system::config::endpoint& server);
+
+    /// Subscribe to the key on its server, false if already subscribed.
+    /// A key subscribed while no server is in the pool is subscribed once
+    /// a server is added.
+    bool subscribe_key(const system::hash_digest& key);
+
+    /// Unsubscribe from the key, false if not subscribed.
+    bool unsubscribe_key(const system::hash_digest& key);
+
+    /// The number of servers.
+    size_t servers() const;
+
+    /// The number of keys subscribed.
+    size_t keys() const;
+
+    /// The number of keys subscribed to the server.
+    size_t keys(const system::config::endpoint& server) const;
+
+private:
+    // A server, its client, and its key subscriptions.
+    struct server
+    {
+        server(system::asio::service& service, int32_t retries,
+            size_t request_limit);
+
+        obelisk_client client;
+        asio_client adapter;
+        std::unordered_map<system::hash_digest, uint32_t> subscriptions;
+        size_t errors;
+    };
+
+    typedef std::shared_ptr<server> server_ptr;
+    typedef std::map<std::string, server_ptr> server_map;
+    typedef std::map<uint64_t, std::string> ring;
+    typedef std::unordered_map<system::hash_digest, std::string> owner_map;
+
+    static uint64_t position(const system::hash_digest& key);
+
+    // The name of the server that follows the key, empty if none.
+    std::string owner(const system::hash_digest& key) const;
+
+    // Move each key to its owner if not already subscribed to it.
+    void rebalance();
+
+    bool remove(const std::string& name);
+
+    // Resubscribe the key of a failed subscription, or remove its server.
+    void recover(const system::hash_digest& key, const std::string& name);
+
+    void handle_update(const system::code& ec, const system::hash_digest& key,
+        const std::string& name, uint16_t sequence, size_t height,
+        const system::hash_digest& tx_hash);
+
+    void subscribe(const system::hash_digest& key, const std::string& name);
+    void unsubscribe(const system::hash_digest& key, const std::string& name);
+
+    system::asio::service& service_;
+    const key_update_handler handler_;
+    const size_t replicas_;
+    const size_t error_limit_;
+    const size_t request_limit_;
+    server_map servers_;
+    ring ring_;
+
+    // The server subscribed to each key, empty if none.
+    owner_map keys_;
+};
+
+} // namespace client
+} // namespace libbitcoin
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_TIME_INDEX_HPP
+#define LIBBITCOIN_CLIENT_TIME_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <bitcoin/system.hpp>
+#include <bitcoin/client/define.hpp>
+#include <bitcoin/client/obelisk_client.hpp>
+
+namespace libbitcoin {
+namespace client {
+
+/// Answers time to height queries from cached header timestamps, using median
+/// time past, which unlike timestamps is monotonic in height. Missing headers
+/// are fetched when a query requires them, as the windows of several probes
+/// at once, so that a search takes few round trips. Fetches are completed by
+/// obelisk_client::wait. Thread safe.
+class BCC_API time_index
+{
+public:
+    /// The number of blocks of which median time past is the median.
+    static const size_t median_time_past_interval = 11;
+
+    typedef std::function<void(const system::code&, size_t)> height_handler;
+    typedef std::function<void(obelisk_client::block_header_handler,
+        uint32_t)> header_fetcher;
+    typedef std::function<void(obelisk_client::height_handler)> top_fetcher;
+
+    /// Index using blockchain_fetch_block_header (by height) and
+    /// blockchain_fetch_last_height of the client.
+    time_index(obelisk_client& client, size_t batch_size=64);
+
+    /// Index using the given fetches.
+    time_index(header_fetcher fetch_header, top_fetcher fetch_top,
+        size_t batch_size=64);
+
+    /// The lowest height with median time past after the time, or
+    /// error::not_found if there is no such block yet. The top height is
+    /// fetched unless set by handle_block.
+    void find_height(height_handler handler, uint32_t time);
+
+    /// The median time past of the block, false if not all cached. This is
+    /// the median timestamp of the block and up to ten preceding blocks.
+    bool median_time_past(size_t height, uint32_t& out_time) const;
+
+    /// Handle a block announced by the block stream, setting the top.
+    void handle_block(size_t height, const system::chain::block& block);
+
+    /// Cache a header timestamp.
+    void store(size_t height, uint32_t timestamp);
+
+    /// The number of header timestamps cached.
+    size_t size() const;
+
+private:
+    struct search;
+    typedef std::shared_ptr<search> search_ptr;
+
+    // These require mutex_ to be locked.
+    bool is_cached(size_t height) const;
+    uint32_t median(size_t height) const;
+
+    void start(search_ptr query);
+    void round(search_ptr query);
+    void evaluate(search_ptr query);
+    void complete(search_ptr query, const system::code& ec, size_t height);
+
+    header_fetcher fetch_header_;
+    top_fetcher fetch_top_;
+    const size_t probes_;
+
+    // Timestamps by height, zero if not cached.
+    std::vector<uint32_t> timestamps_;
+    size_t top_;
+    size_t cached_;
+    mutable system::upgrade_mutex mutex_;
+};
+
+} // namespace client
+} // namespace libbitcoin
+
+#endif
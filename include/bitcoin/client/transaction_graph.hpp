@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_TRANSACTION_GRAPH_HPP
+#define LIBBITCOIN_CLIENT_TRANSACTION_GRAPH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <bitcoin/system.hpp>
+#include <bitcoin/client/define.hpp>
+#include <bitcoin/client/obelisk_client.hpp>
+
+namespace libbitcoin {
+namespace client {
+
+/// Walks the ancestors or descendants of a transaction to a given depth.
+/// Ancestors are the transactions spent by inputs, from mempool and chain.
+/// Descendants are the transactions spending outputs, as indexed by the
+/// server's spend lookup. Each transaction is fetched once, or again if later
+/// found on a shorter path, with a bounded number of requests in flight,
+/// completed by obelisk_client::wait.
+/// Not thread safe.
+class BCC_API transaction_graph
+{
+public:
+    enum class direction
+    {
+        ancestors,
+        descendants
+    };
+
+    /// The walked subgraph in compressed sparse row form. Node zero is the
+    /// root and the edges of node n are edges[offsets[n]] to
+    /// edges[offsets[n + 1]], each the node spent by (ancestors) or spending
+    /// (descendants) node n.
+    struct graph
+    {
+        system::hash_list nodes;
+        std::vector<uint32_t> depths;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> edges;
+    };
+
+    typedef std::function<void(const system::code&, const graph&)>
+        graph_handler;
+    typedef std::function<void(obelisk_client::transaction_handler,
+        const system::hash_digest&)> transaction_fetcher;
+    typedef std::function<void(obelisk_client::spend_handler,
+        const system::chain::output_point&)> spend_fetcher;
+
+    /// Walk using transaction_pool_fetch_transaction2 and
+    /// blockchain_fetch_spend of the client.
+    transaction_graph(obelisk_client& client, size_t maximum_in_flight=64);
+
+    /// Walk using the given fetches.
+    transaction_graph(transaction_fetcher fetch_transaction,
+        spend_fetcher fetch_spend, size_t maximum_in_flight=64);
+
+    /// Walk from the root to the given depth, where depth one is the direct
+    /// parents or children. The handler is invoked once, with the first
+    /// error if any.
+    void walk(graph_handler handler, const system::hash_digest& root,
+        direction walk_direction, size_t depth);
+
+private:
+    struct walk_state;
+    typedef std::shared_ptr<walk_state> walk_ptr;
+
+    void pump(walk_ptr walk);
+    void handle_transaction(walk_ptr walk, uint32_t node,
+        const system::code& ec, const system::chain::transaction& tx);
+    void handle_spend(walk_ptr walk, uint32_t node, const system::code& ec,
+        const system::chain::input_point& spend);
+    void complete(walk_ptr walk, const system::code& ec);
+
+    transaction_fetcher fetch_transaction_;
+    spend_fetcher fetch_spend_;
+    const size_t maximum_in_flight_;
+};
+
+} // namespace client
+} // namespace libbitcoin
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_UNSPENT_SET_HPP
+#define LIBBITCOIN_CLIENT_UNSPENT_SET_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <bitcoin/system.hpp>
+#include <bitcoin/client/coin_selection.hpp>
+#include <bitcoin/client/define.hpp>
+#include <bitcoin/client/history.hpp>
+
+namespace libbitcoin {
+namespace client {
+
+/// The unspent outputs of a set of watched keys, loaded once from history and
+/// kept current by the transaction and block streams, so that coin selection
+/// runs locally. Keys are the sha256 of the output script, as subscribed.
+/// Key notifications of transactions not seen on the stream signal that the
+/// key should be reloaded. Thread safe.
+class BCC_API unspent_set
+{
+public:
+    static const size_t unconfirmed = bc::max_size_t;
+
+    /// Construct a set remembering the given number of recently applied
+    /// transactions, against which key notifications are checked.
+    unspent_set(size_t applied_limit=1024);
+
+    /// Load the unspent outputs of a key from its full history, replacing
+    /// any outputs of the key, and watch the key for stream updates.
+    void load(const system::hash_digest& key, const history::list& rows);
+
+    /// Stop watching the key and remove its outputs.
+    bool unload(const system::hash_digest& key);
+
+    /// Handle a transaction announced by the transaction stream.
+    void handle_transaction(const system::chain::transaction& tx);
+
+    /// Handle a block announced by the block stream.
+    void handle_block(size_t height, const system::chain::block& block);
+
+    /// Handle a key notification, returning false if the transaction has not
+    /// been applied, in which case the key history should be reloaded.
+    bool handle_update(const system::hash_digest& key,
+        const system::hash_digest& tx_hash) const;
+
+    /// Select outputs with at least the given value, without copying the set.
+    void select(system::chain::points_value& out, uint64_t satoshi,
+        system::wallet::select_outputs::algorithm algorithm=
+            system::wallet::select_outputs::algorithm::greedy) const;
+
+    /// Select outputs with at least the given value using coin_selection,
+    /// preferring a selection that requires no change output.
+    bool select(system::chain::points_value& out, uint64_t satoshi,
+        uint64_t cost_of_change,
+        const system::asio::milliseconds& budget) const;
+
+    /// A copy of the unspent outputs.
+    system::chain::points_value unspent() const;
+
+    /// The height of an unspent output, or unconfirmed, false if not found.
+    bool height(const system::chain::output_point& point,
+        size_t& out_height) const;
+
+    /// The total value of the unspent outputs.
+    uint64_t balance() const;
+
+    /// The number of unspent outputs.
+    size_t size() const;
+
+private:
+    struct entry
+    {
+        system::hash_digest key;
+        size_t height;
+    };
+
+    typedef std::unordered_map<system::chain::output_point, size_t>
+        point_index;
+    typedef std::unordered_set<system::hash_digest> hash_set;
+
+    static system::hash_digest to_key(const system::chain::output& output);
+
+    // These require mutex_ to be exclusively locked.
+    bool apply(const system::chain::transaction& tx, size_t height);
+    void add(const system::chain::output_point& point, uint64_t value,
+        const system::hash_digest& key, size_t height);
+    void remove(point_index::iterator it);
+    void remember(const system::hash_digest& tx_hash);
+    coin_selection::positions::iterator locate(uint32_t position);
+
+    const size_t applied_limit_;
+
+    // The unspent outputs, with their keys and heights in parallel.
+    system::chain::points_value unspent_;
+    std::vector<entry> entries_;
+    point_index index_;
+    uint64_t balance_;
+
+    // Positions of nonzero outputs by descending value, for coin_selection.
+    coin_selection::positions descending_;
+
+    hash_set keys_;
+    hash_set applied_;
+    std::deque<system::hash_digest> applied_order_;
+    mutable system::upgrade_mutex mutex_;
+};
+
+} // namespace client
+} // namespace libbitcoin
+
+#endif
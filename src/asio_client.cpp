@@ -0,0 +1,148 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/client/asio_client.hpp>
+
+#include <algorithm>
+
+using namespace bc::system;
+
+namespace libbitcoin {
+namespace client {
+
+#ifndef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+// Without descriptors the client is polled at the interval of wait().
+static constexpr uint32_t poll_milliseconds = 10;
+#endif
+
+asio_client::asio_client(asio::service& service, obelisk_client& client,
+    uint32_t timeout_milliseconds)
+  : service_(service),
+    client_(client),
+    timer_(service),
+    scheduled_(false),
+    stopped_(true)
+{
+    client_.set_request_timeout(asio::milliseconds(timeout_milliseconds));
+}
+
+asio_client::~asio_client()
+{
+    stop();
+}
+
+void asio_client::start()
+{
+    if (!stopped_)
+        return;
+
+    stopped_ = false;
+
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+    for (const auto handle: client_.file_descriptors())
+    {
+        descriptors_.emplace_back(new descriptor(service_, handle));
+        watch(*descriptors_.back());
+    }
+#endif
+
+    process();
+}
+
+// The descriptors are owned by the sockets, so are released and not closed.
+void asio_client::stop()
+{
+    if (stopped_)
+        return;
+
+    stopped_ = true;
+    timer_.cancel();
+
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+    for (const auto& socket: descriptors_)
+    {
+        socket->cancel();
+        socket->release();
+    }
+
+    descriptors_.clear();
+#endif
+}
+
+void asio_client::schedule()
+{
+    if (stopped_ || scheduled_)
+        return;
+
+    scheduled_ = true;
+    boost::asio::post(service_, [this]()
+    {
+        scheduled_ = false;
+        if (!stopped_)
+            process();
+    });
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+void asio_client::process()
+{
+    auto next = client_.process_ready();
+
+#ifndef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+    next = std::min(next, asio::milliseconds(poll_milliseconds));
+#endif
+
+    timer_.cancel();
+    if (stopped_ || next == asio::milliseconds::max())
+        return;
+
+    timer_.expires_after(next);
+    timer_.async_wait([this](const boost::system::error_code& ec)
+    {
+        expire(ec);
+    });
+}
+
+void asio_client::expire(const boost::system::error_code& ec)
+{
+    if (!ec && !stopped_)
+        process();
+}
+
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+// The socket is drained before rearming on this thread, so no edge is missed.
+// A handler may stop the client, releasing the socket, while processing.
+void asio_client::watch(descriptor& socket)
+{
+    socket.async_wait(descriptor::wait_read,
+        [this, &socket](const boost::system::error_code& ec)
+        {
+            if (ec || stopped_)
+                return;
+
+            process();
+            if (!stopped_)
+                watch(socket);
+        });
+}
+#endif
+
+} // namespace client
+} // namespace libbitcoin
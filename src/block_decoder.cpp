@@ -0,0 +1,242 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/client/block_decoder.hpp>
+
+#include <algorithm>
+#include <utility>
+
+using namespace bc::system;
+using namespace bc::system::chain;
+
+namespace libbitcoin {
+namespace client {
+
+block_decoder::block_decoder(size_t threads, bool verify_merkle)
+  : verify_merkle_(verify_merkle),
+    first_(0),
+    bytes_(0),
+    stopped_(false)
+{
+    for (size_t thread = 0; thread < std::max(threads, size_t(1)); ++thread)
+        workers_.emplace_back(&block_decoder::work, this);
+}
+
+block_decoder::~block_decoder()
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    mutex_.lock();
+    stopped_ = true;
+    mutex_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    condition_.notify_all();
+    for (auto& worker: workers_)
+        worker.join();
+}
+
+uint64_t block_decoder::reserve(block_handler handler)
+{
+    const auto reserved = std::make_shared<slot>();
+    reserved->handler = handler;
+    reserved->size = 0;
+    reserved->complete = false;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+    slots_.push_back(reserved);
+    return first_ + slots_.size() - 1;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void block_decoder::decode(uint64_t ticket, data_chunk&& payload)
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    mutex_.lock();
+
+    const auto reserved = find(ticket);
+    if (!reserved || reserved->complete)
+    {
+        mutex_.unlock();
+        return;
+    }
+
+    reserved->size += payload.size();
+    bytes_ += payload.size();
+    jobs_.emplace_back(reserved, std::move(payload));
+    mutex_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    condition_.notify_one();
+}
+
+void block_decoder::fail(uint64_t ticket, const code& ec)
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const auto reserved = find(ticket);
+    if (!reserved || reserved->complete)
+        return;
+
+    reserved->ec = ec;
+    reserved->complete = true;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+size_t block_decoder::deliver()
+{
+    std::vector<slot_ptr> ready;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    mutex_.lock();
+
+    while (!slots_.empty() && slots_.front()->complete)
+    {
+        bytes_ -= slots_.front()->size;
+        ready.push_back(slots_.front());
+        slots_.pop_front();
+        ++first_;
+    }
+
+    mutex_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    for (const auto& delivered: ready)
+        delivered->handler(delivered->ec, delivered->block);
+
+    return ready.size();
+}
+
+// A decode in progress completes into its orphaned slot, which is discarded.
+void block_decoder::clear(const code& ec)
+{
+    std::deque<slot_ptr> cleared;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    mutex_.lock();
+
+    for (const auto& reserved: slots_)
+    {
+        if (!reserved->complete)
+        {
+            reserved->ec = ec;
+            reserved->block = {};
+            reserved->complete = true;
+        }
+    }
+
+    jobs_.clear();
+    bytes_ = 0;
+    first_ += slots_.size();
+    std::swap(cleared, slots_);
+    mutex_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    for (const auto& delivered: cleared)
+        delivered->handler(delivered->ec, delivered->block);
+}
+
+size_t block_decoder::pending() const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+    return slots_.size();
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+size_t block_decoder::bytes() const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+size_t block_decoder::threads() const
+{
+    return workers_.size();
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+block_decoder::slot_ptr block_decoder::find(uint64_t ticket) const
+{
+    if (ticket < first_ || ticket - first_ >= slots_.size())
+        return {};
+
+    return slots_[static_cast<size_t>(ticket - first_)];
+}
+
+void block_decoder::work()
+{
+    while (true)
+    {
+        job next;
+
+        // Critical Section.
+        ///////////////////////////////////////////////////////////////////////
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this]()
+        {
+            return stopped_ || !jobs_.empty();
+        });
+
+        if (stopped_)
+            return;
+
+        next = std::move(jobs_.front());
+        jobs_.pop_front();
+        lock.unlock();
+        ///////////////////////////////////////////////////////////////////////
+
+        data_source istream(next.second);
+        istream_reader source(istream);
+        auto ec = source.read_error_code();
+
+        block decoded;
+        if (!ec && !decoded.from_data(source.read_bytes()))
+            ec = error::bad_stream;
+        else if (!ec && verify_merkle_ && !decoded.is_valid_merkle_root())
+            ec = error::merkle_mismatch;
+
+        // Critical Section.
+        ///////////////////////////////////////////////////////////////////////
+        lock.lock();
+
+        if (!next.first->complete)
+        {
+            next.first->ec = ec;
+            next.first->block = ec ? block{} : std::move(decoded);
+            next.first->complete = true;
+        }
+        ///////////////////////////////////////////////////////////////////////
+    }
+}
+
+} // namespace client
+} // namespace libbitcoin
@@ -0,0 +1,271 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/client/coin_selection.hpp>
+
+#include <algorithm>
+#include <random>
+
+using namespace bc::system;
+using namespace bc::system::chain;
+using namespace std::chrono;
+
+namespace libbitcoin {
+namespace client {
+
+// The clock is read once per this many branch and bound tries.
+static constexpr size_t clock_interval = 1024;
+
+coin_selection::coin_selection(const points_value& unspent)
+  : unspent_(unspent), descending_(sorted_), value_(0)
+{
+    const auto& points = unspent_.points;
+    BITCOIN_ASSERT(points.size() <= max_uint32);
+    sorted_.reserve(points.size());
+
+    for (uint32_t position = 0; position < points.size(); ++position)
+    {
+        if (points[position].value() == 0)
+            continue;
+
+        sorted_.push_back(position);
+        value_ += points[position].value();
+    }
+
+    std::sort(sorted_.begin(), sorted_.end(),
+        [this](uint32_t left, uint32_t right)
+        {
+            return value_at(left) > value_at(right);
+        });
+}
+
+coin_selection::coin_selection(const points_value& unspent,
+    const positions& descending, uint64_t value)
+  : unspent_(unspent), descending_(descending), value_(value)
+{
+}
+
+bool coin_selection::select(points_value& out, uint64_t target,
+    uint64_t cost_of_change, const asio::milliseconds& budget) const
+{
+    out.points.clear();
+
+    if (target == 0)
+        return true;
+
+    if (value_ < target)
+        return false;
+
+    const auto start = steady_clock::now();
+    return branch_and_bound(out, target, cost_of_change, start + budget / 2) ||
+        knapsack(out, target, start + budget);
+}
+
+// This follows the Bitcoin Core search, with the remaining value as lookahead
+// and equal valued siblings of an omitted output omitted in turn.
+bool coin_selection::branch_and_bound(points_value& out, uint64_t target,
+    uint64_t cost_of_change, const time_point& deadline,
+    size_t max_tries) const
+{
+    out.points.clear();
+    const auto upper = target > max_uint64 - cost_of_change ? max_uint64 :
+        target + cost_of_change;
+
+    positions selection;
+    positions best;
+    auto best_excess = max_uint64;
+    uint64_t current = 0;
+    auto available = value_;
+    size_t depth = 0;
+
+    for (size_t tries = 0; tries < max_tries; ++tries, ++depth)
+    {
+        if (tries % clock_interval == 0 && steady_clock::now() > deadline)
+            break;
+
+        auto backtrack = false;
+
+        if (current + available < target || current > upper)
+        {
+            backtrack = true;
+        }
+        else if (current >= target)
+        {
+            if (current - target < best_excess)
+            {
+                best_excess = current - target;
+                best.clear();
+                for (const auto index: selection)
+                    best.push_back(descending_[index]);
+
+                if (best_excess == 0)
+                    break;
+            }
+
+            backtrack = true;
+        }
+
+        if (backtrack)
+        {
+            if (selection.empty())
+                break;
+
+            // Restore the omitted outputs, then omit the last included.
+            for (--depth; depth > selection.back(); --depth)
+                available += value_at(descending_[depth]);
+
+            current -= value_at(descending_[depth]);
+            selection.pop_back();
+            continue;
+        }
+
+        const auto value = value_at(descending_[depth]);
+        available -= value;
+
+        if (selection.empty() || depth - 1 == selection.back() ||
+            value != value_at(descending_[depth - 1]))
+        {
+            selection.push_back(static_cast<uint32_t>(depth));
+            current += value;
+        }
+    }
+
+    if (best_excess == max_uint64)
+        return false;
+
+    emit(out, best);
+    return true;
+}
+
+// The smaller outputs are the tail of the descending index.
+bool coin_selection::knapsack(points_value& out, uint64_t target,
+    const time_point& deadline, size_t iterations) const
+{
+    out.points.clear();
+
+    const auto split = std::partition_point(descending_.begin(),
+        descending_.end(), [this, target](uint32_t position)
+        {
+            return value_at(position) >= target;
+        });
+
+    const auto has_larger = split != descending_.begin();
+    const positions smaller(split, descending_.end());
+
+    uint64_t total = 0;
+    for (const auto position: smaller)
+        total += value_at(position);
+
+    if (total == target)
+    {
+        emit(out, smaller);
+        return true;
+    }
+
+    const auto lowest_larger = has_larger ? *std::prev(split) : 0;
+
+    if (total < target)
+    {
+        if (!has_larger)
+            return false;
+
+        emit(out, { lowest_larger });
+        return true;
+    }
+
+    // Approximate the subset of smaller outputs with the least excess.
+    std::mt19937_64 random;
+    std::vector<bool> included(smaller.size());
+    auto best = std::vector<bool>(smaller.size(), true);
+    auto best_value = total;
+
+    for (size_t iteration = 0; iteration < iterations &&
+        best_value != target && steady_clock::now() <= deadline; ++iteration)
+    {
+        std::fill(included.begin(), included.end(), false);
+        uint64_t sum = 0;
+        auto reached = false;
+        uint64_t bits = 0;
+
+        for (auto pass = 0; pass < 2 && !reached; ++pass)
+        {
+            for (size_t index = 0; index < smaller.size(); ++index)
+            {
+                if (index % 64 == 0)
+                    bits = random();
+
+                const auto coin = ((bits >> (index % 64)) & 1) != 0;
+                if (pass == 0 ? !coin : included[index])
+                    continue;
+
+                sum += value_at(smaller[index]);
+                included[index] = true;
+
+                if (sum >= target)
+                {
+                    reached = true;
+                    if (sum < best_value)
+                    {
+                        best_value = sum;
+                        best = included;
+                    }
+
+                    sum -= value_at(smaller[index]);
+                    included[index] = false;
+                }
+            }
+        }
+    }
+
+    if (has_larger && value_at(lowest_larger) <= best_value)
+    {
+        emit(out, { lowest_larger });
+        return true;
+    }
+
+    positions selected;
+    for (size_t index = 0; index < smaller.size(); ++index)
+        if (best[index])
+            selected.push_back(smaller[index]);
+
+    emit(out, selected);
+    return true;
+}
+
+uint64_t coin_selection::value() const
+{
+    return value_;
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+uint64_t coin_selection::value_at(uint32_t position) const
+{
+    return unspent_.points[position].value();
+}
+
+void coin_selection::emit(points_value& out, const positions& selected) const
+{
+    out.points.reserve(selected.size());
+    for (const auto position: selected)
+        out.points.push_back(unspent_.points[position]);
+}
+
+} // namespace client
+} // namespace libbitcoin
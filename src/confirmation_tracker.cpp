@@ -0,0 +1,240 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/client/confirmation_tracker.hpp>
+
+#include <algorithm>
+
+using namespace bc::system;
+using namespace bc::system::chain;
+
+namespace libbitcoin {
+namespace client {
+
+static void erase_hash(hash_list& hashes, const hash_digest& hash)
+{
+    const auto it = std::find(hashes.begin(), hashes.end(), hash);
+    if (it != hashes.end())
+        hashes.erase(it);
+}
+
+confirmation_tracker::confirmation_tracker(size_t reorganization_limit)
+  : reorganization_limit_(std::max(reorganization_limit, size_t(1))),
+    top_(unconfirmed)
+{
+}
+
+void confirmation_tracker::track(const hash_digest& tx_hash,
+    const std::vector<size_t>& depths, confirmation_handler handler,
+    size_t height)
+{
+    entry value{ unconfirmed, depths, 0, handler };
+    auto& targets = value.depths;
+    std::sort(targets.begin(), targets.end());
+    targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+    targets.erase(std::remove(targets.begin(), targets.end(), 0),
+        targets.end());
+
+    if (targets.empty())
+        return;
+
+    notifications out;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    mutex_.lock();
+
+    const auto existing = entries_.find(tx_hash);
+    if (existing != entries_.end() && existing->second.height != unconfirmed)
+        erase_hash(confirmed_[existing->second.height], tx_hash);
+
+    auto& tracked = entries_[tx_hash];
+    tracked = value;
+
+    if (height != unconfirmed)
+    {
+        confirm(tx_hash, tracked, height);
+        report(out);
+    }
+
+    mutex_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    for (const auto& notice: out)
+        notice.handler(error::success, notice.height, notice.depth);
+}
+
+bool confirmation_tracker::untrack(const hash_digest& tx_hash)
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    const auto it = entries_.find(tx_hash);
+    if (it == entries_.end())
+        return false;
+
+    if (it->second.height != unconfirmed)
+        erase_hash(confirmed_[it->second.height], tx_hash);
+
+    entries_.erase(it);
+    return true;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void confirmation_tracker::handle_block(size_t height, const block& block)
+{
+    notifications out;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    mutex_.lock();
+
+    // A block at or below the top replaces the blocks from its height, and a
+    // block that does not link to its parent replaces the parent as well.
+    if (top_ != unconfirmed && height <= top_)
+        reorganize(height, out);
+
+    const auto parent = height == 0 ? blocks_.end() : blocks_.find(height - 1);
+    if (parent != blocks_.end() &&
+        parent->second != block.header().previous_block_hash())
+        reorganize(height - 1, out);
+
+    for (const auto& tx: block.transactions())
+    {
+        const auto tx_hash = tx.hash();
+        const auto it = entries_.find(tx_hash);
+        if (it != entries_.end())
+            confirm(tx_hash, it->second, height);
+    }
+
+    top_ = height;
+    blocks_[height] = block.hash();
+
+    // Retain only the block hashes required to detect reorganization.
+    while (blocks_.size() > reorganization_limit_)
+        blocks_.erase(blocks_.begin());
+
+    report(out);
+    mutex_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    for (const auto& notice: out)
+        notice.handler(error::success, notice.height, notice.depth);
+}
+
+size_t confirmation_tracker::top_height() const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+    return top_;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+size_t confirmation_tracker::size() const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+    return entries_.size();
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+void confirmation_tracker::confirm(const hash_digest& tx_hash, entry& value,
+    size_t height)
+{
+    if (value.height == height)
+        return;
+
+    if (value.height != unconfirmed)
+        erase_hash(confirmed_[value.height], tx_hash);
+
+    value.height = height;
+    confirmed_[height].push_back(tx_hash);
+}
+
+// Transactions confirmed at or above height revert to unconfirmed.
+void confirmation_tracker::reorganize(size_t height, notifications& out)
+{
+    const auto start = confirmed_.lower_bound(height);
+    for (auto it = start; it != confirmed_.end(); ++it)
+    {
+        for (const auto& tx_hash: it->second)
+        {
+            auto& value = entries_[tx_hash];
+            if (value.reported != 0)
+                out.push_back({ value.handler, value.height, 0 });
+
+            value.height = unconfirmed;
+            value.reported = 0;
+        }
+    }
+
+    confirmed_.erase(start, confirmed_.end());
+    blocks_.erase(blocks_.lower_bound(height), blocks_.end());
+    top_ = height == 0 ? unconfirmed : height - 1;
+}
+
+// Report reached depths, and stop tracking once all have been reported.
+void confirmation_tracker::report(notifications& out)
+{
+    if (top_ == unconfirmed)
+        return;
+
+    for (auto it = confirmed_.begin(); it != confirmed_.end();)
+    {
+        const auto height = it->first;
+        auto& hashes = it->second;
+
+        // A provided height may be above the top, reported once reached.
+        if (height > top_)
+            break;
+
+        const auto depth = top_ - height + 1;
+        for (auto tx = hashes.begin(); tx != hashes.end();)
+        {
+            const auto value = entries_.find(*tx);
+            auto& tracked = value->second;
+            const auto& depths = tracked.depths;
+
+            while (tracked.reported < depths.size() &&
+                depths[tracked.reported] <= depth)
+                out.push_back({ tracked.handler, height,
+                    depths[tracked.reported++] });
+
+            if (tracked.reported == depths.size())
+            {
+                entries_.erase(value);
+                tx = hashes.erase(tx);
+            }
+            else
+            {
+                ++tx;
+            }
+        }
+
+        it = hashes.empty() ? confirmed_.erase(it) : std::next(it);
+    }
+}
+
+} // namespace client
+} // namespace libbitcoin
@@ -0,0 +1,320 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/client/double_spend_detector.hpp>
+
+#include <algorithm>
+
+using namespace bc::system;
+using namespace bc::system::chain;
+
+namespace libbitcoin {
+namespace client {
+
+static constexpr uint64_t empty_key = 0;
+static constexpr uint64_t golden_ratio = 0x9e3779b97f4a7c15;
+
+// The table is at most three quarters full, as a power of two.
+static size_t slot_bits(size_t capacity)
+{
+    const auto minimum = std::max(capacity + capacity / 3, size_t(2));
+    size_t bits = 1;
+    while ((size_t(1) << bits) < minimum)
+        ++bits;
+
+    return bits;
+}
+
+double_spend_detector::double_spend_detector(size_t capacity)
+  : capacity_(std::max(capacity, size_t(1))),
+    mask_((size_t(1) << slot_bits(capacity_)) - 1),
+    shift_(64 - slot_bits(capacity_)),
+    slots_(mask_ + 1, slot{ empty_key, 0 }),
+    size_(0),
+    evicted_(0)
+{
+}
+
+void double_spend_detector::watch(const transaction& payment,
+    conflict_handler handler)
+{
+    if (payment.is_coinbase())
+        return;
+
+    notifications out;
+    const auto spender = payment.hash();
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    mutex_.lock();
+
+    for (const auto& input: payment.inputs())
+        add_watch(input.previous_output(), spender, handler, out);
+
+    mutex_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    for (const auto& notice: out)
+        notice.handler(notice.point, notice.spender, notice.conflict);
+}
+
+void double_spend_detector::watch(const output_point& point,
+    const hash_digest& spender, conflict_handler handler)
+{
+    notifications out;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    mutex_.lock();
+    add_watch(point, spender, handler, out);
+    mutex_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    for (const auto& notice: out)
+        notice.handler(notice.point, notice.spender, notice.conflict);
+}
+
+bool double_spend_detector::unwatch(const output_point& point)
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+    return watches_.erase(point) != 0;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// The first spend seen of an outpoint is retained in the index.
+void double_spend_detector::handle_transaction(const transaction& tx)
+{
+    if (tx.is_coinbase())
+        return;
+
+    notifications out;
+    const auto tx_hash = tx.hash();
+    const auto spender = short_id(tx_hash);
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    mutex_.lock();
+
+    for (const auto& input: tx.inputs())
+    {
+        const auto& point = input.previous_output();
+        const auto index = find(key(point));
+
+        if (index == slots_.size())
+            insert(key(point), spender);
+        else if (slots_[index].spender == spender)
+            continue;
+
+        if (watches_.empty())
+            continue;
+
+        const auto watch = watches_.find(point);
+        if (watch != watches_.end() && watch->second.spender != tx_hash)
+            out.push_back({ watch->second.handler, point,
+                watch->second.spender, tx_hash });
+    }
+
+    mutex_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    for (const auto& notice: out)
+        notice.handler(notice.point, notice.spender, notice.conflict);
+}
+
+// A confirmed spend can no longer be replaced, so its conflicts are moot.
+void double_spend_detector::handle_block(const block& block)
+{
+    notifications out;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    mutex_.lock();
+
+    for (const auto& tx: block.transactions())
+    {
+        if (tx.is_coinbase())
+            continue;
+
+        const auto tx_hash = tx.hash();
+        for (const auto& input: tx.inputs())
+        {
+            const auto& point = input.previous_output();
+            const auto index = find(key(point));
+            if (index != slots_.size())
+                erase(index);
+
+            const auto watch = watches_.find(point);
+            if (watch == watches_.end())
+                continue;
+
+            if (watch->second.spender != tx_hash)
+                out.push_back({ watch->second.handler, point,
+                    watch->second.spender, tx_hash });
+
+            watches_.erase(watch);
+        }
+    }
+
+    mutex_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    for (const auto& notice: out)
+        notice.handler(notice.point, notice.spender, notice.conflict);
+}
+
+size_t double_spend_detector::size() const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+    return size_;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+size_t double_spend_detector::capacity() const
+{
+    return capacity_;
+}
+
+size_t double_spend_detector::evicted() const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+    return evicted_;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+size_t double_spend_detector::watched() const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+    return watches_.size();
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+// The point checksum combines the tx hash and index, with zero reserved.
+uint64_t double_spend_detector::key(const output_point& point)
+{
+    const auto checksum = point.checksum();
+    return checksum == empty_key ? 1 : checksum;
+}
+
+uint64_t double_spend_detector::short_id(const hash_digest& hash)
+{
+    return from_little_endian_unsafe<uint64_t>(hash.begin());
+}
+
+// The checksum places the index in its low bits, so buckets are taken from
+// the high bits of a multiplicative hash.
+size_t double_spend_detector::bucket(uint64_t key) const
+{
+    return static_cast<size_t>((key * golden_ratio) >> shift_);
+}
+
+size_t double_spend_detector::find(uint64_t key) const
+{
+    for (auto index = bucket(key); slots_[index].key != empty_key;
+        index = (index + 1) & mask_)
+        if (slots_[index].key == key)
+            return index;
+
+    return slots_.size();
+}
+
+// The oldest spend is evicted if the table is at capacity, in which case a
+// later conflict with it is detected only if the outpoint is watched.
+void double_spend_detector::insert(uint64_t key, uint64_t spender)
+{
+    if (size_ == capacity_)
+        evict();
+
+    auto index = bucket(key);
+    while (slots_[index].key != empty_key)
+        index = (index + 1) & mask_;
+
+    slots_[index] = { key, spender };
+    ++size_;
+
+    // Keys of confirmed spends are purged once they dominate the order.
+    insertions_.push_back(key);
+    if (insertions_.size() > 2 * capacity_)
+        insertions_.erase(std::remove_if(insertions_.begin(),
+            insertions_.end(), [this](uint64_t value)
+            {
+                return find(value) == slots_.size();
+            }), insertions_.end());
+}
+
+// Backward shift deletion keeps probe sequences intact without tombstones.
+void double_spend_detector::erase(size_t index)
+{
+    auto hole = index;
+    for (auto next = (hole + 1) & mask_; slots_[next].key != empty_key;
+        next = (next + 1) & mask_)
+    {
+        const auto home = bucket(slots_[next].key);
+        if (((next - home) & mask_) >= ((next - hole) & mask_))
+        {
+            slots_[hole] = slots_[next];
+            hole = next;
+        }
+    }
+
+    slots_[hole] = { empty_key, 0 };
+    --size_;
+}
+
+// Keys are removed from the insertion order lazily, so confirmed spends are
+// skipped.
+void double_spend_detector::evict()
+{
+    while (!insertions_.empty())
+    {
+        const auto index = find(insertions_.front());
+        insertions_.pop_front();
+
+        if (index != slots_.size())
+        {
+            erase(index);
+            ++evicted_;
+            return;
+        }
+    }
+}
+
+void double_spend_detector::add_watch(const output_point& point,
+    const hash_digest& spender, conflict_handler handler, notifications& out)
+{
+    watches_[point] = { spender, handler };
+
+    const auto index = find(key(point));
+    if (index == slots_.size())
+        insert(key(point), short_id(spender));
+    else if (slots_[index].spender != short_id(spender))
+        out.push_back({ handler, point, spender, null_hash });
+}
+
+} // namespace client
+} // namespace libbitcoin
@@ -0,0 +1,511 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/client/gateway.hpp>
+
+#include <algorithm>
+#include <zmq.h>
+
+using namespace bc::protocol;
+using namespace bc::system;
+using namespace bc::system::config;
+using namespace std::chrono;
+
+namespace libbitcoin {
+namespace client {
+
+// Subscribers are expired at most at this interval (or their expiration if
+// shorter), and without descriptors the router socket is also polled at it.
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+static constexpr auto sweep_milliseconds = 60000;
+#else
+static constexpr auto sweep_milliseconds = 10;
+#endif
+
+static const std::string subscribe_command = "subscribe.key";
+static const std::string unsubscribe_command = "unsubscribe.key";
+static const std::string notification_command = "notification.key";
+
+static data_chunk error_payload(const code& ec)
+{
+    return to_chunk(to_little_endian(static_cast<uint32_t>(ec.value())));
+}
+
+gateway::gateway(asio::service& service, size_t cache_capacity,
+    uint32_t cache_time_to_live_milliseconds,
+    uint32_t subscription_expiration_minutes,
+    uint32_t request_timeout_milliseconds)
+  : service_(service),
+    client_(0),
+    adapter_(service, client_, request_timeout_milliseconds),
+    cache_(cache_capacity, cache_time_to_live_milliseconds),
+    expiration_(subscription_expiration_minutes),
+    router_(context_, zmq::socket::role::router),
+    timer_(service),
+    cache_hits_(0),
+    coalesced_(0),
+    upstream_requests_(0),
+    scheduled_(false),
+    stopped_(true)
+{
+}
+
+gateway::~gateway()
+{
+    stop();
+}
+
+bool gateway::start(const connection_settings& upstream,
+    const endpoint& downstream)
+{
+    if (!stopped_)
+        return false;
+
+    if (!client_.connect(upstream) || router_.bind(downstream))
+        return false;
+
+    stopped_ = false;
+    adapter_.start();
+
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+    obelisk_client::file_descriptor handle;
+    auto size = sizeof(handle);
+    if (zmq_getsockopt(router_.self(), ZMQ_FD, &handle, &size) == 0)
+    {
+        descriptor_.reset(new descriptor(service_, handle));
+        watch();
+    }
+#endif
+
+    sweep({});
+    receive();
+    return true;
+}
+
+// The descriptor is owned by the socket, so is released and not closed.
+void gateway::stop()
+{
+    if (stopped_)
+        return;
+
+    stopped_ = true;
+    timer_.cancel();
+    adapter_.stop();
+
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+    if (descriptor_)
+    {
+        descriptor_->cancel();
+        descriptor_->release();
+        descriptor_.reset();
+    }
+#endif
+
+    router_.stop();
+}
+
+size_t gateway::cache_hits() const
+{
+    return cache_hits_;
+}
+
+size_t gateway::coalesced() const
+{
+    return coalesced_;
+}
+
+size_t gateway::upstream_requests() const
+{
+    return upstream_requests_;
+}
+
+size_t gateway::upstream_subscriptions() const
+{
+    return subscriptions_.size();
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+// Broadcasts and validations have effects, so are neither cached nor joined.
+bool gateway::is_query(const std::string& command)
+{
+    return command.find("blockchain.fetch_") == 0 ||
+        command.find("transaction_pool.fetch_") == 0 ||
+        command == "server.version";
+}
+
+// The router socket signals by edge, so is drained until it has no input.
+void gateway::receive()
+{
+    const auto has_input = [this]()
+    {
+        int events;
+        auto size = sizeof(events);
+        return zmq_getsockopt(router_.self(), ZMQ_EVENTS, &events, &size) ==
+            0 && (events & ZMQ_POLLIN) != 0;
+    };
+
+    while (!stopped_ && has_input())
+    {
+        // A failed receive is not retried, as the error may persist.
+        zmq::message message;
+        if (router_.receive(message))
+            break;
+
+        requester origin;
+        origin.delimited = false;
+        origin.id = 0;
+        std::string command;
+        data_chunk payload;
+
+        message.dequeue(origin.identity);
+
+        // Retain the delimiter if the client includes it.
+        if (message.size() == 4)
+        {
+            message.dequeue();
+            origin.delimited = true;
+        }
+
+        if (message.size() != 3 || !message.dequeue(command) ||
+            !message.dequeue(origin.id) || !message.dequeue(payload))
+            continue;
+
+        handle(origin, command, payload);
+    }
+
+    scheduled_ = false;
+}
+
+// Sending consumes the edge of the descriptor, so input is checked again.
+void gateway::schedule()
+{
+    if (stopped_ || scheduled_)
+        return;
+
+    scheduled_ = true;
+    boost::asio::post(service_, [this]()
+    {
+        receive();
+    });
+}
+
+void gateway::handle(const requester& origin, const std::string& command,
+    const data_chunk& payload)
+{
+    if (command == subscribe_command)
+        subscribe(origin, payload);
+    else if (command == unsubscribe_command)
+        unsubscribe(origin, payload);
+    else if (is_query(command))
+        query(origin, command, payload);
+    else
+        forward(origin, command, payload);
+}
+
+// Only successful responses are cached. The client fails the upstream request
+// at its deadline (see asio_client), which answers and ends the waiters.
+void gateway::query(const requester& origin, const std::string& command,
+    const data_chunk& payload)
+{
+    data_chunk response;
+    if (cache_.find(command, payload, response))
+    {
+        ++cache_hits_;
+        send(origin, command, response);
+        return;
+    }
+
+    const auto key = response_cache::to_key(command, payload);
+    auto& waiting = inflight_[key];
+    waiting.push_back(origin);
+    if (waiting.size() > 1)
+    {
+        ++coalesced_;
+        return;
+    }
+
+    ++upstream_requests_;
+    client_.send_command([this, key, command, payload](const code& ec,
+        const data_chunk& response)
+    {
+        const auto result = ec ? error_payload(ec) : response;
+        if (!ec && result.size() >= 4 &&
+            from_little_endian_unsafe<uint32_t>(result.begin()) == 0)
+            cache_.store(command, payload, result);
+
+        const auto it = inflight_.find(key);
+        if (it == inflight_.end())
+            return;
+
+        const auto waiting = std::move(it->second);
+        inflight_.erase(it);
+        for (const auto& origin: waiting)
+            send(origin, command, result);
+
+        schedule();
+    }, command, payload);
+
+    adapter_.schedule();
+}
+
+void gateway::forward(const requester& origin, const std::string& command,
+    const data_chunk& payload)
+{
+    ++upstream_requests_;
+    client_.send_command([this, origin, command](const code& ec,
+        const data_chunk& response)
+    {
+        send(origin, command, ec ? error_payload(ec) : response);
+        schedule();
+    }, command, payload);
+
+    adapter_.schedule();
+}
+
+// A subscriber that subscribes again renews its subscription.
+void gateway::subscribe(const requester& origin, const data_chunk& payload)
+{
+    if (payload.size() != hash_size)
+    {
+        send(origin, subscribe_command, error_payload(error::bad_stream));
+        return;
+    }
+
+    hash_digest key;
+    std::copy(payload.begin(), payload.end(), key.begin());
+    const auto expiry = steady_clock::now() + expiration_;
+
+    auto it = subscriptions_.find(key);
+    if (it == subscriptions_.end())
+    {
+        it = subscriptions_.emplace(key, key_subscription{}).first;
+        it->second.upstream = obelisk_client::null_subscription;
+        it->second.subscribed = false;
+    }
+
+    auto& subscription = it->second;
+    auto& subscribers = subscription.subscribers;
+    const auto existing = std::find_if(subscribers.begin(), subscribers.end(),
+        [&origin](const subscriber& value)
+        {
+            return value.origin.identity == origin.identity;
+        });
+
+    if (existing != subscribers.end())
+    {
+        existing->origin = origin;
+        existing->expiry = expiry;
+    }
+    else
+    {
+        subscribers.push_back({ origin, expiry, false });
+    }
+
+    if (subscription.subscribed)
+    {
+        for (auto& value: subscribers)
+            if (value.origin.identity == origin.identity)
+                value.confirmed = true;
+
+        send(origin, subscribe_command, error_payload(error::success));
+        return;
+    }
+
+    if (subscription.upstream != obelisk_client::null_subscription)
+        return;
+
+    // A failure may be notified before returning, ending the subscription.
+    const auto upstream = client_.subscribe_key(
+        [this, key](const code& ec, uint16_t sequence, size_t height,
+            const hash_digest& tx_hash)
+        {
+            notify(key, ec, sequence, height, tx_hash);
+        }, key);
+
+    const auto subscribed = subscriptions_.find(key);
+    if (subscribed != subscriptions_.end())
+        subscribed->second.upstream = upstream;
+
+    adapter_.schedule();
+}
+
+void gateway::unsubscribe(const requester& origin, const data_chunk& payload)
+{
+    if (payload.size() != hash_size)
+    {
+        send(origin, unsubscribe_command, error_payload(error::bad_stream));
+        return;
+    }
+
+    hash_digest key;
+    std::copy(payload.begin(), payload.end(), key.begin());
+
+    const auto it = subscriptions_.find(key);
+    if (it != subscriptions_.end())
+    {
+        auto& subscribers = it->second.subscribers;
+        subscribers.erase(std::remove_if(subscribers.begin(),
+            subscribers.end(), [&origin](const subscriber& value)
+            {
+                return value.origin.identity == origin.identity;
+            }), subscribers.end());
+
+        if (subscribers.empty())
+            release(key);
+    }
+
+    send(origin, unsubscribe_command, error_payload(error::success));
+}
+
+// An upstream failure ends the subscription of the key for all subscribers.
+// The client acknowledges upon sending and again upon the server's response,
+// so acknowledgements (null transaction hash) after the first are dropped.
+void gateway::notify(const hash_digest& key, const code& ec,
+    uint16_t sequence, size_t height, const hash_digest& tx_hash)
+{
+    const auto it = subscriptions_.find(key);
+    if (it == subscriptions_.end())
+        return;
+
+    auto& subscription = it->second;
+    if (ec)
+    {
+        const auto payload = error_payload(ec);
+        for (const auto& value: subscription.subscribers)
+            send(value.origin, value.confirmed ? notification_command :
+                subscribe_command, payload);
+
+        subscriptions_.erase(it);
+    }
+    else if (tx_hash == null_hash)
+    {
+        if (subscription.subscribed)
+            return;
+
+        subscription.subscribed = true;
+        const auto payload = error_payload(error::success);
+        for (auto& value: subscription.subscribers)
+        {
+            value.confirmed = true;
+            send(value.origin, subscribe_command, payload);
+        }
+    }
+    else
+    {
+        const auto payload = build_chunk(
+        {
+            error_payload(error::success),
+            to_little_endian(sequence),
+            to_little_endian(static_cast<uint32_t>(height)),
+            tx_hash
+        });
+
+        for (const auto& value: subscription.subscribers)
+            if (value.confirmed)
+                send(value.origin, notification_command, payload);
+    }
+
+    schedule();
+}
+
+void gateway::release(const hash_digest& key)
+{
+    const auto it = subscriptions_.find(key);
+    if (it == subscriptions_.end())
+        return;
+
+    if (it->second.upstream != obelisk_client::null_subscription)
+    {
+        client_.unsubscribe_key([](const code&) {}, it->second.upstream);
+        adapter_.schedule();
+    }
+
+    subscriptions_.erase(it);
+}
+
+void gateway::send(const requester& origin, const std::string& command,
+    const data_chunk& payload)
+{
+    zmq::message message;
+    message.enqueue(origin.identity);
+
+    if (origin.delimited)
+        message.enqueue();
+
+    message.enqueue(to_chunk(command));
+    message.enqueue(to_chunk(to_little_endian(origin.id)));
+    message.enqueue(payload);
+    router_.send(message);
+}
+
+void gateway::sweep(const boost::system::error_code& ec)
+{
+    if (ec || stopped_)
+        return;
+
+#ifndef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+    receive();
+#endif
+
+    const auto now = steady_clock::now();
+    std::vector<hash_digest> abandoned;
+
+    for (auto& subscription: subscriptions_)
+    {
+        auto& subscribers = subscription.second.subscribers;
+        subscribers.erase(std::remove_if(subscribers.begin(),
+            subscribers.end(), [&now](const subscriber& value)
+            {
+                return value.expiry <= now;
+            }), subscribers.end());
+
+        if (subscribers.empty())
+            abandoned.push_back(subscription.first);
+    }
+
+    for (const auto& key: abandoned)
+        release(key);
+
+    const auto expiration = duration_cast<milliseconds>(expiration_);
+    timer_.expires_after(std::max(milliseconds(1),
+        std::min(milliseconds(sweep_milliseconds), expiration)));
+    timer_.async_wait([this](const boost::system::error_code& error)
+    {
+        sweep(error);
+    });
+}
+
+#ifdef BOOST_ASIO_HAS_POSIX_STREAM_DESCRIPTOR
+void gateway::watch()
+{
+    descriptor_->async_wait(descriptor::wait_read,
+        [this](const boost::system::error_code& ec)
+        {
+            if (ec || stopped_)
+                return;
+
+            receive();
+            watch();
+        });
+}
+#endif
+
+} // namespace client
+} // namespace libbitcoin
@@ -0,0 +1,421 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/client/index_cache.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <unordered_set>
+
+using namespace bc::system;
+using namespace bc::system::chain;
+
+namespace libbitcoin {
+namespace client {
+
+static constexpr size_t unknown = max_size_t;
+static constexpr uint32_t file_magic = 0x4c424943;
+static constexpr uint32_t file_version = 1;
+
+static void write_4_bytes(std::ostream& out, uint32_t value)
+{
+    const auto bytes = to_little_endian(value);
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+static void write_hash(std::ostream& out, const hash_digest& hash)
+{
+    out.write(reinterpret_cast<const char*>(hash.data()), hash.size());
+}
+
+static uint32_t read_4_bytes(std::istream& in)
+{
+    byte_array<4> bytes{};
+    in.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    return from_little_endian_unsafe<uint32_t>(bytes.begin());
+}
+
+static hash_digest read_hash(std::istream& in)
+{
+    hash_digest hash{};
+    in.read(reinterpret_cast<char*>(hash.data()), hash.size());
+    return hash;
+}
+
+index_cache::index_cache(size_t reorganization_limit, size_t capacity)
+  : reorganization_limit_(std::max(reorganization_limit, size_t(1))),
+    capacity_(std::max(capacity, size_t(1))),
+    top_(unknown)
+{
+}
+
+bool index_cache::find_height(const hash_digest& block_hash,
+    size_t& out_height) const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+
+    // Without a top height reorganized entries cannot be invalidated.
+    if (top_ == unknown)
+        return false;
+
+    const auto it = heights_.find(block_hash);
+    if (it == heights_.end())
+        return false;
+
+    out_height = it->second;
+    return true;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+bool index_cache::find_transaction(const hash_digest& tx_hash,
+    size_t& out_height, size_t& out_position) const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    mutex_.lock_shared();
+
+    if (find(tx_hash, out_height, out_position))
+    {
+        mutex_.unlock_shared();
+        return true;
+    }
+
+    mutex_.unlock_shared();
+    ///////////////////////////////////////////////////////////////////////////
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    // The transaction may have been cached since the shared lock was released.
+    if (find(tx_hash, out_height, out_position))
+        return true;
+
+    want(tx_hash);
+    return false;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void index_cache::store_height(const hash_digest& block_hash, size_t height)
+{
+    if (height > max_uint32)
+        return;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    if (top_ == unknown)
+        return;
+
+    heights_[block_hash] = static_cast<uint32_t>(height);
+    track(height, block_hash);
+    admit(block_hash);
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void index_cache::store_transaction(const hash_digest& tx_hash, size_t height,
+    size_t position)
+{
+    if (height > max_uint32 || position > max_uint32)
+        return;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    if (top_ == unknown)
+        return;
+
+    transactions_[tx_hash] =
+    {
+        static_cast<uint32_t>(height), static_cast<uint32_t>(position)
+    };
+
+    track(height, tx_hash);
+    admit(tx_hash);
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void index_cache::handle_block(size_t height, const block& block)
+{
+    if (height > max_uint32)
+        return;
+
+    const auto block_hash = block.hash();
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    // A block at or below the top replaces the blocks from its height, and a
+    // block that does not link to its parent replaces the parent as well.
+    if (top_ != unknown && height <= top_)
+        invalidate(height);
+
+    const auto parent = height == 0 ? blocks_.end() : blocks_.find(height - 1);
+    if (parent != blocks_.end() &&
+        parent->second != block.header().previous_block_hash())
+        invalidate(height - 1);
+
+    top_ = height;
+    blocks_[height] = block_hash;
+    heights_[block_hash] = static_cast<uint32_t>(height);
+    track(height, block_hash);
+    admit(block_hash);
+
+    // Only transactions a caller has looked up are cached.
+    const auto& txs = block.transactions();
+    for (uint32_t position = 0; !wanted_.empty() && position < txs.size();
+        ++position)
+    {
+        const auto tx_hash = txs[position].hash();
+        if (wanted_.erase(tx_hash) == 0)
+            continue;
+
+        transactions_[tx_hash] = { static_cast<uint32_t>(height), position };
+        track(height, tx_hash);
+        admit(tx_hash);
+    }
+
+    prune();
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+bool index_cache::save(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+
+    std::unordered_set<hash_digest> recent;
+    for (const auto& height: recent_)
+        recent.insert(height.second.begin(), height.second.end());
+
+    uint32_t blocks = 0;
+    for (const auto& entry: heights_)
+        blocks += recent.count(entry.first) == 0 ? 1 : 0;
+
+    uint32_t transactions = 0;
+    for (const auto& entry: transactions_)
+        transactions += recent.count(entry.first) == 0 ? 1 : 0;
+
+    write_4_bytes(file, file_magic);
+    write_4_bytes(file, file_version);
+
+    write_4_bytes(file, blocks);
+    for (const auto& entry: heights_)
+    {
+        if (recent.count(entry.first) != 0)
+            continue;
+
+        write_hash(file, entry.first);
+        write_4_bytes(file, entry.second);
+    }
+
+    write_4_bytes(file, transactions);
+    for (const auto& entry: transactions_)
+    {
+        if (recent.count(entry.first) != 0)
+            continue;
+
+        write_hash(file, entry.first);
+        write_4_bytes(file, entry.second.height);
+        write_4_bytes(file, entry.second.index);
+    }
+
+    return static_cast<bool>(file);
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// Loaded entries are treated as final.
+bool index_cache::load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file || read_4_bytes(file) != file_magic ||
+        read_4_bytes(file) != file_version)
+        return false;
+
+    height_map heights;
+    const auto blocks = read_4_bytes(file);
+    for (uint32_t entry = 0; file && entry < blocks; ++entry)
+    {
+        const auto hash = read_hash(file);
+        heights[hash] = read_4_bytes(file);
+    }
+
+    position_map transactions;
+    const auto count = read_4_bytes(file);
+    for (uint32_t entry = 0; file && entry < count; ++entry)
+    {
+        const auto hash = read_hash(file);
+        const auto height = read_4_bytes(file);
+        transactions[hash] = { height, read_4_bytes(file) };
+    }
+
+    if (!file)
+        return false;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    for (const auto& entry: heights)
+        if (heights_.insert(entry).second)
+            admit(entry.first);
+
+    for (const auto& entry: transactions)
+        if (transactions_.insert(entry).second)
+            admit(entry.first);
+
+    return true;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+size_t index_cache::size() const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+    return heights_.size() + transactions_.size();
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+// The oldest entries are evicted first, and the order is compacted once
+// mostly stale (invalidated or recached keys).
+void index_cache::admit(const hash_digest& hash)
+{
+    admitted_.push_back(hash);
+
+    while (!admitted_.empty() &&
+        heights_.size() + transactions_.size() > capacity_)
+    {
+        heights_.erase(admitted_.front());
+        transactions_.erase(admitted_.front());
+        admitted_.pop_front();
+    }
+
+    if (admitted_.size() <= 2 * capacity_)
+        return;
+
+    hash_set live;
+    const auto stale = [&](const hash_digest& key)
+    {
+        const auto cached = heights_.count(key) != 0 ||
+            transactions_.count(key) != 0;
+
+        return !cached || !live.insert(key).second;
+    };
+
+    // Keeping the first occurrence of each key may evict a recached key early.
+    admitted_.erase(std::remove_if(admitted_.begin(), admitted_.end(), stale),
+        admitted_.end());
+}
+
+bool index_cache::find(const hash_digest& tx_hash, size_t& out_height,
+    size_t& out_position) const
+{
+    const auto it = transactions_.find(tx_hash);
+    if (top_ == unknown || it == transactions_.end())
+        return false;
+
+    out_height = it->second.height;
+    out_position = it->second.index;
+    return true;
+}
+
+// Looked up transactions are bounded by the capacity, oldest dropped first.
+// Keys seen in the block stream stay queued (stale) until trimmed or
+// compacted, so they do not count against the capacity.
+void index_cache::want(const hash_digest& tx_hash) const
+{
+    if (!wanted_.insert(tx_hash).second)
+        return;
+
+    wanted_order_.push_back(tx_hash);
+
+    while (!wanted_order_.empty() && wanted_.size() > capacity_)
+    {
+        wanted_.erase(wanted_order_.front());
+        wanted_order_.pop_front();
+    }
+
+    if (wanted_order_.size() <= 2 * capacity_)
+        return;
+
+    hash_set live;
+    const auto stale = [&](const hash_digest& key)
+    {
+        return wanted_.count(key) == 0 || !live.insert(key).second;
+    };
+
+    // Keeping the first occurrence of each key may drop a rewanted key early.
+    wanted_order_.erase(std::remove_if(wanted_order_.begin(),
+        wanted_order_.end(), stale), wanted_order_.end());
+}
+
+// Without the block stream no height is known to be final.
+bool index_cache::is_final(size_t height) const
+{
+    return top_ != unknown && height + reorganization_limit_ <= top_;
+}
+
+void index_cache::track(size_t height, const hash_digest& hash)
+{
+    if (!is_final(height))
+        recent_[height].push_back(hash);
+}
+
+// Entries cached at or above the height are removed.
+void index_cache::invalidate(size_t height)
+{
+    const auto start = recent_.lower_bound(height);
+    for (auto it = start; it != recent_.end(); ++it)
+    {
+        for (const auto& hash: it->second)
+        {
+            heights_.erase(hash);
+            transactions_.erase(hash);
+        }
+    }
+
+    recent_.erase(start, recent_.end());
+    blocks_.erase(blocks_.lower_bound(height), blocks_.end());
+    top_ = height == 0 ? unknown : height - 1;
+}
+
+void index_cache::prune()
+{
+    while (!recent_.empty() && is_final(recent_.begin()->first))
+        recent_.erase(recent_.begin());
+
+    while (blocks_.size() > reorganization_limit_)
+        blocks_.erase(blocks_.begin());
+}
+
+} // namespace client
+} // namespace libbitcoin
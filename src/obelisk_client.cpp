@@ -19,8 +19,11 @@
 #include <bitcoin/client/obelisk_client.hpp>
 
 #include <algorithm>
+#include <cstring>
 #include <thread>
+#include <vector>
 
+#include <zmq.h>
 #include <bitcoin/protocol/zmq/message.hpp>
 
 using namespace bc::protocol;
@@ -43,7 +46,67 @@ static const config::endpoint public_subscribe_worker(
 static const config::endpoint secure_subscribe_worker(
     "inproc://secure_subscribe_client");
 
-obelisk_client::obelisk_client(int32_t retries)
+// Matches the libbitcoin-server default subscription expiration.
+static constexpr uint32_t default_subscription_expiration_minutes = 10;
+
+// Initial response size estimates for the memory budget.
+static constexpr size_t block_response_estimate = 1000000;
+static constexpr size_t history_response_estimate = 65536;
+
+// Only block and history requests are subject to the memory budget.
+static size_t initial_estimate(const std::string& command)
+{
+    return command == "blockchain.fetch_block" ? block_response_estimate :
+        history_response_estimate;
+}
+
+static constexpr size_t error_code_size = sizeof(uint32_t);
+
+// Subscription ids remain allocated for the life of the subscription.
+static bool is_subscription(const std::string& command)
+{
+    return command == "subscribe.key" || command == "notification.key";
+}
+
+// Fixed-width response fields are read in place, without a stream.
+//-----------------------------------------------------------------------------
+
+// Read the little-endian word at the offset, false if out of bounds.
+static bool read_4_bytes(const data_chunk& payload, size_t offset,
+    uint32_t& out_value)
+{
+    if (payload.size() < offset + sizeof(uint32_t))
+        return false;
+
+    out_value = from_little_endian_unsafe<uint32_t>(payload.begin() + offset);
+    return true;
+}
+
+// Read the hash at the offset, which must be in bounds.
+static hash_digest read_hash(const data_chunk& payload, size_t offset)
+{
+    hash_digest hash;
+    std::copy_n(payload.begin() + offset, hash_size, hash.begin());
+    return hash;
+}
+
+// Read the response error code, or error::bad_stream if the payload does not
+// have the error code and, upon success, the given size of fields after it.
+static code read_error_code(const data_chunk& payload, size_t fields_size)
+{
+    uint32_t value;
+    if (!read_4_bytes(payload, 0, value))
+        return error::bad_stream;
+
+    const code ec = static_cast<error::error_code_t>(value);
+    if (ec)
+        return ec;
+
+    return payload.size() < error_code_size + fields_size ?
+        error::bad_stream : ec;
+}
+
+obelisk_client::obelisk_client(int32_t retries, size_t request_limit)
   : socket_(context_, zmq::socket::role::dealer),
     subscribe_socket_(context_, zmq::socket::role::dealer),
     block_socket_(context_, zmq::socket::role::subscriber),
@@ -53,10 +116,23 @@ obelisk_client::obelisk_client(int32_t retries)
     subscribe_dealer_(context_, zmq::socket::role::dealer),
     subscribe_router_(context_, zmq::socket::role::router),
     retries_(retries),
-    last_request_index_(0),
     secure_(false),
     worker_(public_worker),
-    subscribe_worker_(public_subscribe_worker)
+    subscribe_worker_(public_subscribe_worker),
+    request_ids_(request_limit),
+    verify_merkle_(false),
+    witness_(true),
+    memory_budget_(0),
+    memory_reserved_(0),
+    response_estimates_(
+    {
+        { "blockchain.fetch_block", block_response_estimate },
+        { "blockchain.fetch_history4", history_response_estimate }
+    }),
+    request_timeout_(milliseconds::zero()),
+    subscription_expiration_(
+        minutes(default_subscription_expiration_minutes)),
+    renewal_lag_(0)
 {
     attach_handlers();
 }
@@ -169,8 +245,54 @@ void obelisk_client::forward_message(zmq::socket& source, zmq::socket& sink)
     sink.send(packet);
 }
 
+void obelisk_client::process_block()
+{
+    zmq::message message;
+    uint16_t sequence;
+    uint32_t height;
+    data_chunk data;
+
+    block_socket_.receive(message);
+
+    message.dequeue(sequence);
+    message.dequeue(height);
+    message.dequeue(data);
+
+    chain::block block;
+    block.from_data(data, true);
+
+    if (index_cache_)
+        index_cache_->handle_block(height, block);
+
+    on_block_update_(height, block);
+}
+
+void obelisk_client::process_transaction()
+{
+    zmq::message message;
+    uint16_t sequence;
+    data_chunk data;
+
+    transaction_socket_.receive(message);
+
+    message.dequeue(sequence);
+    message.dequeue(data);
+
+    // The stream includes witness, which is skipped if not wanted.
+    chain::transaction transaction;
+    transaction.from_data(data, true, witness_);
+
+    accept_transaction(transaction.hash());
+    on_transaction_update_(transaction);
+}
+
+// The subscribe socket may be processed by monitor() on another thread, so
+// undecoded commands and the memory budget are handled only for responses on
+// the request socket.
 void obelisk_client::process_response(zmq::socket& socket)
 {
+    const auto requested = (&socket == &socket_);
+
     // Process server responses.
     zmq::message message;
     socket.receive(message);
@@ -187,9 +309,42 @@ void obelisk_client::process_response(zmq::socket& socket)
     message.dequeue(id);
     message.dequeue(payload);
 
-    const auto handler = command_handlers_.find(command);
-    if (handler != command_handlers_.end())
-        handler->second(command, id, payload);
+    // Responses to released ids are stale (late or timed out) and dropped.
+    if (!request_ids_.is_allocated(id))
+        return;
+
+    // Commands sent undecoded are completed regardless of the command.
+    payload_handler undecoded;
+    if (requested)
+    {
+        const auto it = payload_handlers_.find(id);
+        if (it != payload_handlers_.end())
+        {
+            undecoded = it->second;
+            payload_handlers_.erase(it);
+        }
+    }
+
+    // Only successful responses are representative of the response size.
+    // The size is read first as the command handler may take the payload.
+    const auto size = read_error_code(payload, 0) ? 0 : payload.size();
+
+    if (undecoded)
+    {
+        undecoded(error::success, payload);
+    }
+    else
+    {
+        const auto handler = command_handlers_.find(command);
+        if (handler != command_handlers_.end())
+            handler->second(command, id, payload);
+    }
+
+    if (requested && !admissions_.empty())
+        release_request(command, id, size);
+
+    if (!is_subscription(command))
+        request_ids_.release(id);
 }
 
 // Used by query commands and fires handlers as needed.
@@ -205,6 +360,11 @@ void obelisk_client::wait(uint32_t timeout_milliseconds)
     while (!poller.terminated() && requests_outstanding() &&
         steady_clock::now() < deadline)
     {
+        // Fail requests past their deadline, and send requests delayed by
+        // the memory budget as room is released.
+        expire_requests();
+        admit_requests();
+
         const auto identifiers = poller.wait(poll_timeout_milliseconds);
 
         // Forward incoming client router requests to the server.
@@ -214,6 +374,10 @@ void obelisk_client::wait(uint32_t timeout_milliseconds)
         // Process server responses.
         if (identifiers.contains(socket_.id()))
             process_response(socket_);
+
+        // Invoke handlers of blocks decoded by workers.
+        if (block_decoder_)
+            block_decoder_->deliver();
     }
 
     // Timeout or otherwise notify any remaining requests.
@@ -224,6 +388,18 @@ void obelisk_client::wait(uint32_t timeout_milliseconds)
 
 bool obelisk_client::subscribe_block(const config::endpoint& address,
     block_update_handler on_update)
+{
+    const block_height_update_handler handler = [on_update](size_t,
+        const chain::block& block)
+    {
+        on_update(block);
+    };
+
+    return subscribe_block(address, handler);
+}
+
+bool obelisk_client::subscribe_block(const config::endpoint& address,
+    block_height_update_handler on_update)
 {
     const auto host_address = address.to_string();
     if (block_socket_.connect(host_address) == error::success)
@@ -251,7 +427,8 @@ bool obelisk_client::subscribe_transaction(
 // Used by watch-* and subscribe-* commands, fires registered update handlers.
 void obelisk_client::monitor(uint32_t timeout_milliseconds)
 {
-    auto deadline = steady_clock::now() + milliseconds(timeout_milliseconds);
+    const auto deadline = steady_clock::now() +
+        milliseconds(timeout_milliseconds);
 
     zmq::poller poller;
     poller.add(subscribe_router_);
@@ -262,42 +439,23 @@ void obelisk_client::monitor(uint32_t timeout_milliseconds)
     // A timeout of 0 will still have a chance to complete.
     do
     {
-        const auto identifiers = poller.wait(timeout_milliseconds);
+        // Wake for the next renewal, flush or expiration before the deadline.
+        const auto renewal = renew_subscriptions();
+        const auto flush = flush_updates();
+        const auto expiration = expire_acceptances();
+        const auto remaining = duration_cast<milliseconds>(deadline -
+            steady_clock::now());
+        const auto timeout = std::max(std::min({ remaining, renewal, flush,
+            expiration }), milliseconds::zero());
+
+        // The poll timeout is limited to the signed 32 bit range.
+        const auto identifiers = poller.wait(static_cast<int32_t>(
+            std::min<int64_t>(timeout.count(), max_int32)));
         if (identifiers.contains(block_socket_.id()))
-        {
-            zmq::message message;
-            uint16_t sequence;
-            uint32_t height;
-            data_chunk data;
-
-            block_socket_.receive(message);
-
-            message.dequeue(sequence);
-            message.dequeue(height);
-            message.dequeue(data);
-
-            chain::block block;
-            block.from_data(data, true);
-
-            on_block_update_(block);
-        }
+            process_block();
 
         if (identifiers.contains(transaction_socket_.id()))
-        {
-            zmq::message message;
-            uint16_t sequence;
-            data_chunk data;
-
-            transaction_socket_.receive(message);
-
-            message.dequeue(sequence);
-            message.dequeue(data);
-
-            chain::transaction transaction;
-            transaction.from_data(data, true, true);
-
-            on_transaction_update_(transaction);
-        }
+            process_transaction();
 
         // Forward incoming client subscribe router requests to the server.
         if (identifiers.contains(subscribe_router_.id()))
@@ -314,6 +472,351 @@ void obelisk_client::monitor(uint32_t timeout_milliseconds)
         error::channel_timeout : error::operation_failed);
 }
 
+std::vector<obelisk_client::file_descriptor>
+obelisk_client::file_descriptors()
+{
+    std::vector<file_descriptor> descriptors;
+
+    for (const auto socket: { &socket_, &router_, &subscribe_socket_,
+        &subscribe_router_, &block_socket_, &transaction_socket_ })
+    {
+        file_descriptor descriptor;
+        auto size = sizeof(descriptor);
+        if (zmq_getsockopt(socket->self(), ZMQ_FD, &descriptor, &size) == 0)
+            descriptors.push_back(descriptor);
+    }
+
+    return descriptors;
+}
+
+// Socket descriptors signal by edge, so each socket is drained of input,
+// and handlers may queue further requests, so until none has input.
+milliseconds obelisk_client::process_ready()
+{
+    // Block decoding completes on workers, which do not signal readiness.
+    static constexpr auto decode_poll_milliseconds = 10;
+
+    const auto has_input = [](zmq::socket& socket)
+    {
+        int events;
+        auto size = sizeof(events);
+        return zmq_getsockopt(socket.self(), ZMQ_EVENTS, &events, &size) ==
+            0 && (events & ZMQ_POLLIN) != 0;
+    };
+
+    auto ready = true;
+    while (ready)
+    {
+        ready = false;
+        expire_requests();
+        admit_requests();
+
+        for (; has_input(router_); ready = true)
+            forward_message(router_, socket_);
+
+        for (; has_input(socket_); ready = true)
+            process_response(socket_);
+
+        for (; has_input(subscribe_router_); ready = true)
+            forward_message(subscribe_router_, subscribe_socket_);
+
+        for (; has_input(subscribe_socket_); ready = true)
+            process_response(subscribe_socket_);
+
+        for (; has_input(block_socket_); ready = true)
+            process_block();
+
+        for (; has_input(transaction_socket_); ready = true)
+            process_transaction();
+
+        if (block_decoder_ && block_decoder_->deliver() != 0)
+            ready = true;
+    }
+
+    const auto renewal = renew_subscriptions();
+    const auto flush = flush_updates();
+    const auto expiration = expire_acceptances();
+    const auto request = expire_requests();
+    const auto decoding = block_decoder_ && block_decoder_->pending() != 0 ?
+        milliseconds(decode_poll_milliseconds) : milliseconds::max();
+
+    return std::min({ renewal, flush, expiration, request, decoding });
+}
+
+void obelisk_client::set_request_timeout(const milliseconds& timeout)
+{
+    request_timeout_ = timeout;
+}
+
+void obelisk_client::set_subscription_expiration(uint32_t minutes)
+{
+    subscription_expiration_ = std::chrono::minutes(minutes);
+}
+
+void obelisk_client::set_subscription_expiration(const milliseconds& period)
+{
+    subscription_expiration_ = period;
+}
+
+asio::milliseconds obelisk_client::renewal_lag() const
+{
+    return milliseconds(renewal_lag_.load());
+}
+
+void obelisk_client::set_index_cache(std::shared_ptr<client::index_cache> cache)
+{
+    index_cache_ = cache;
+}
+
+void obelisk_client::set_shared_cache(
+    std::shared_ptr<client::shared_cache> cache)
+{
+    shared_cache_ = cache;
+}
+
+void obelisk_client::set_memory_budget(size_t bytes)
+{
+    memory_budget_ = bytes;
+}
+
+size_t obelisk_client::memory_usage() const
+{
+    return memory_reserved_ +
+        (block_decoder_ ? block_decoder_->bytes() : 0);
+}
+
+void obelisk_client::set_witness(bool witness)
+{
+    witness_ = witness;
+}
+
+void obelisk_client::set_decode_threads(size_t threads, bool verify_merkle)
+{
+    verify_merkle_ = verify_merkle;
+
+    if (threads == 0)
+        block_decoder_.reset();
+    else
+        block_decoder_.reset(new client::block_decoder(threads,
+            verify_merkle));
+}
+
+// Renewals are sent directly to the server, since the monitoring thread does
+// not own the subscribe dealer.
+milliseconds obelisk_client::renew_subscriptions()
+{
+    static const std::string command = "subscribe.key";
+    std::vector<std::pair<uint32_t, hash_digest>> renewals;
+    const auto now = steady_clock::now();
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    subscription_lock_.lock();
+    while (!renewals_.empty() && renewals_.top().first <= now)
+    {
+        const auto renewal = renewals_.top();
+        renewals_.pop();
+
+        // Skip terminated and rescheduled subscriptions.
+        auto it = subscription_handlers_.find(renewal.second);
+        if (it == subscription_handlers_.end() ||
+            it->second.renew != renewal.first)
+            continue;
+
+        auto& subscription = it->second;
+        if (!subscription.renewing)
+        {
+            subscription.renewing = true;
+            subscription.due = subscription.renew;
+        }
+
+        // Resend if the renewal is not acknowledged in an eighth of a period.
+        subscription.renew = now + subscription_expiration_ / 8;
+        renewals_.emplace(subscription.renew, renewal.second);
+        renewals.emplace_back(renewal.second, subscription.key);
+    }
+
+    const auto next = renewals_.empty() ? milliseconds::max() :
+        duration_cast<milliseconds>(renewals_.top().first - now);
+    subscription_lock_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    for (const auto& renewal: renewals)
+    {
+        // [ key:32 ]
+        zmq::message message;
+        message.enqueue(to_chunk(command));
+        message.enqueue(to_chunk(to_little_endian(renewal.first)));
+        message.enqueue(build_chunk({ renewal.second }));
+        subscribe_socket_.send(message);
+    }
+
+    return next;
+}
+
+// Renewal is spread over the third quarter of the expiration period by key,
+// so that keys subscribed together are not renewed together.
+void obelisk_client::schedule_renewal(uint32_t subscription,
+    key_subscription& value, const time_point& from)
+{
+    value.renewing = false;
+    if (subscription_expiration_ == milliseconds::zero())
+        return;
+
+    const auto period = subscription_expiration_.count();
+    const auto spread = static_cast<int64_t>(value.key[0] << 8 | value.key[1]);
+    value.renew = from + milliseconds(period / 2 + period / 4 * spread / 65536);
+    renewals_.emplace(value.renew, subscription);
+}
+
+void obelisk_client::accept_transaction(const hash_digest& tx_hash)
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    subscription_lock_.lock_upgrade();
+    const auto it = acceptances_.find(tx_hash);
+    if (it == acceptances_.end())
+    {
+        subscription_lock_.unlock_upgrade();
+        return;
+    }
+
+    const auto pending = it->second;
+    subscription_lock_.unlock_upgrade_and_lock();
+    acceptances_.erase(it);
+    subscription_lock_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    pending.handler(error::success, duration_cast<milliseconds>(
+        steady_clock::now() - pending.broadcast));
+}
+
+milliseconds obelisk_client::expire_acceptances()
+{
+    std::vector<acceptance> expired;
+    const auto now = steady_clock::now();
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    subscription_lock_.lock();
+    while (!acceptance_deadlines_.empty() &&
+        acceptance_deadlines_.top().first <= now)
+    {
+        const auto deadline = acceptance_deadlines_.top();
+        acceptance_deadlines_.pop();
+
+        // Skip accepted and failed broadcasts.
+        const auto it = acceptances_.find(deadline.second);
+        if (it == acceptances_.end() || it->second.deadline != deadline.first)
+            continue;
+
+        expired.push_back(it->second);
+        acceptances_.erase(it);
+    }
+
+    const auto next = acceptance_deadlines_.empty() ? milliseconds::max() :
+        duration_cast<milliseconds>(acceptance_deadlines_.top().first - now);
+    subscription_lock_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    for (const auto& pending: expired)
+        pending.handler(error::channel_timeout,
+            duration_cast<milliseconds>(now - pending.broadcast));
+
+    return next;
+}
+
+// A request is expired as though failed immediately, and its late response is
+// dropped as stale. Deadlines of completed requests are skipped.
+milliseconds obelisk_client::expire_requests()
+{
+    const auto now = steady_clock::now();
+    while (!request_deadlines_.empty() &&
+        std::get<0>(request_deadlines_.top()) <= now)
+    {
+        const auto id = std::get<1>(request_deadlines_.top());
+        const auto command = std::get<2>(request_deadlines_.top());
+        request_deadlines_.pop();
+
+        if (!request_ids_.is_allocated(id))
+            continue;
+
+        release_request(command, id, 0);
+
+        const auto undecoded = payload_handlers_.find(id);
+        if (undecoded == payload_handlers_.end())
+        {
+            handle_immediate(command, id, error::channel_timeout);
+            continue;
+        }
+
+        const auto handler = undecoded->second;
+        payload_handlers_.erase(undecoded);
+        request_ids_.release(id);
+        handler(error::channel_timeout, {});
+    }
+
+    return request_deadlines_.empty() ? milliseconds::max() :
+        duration_cast<milliseconds>(std::get<0>(request_deadlines_.top()) -
+            steady_clock::now());
+}
+
+milliseconds obelisk_client::flush_updates()
+{
+    std::vector<std::pair<coalesced_update_handler, key_update::list>> flushes;
+    const auto now = steady_clock::now();
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    update_lock_.lock();
+    while (!flushes_.empty() && flushes_.top().first <= now)
+    {
+        const auto flush = flushes_.top().first;
+        const auto state = flushes_.top().second.lock();
+        flushes_.pop();
+
+        // Skip unsubscribed and already flushed subscribers.
+        if (!state || state->flush != flush || state->updates.empty())
+            continue;
+
+        flushes.emplace_back(state->handler, std::move(state->updates));
+        state->updates.clear();
+    }
+
+    const auto next = flushes_.empty() ? milliseconds::max() :
+        duration_cast<milliseconds>(flushes_.top().first - now);
+    update_lock_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    for (const auto& flush: flushes)
+        flush.first(error::success, flush.second);
+
+    return next;
+}
+
+void obelisk_client::flush_unsubscribed(uint32_t subscription)
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    update_lock_.lock();
+    const auto it = debounces_.find(subscription);
+    if (it == debounces_.end())
+    {
+        update_lock_.unlock();
+        return;
+    }
+
+    const auto state = it->second;
+    debounces_.erase(it);
+    const auto updates = std::move(state->updates);
+    state->updates.clear();
+    update_lock_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    if (!updates.empty())
+        state->handler(error::success, updates);
+}
+
 // Create a message and send it to the internal router for forwarding
 // to the server.
 bool obelisk_client::send_request(const std::string& command,
@@ -327,8 +830,76 @@ bool obelisk_client::send_request(const std::string& command,
     message.enqueue(to_chunk(to_little_endian(id)));
     message.enqueue(payload);
 
-    return subscription ? !subscribe_dealer_.send(message) :
-        !dealer_.send(message);
+    if (subscription)
+        return !subscribe_dealer_.send(message);
+
+    if (request_timeout_ != milliseconds::zero())
+        request_deadlines_.emplace(steady_clock::now() + request_timeout_, id,
+            command);
+
+    return !dealer_.send(message);
+}
+
+// Requests are admitted in order, so a deferred request is not overtaken.
+// A request without an id (over the request limit) fails without deferral.
+void obelisk_client::send_budgeted_request(const std::string& command,
+    uint32_t id, const data_chunk& payload)
+{
+    if (id == 0)
+    {
+        handle_immediate(command, id, error::network_unreachable);
+        return;
+    }
+
+    deferred_requests_.push_back({ command, id, payload });
+    admit_requests();
+}
+
+// Each request reserves the estimated size of its response until it completes.
+void obelisk_client::admit_requests()
+{
+    while (!deferred_requests_.empty())
+    {
+        const auto estimate =
+            response_estimates_[deferred_requests_.front().command];
+
+        // One request is admitted regardless of the budget, to make progress.
+        if (memory_budget_ != 0 && !admissions_.empty() &&
+            memory_usage() + estimate > memory_budget_)
+            return;
+
+        const auto request = std::move(deferred_requests_.front());
+        deferred_requests_.pop_front();
+        admissions_[request.id] = estimate;
+        memory_reserved_ += estimate;
+
+        if (!send_request(request.command, request.id, request.payload))
+        {
+            handle_immediate(request.command, request.id,
+                error::network_unreachable);
+            release_request(request.command, request.id, 0);
+        }
+    }
+}
+
+// Estimates follow a moving average of response sizes, not falling below the
+// initial estimate, so that a run of small responses cannot overcommit.
+void obelisk_client::release_request(const std::string& command, uint32_t id,
+    size_t response_size)
+{
+    const auto admission = admissions_.find(id);
+    if (admission == admissions_.end())
+        return;
+
+    memory_reserved_ -= admission->second;
+    admissions_.erase(admission);
+
+    if (response_size == 0)
+        return;
+
+    auto& estimate = response_estimates_[command];
+    estimate = std::max(initial_estimate(command),
+        (3 * estimate + response_size) / 4);
 }
 
 // Handlers.
@@ -339,176 +910,201 @@ void obelisk_client::attach_handlers()
     auto result_handler = [this](const std::string&, uint32_t id,
         const data_chunk& payload)
     {
-        auto handler = result_handlers_.find(id);
-        if (handler == result_handlers_.end())
+        const auto it = result_handlers_.find(id);
+        if (it == result_handlers_.end())
             return;
 
-        data_source istream(payload);
-        istream_reader source(istream);
-        handler->second(source.read_error_code());
-        result_handlers_.erase(handler);
+        const auto handler = it->second;
+        result_handlers_.erase(it);
+
+        handler(read_error_code(payload, 0));
     };
 
     auto version_handler = [this](const std::string&, uint32_t id,
         const data_chunk& payload)
     {
-        auto handler = version_handlers_.find(id);
-        if (handler == version_handlers_.end())
+        const auto it = version_handlers_.find(id);
+        if (it == version_handlers_.end())
             return;
 
+        const auto handler = it->second;
+        version_handlers_.erase(it);
+
         data_source istream(payload);
         istream_reader source(istream);
         const auto ec = source.read_error_code();
         const auto version = source.read_bytes();
-        handler->second(ec, std::string(version.begin(), version.end()));
-        version_handlers_.erase(handler);
+        handler(ec, std::string(version.begin(), version.end()));
     };
 
+    // The original transaction commands respond without witness, and witness
+    // in other responses is skipped if not wanted.
     auto transaction_handler = [this](const std::string&, uint32_t id,
         const data_chunk& payload)
     {
-        auto handler = transaction_handlers_.find(id);
-        if (handler == transaction_handlers_.end())
+        const auto it = transaction_handlers_.find(id);
+        if (it == transaction_handlers_.end())
             return;
 
+        const auto handler = it->second;
+        transaction_handlers_.erase(it);
+
         data_source istream(payload);
         istream_reader source(istream);
         const auto ec = source.read_error_code();
         if (ec)
         {
-            handler->second(ec, {});
-            transaction_handlers_.erase(handler);
+            handler(ec, {});
             return;
         }
 
         chain::transaction tx;
-        if (!tx.from_data(source.read_bytes(), true, true))
+        if (!tx.from_data(source.read_bytes(), true, witness_))
         {
-            handler->second(error::bad_stream, {});
-            transaction_handlers_.erase(handler);
+            handler(error::bad_stream, {});
             return;
         }
 
-        handler->second(ec, tx);
-        transaction_handlers_.erase(handler);
+        handler(ec, tx);
     };
 
     auto height_handler = [this](const std::string&, uint32_t id,
         const data_chunk& payload)
     {
-        auto handler = height_handlers_.find(id);
-        if (handler == height_handlers_.end())
+        const auto it = height_handlers_.find(id);
+        if (it == height_handlers_.end())
             return;
 
-        data_source istream(payload);
-        istream_reader source(istream);
-        const auto ec = source.read_error_code();
-        const size_t height = source.read_4_bytes_little_endian();
-        handler->second(ec, height);
-        height_handlers_.erase(handler);
+        const auto handler = it->second;
+        height_handlers_.erase(it);
+
+        uint32_t height = 0;
+        const auto ec = read_error_code(payload, sizeof(uint32_t));
+        if (!ec)
+            read_4_bytes(payload, error_code_size, height);
+
+        handler(ec, height);
     };
 
     auto block_header_handler = [this](const std::string&, uint32_t id,
         const data_chunk& payload)
     {
-        auto handler = block_header_handlers_.find(id);
-        if (handler == block_header_handlers_.end())
+        const auto it = block_header_handlers_.find(id);
+        if (it == block_header_handlers_.end())
             return;
 
+        const auto handler = it->second;
+        block_header_handlers_.erase(it);
+
         data_source istream(payload);
         istream_reader source(istream);
         const auto ec = source.read_error_code();
         if (ec)
         {
-            handler->second(ec, {});
-            block_header_handlers_.erase(handler);
+            handler(ec, {});
             return;
         }
 
         chain::header header;
         if (!header.from_data(source.read_bytes()))
         {
-            handler->second(error::bad_stream, {});
-            block_header_handlers_.erase(handler);
+            handler(error::bad_stream, {});
             return;
         }
 
-        handler->second(ec, header);
-        block_header_handlers_.erase(handler);
+        handler(ec, header);
     };
 
     auto block_handler = [this](const std::string&, uint32_t id,
-        const data_chunk& payload)
+        data_chunk& payload)
     {
-        auto handler = block_handlers_.find(id);
-        if (handler == block_handlers_.end())
+        // Decoding is deferred to the decoder, which takes the payload and
+        // preserves request order.
+        const auto decode = block_decodes_.find(id);
+        if (decode != block_decodes_.end())
+        {
+            block_decoder_->decode(decode->second, std::move(payload));
+            block_decodes_.erase(decode);
+            return;
+        }
+
+        const auto it = block_handlers_.find(id);
+        if (it == block_handlers_.end())
             return;
 
+        const auto handler = it->second;
+        block_handlers_.erase(it);
+
         data_source istream(payload);
         istream_reader source(istream);
         const auto ec = source.read_error_code();
         if (ec)
         {
-            handler->second(ec, {});
-            block_handlers_.erase(handler);
+            handler(ec, {});
             return;
         }
 
         chain::block block;
         if (!block.from_data(source.read_bytes()))
         {
-            handler->second(error::bad_stream, {});
-            block_handlers_.erase(handler);
+            handler(error::bad_stream, {});
             return;
         }
 
-        handler->second(ec, block);
-        block_handlers_.erase(handler);
+        if (verify_merkle_ && !block.is_valid_merkle_root())
+        {
+            handler(error::merkle_mismatch, {});
+            return;
+        }
+
+        handler(ec, block);
     };
 
     auto compact_filter_handler = [this](const std::string&, uint32_t id,
         const data_chunk& payload)
     {
-        auto handler = compact_filter_handlers_.find(id);
-        if (handler == compact_filter_handlers_.end())
+        const auto it = compact_filter_handlers_.find(id);
+        if (it == compact_filter_handlers_.end())
             return;
 
+        const auto handler = it->second;
+        compact_filter_handlers_.erase(it);
+
         data_source istream(payload);
         istream_reader source(istream);
         const auto ec = source.read_error_code();
         if (ec)
         {
-            handler->second(ec, {});
-            compact_filter_handlers_.erase(handler);
+            handler(ec, {});
             return;
         }
 
         message::compact_filter response;
         if (!response.from_data(source.read_bytes()))
         {
-            handler->second(error::bad_stream, {});
-            compact_filter_handlers_.erase(handler);
+            handler(error::bad_stream, {});
             return;
         }
 
-        handler->second(ec, response);
-        compact_filter_handlers_.erase(handler);
+        handler(ec, response);
     };
 
     auto compact_filter_checkpoint_handler = [this](const std::string&,
         uint32_t id, const data_chunk& payload)
     {
-        auto handler = compact_filter_checkpoint_handlers_.find(id);
-        if (handler == compact_filter_checkpoint_handlers_.end())
+        const auto it = compact_filter_checkpoint_handlers_.find(id);
+        if (it == compact_filter_checkpoint_handlers_.end())
             return;
 
+        const auto handler = it->second;
+        compact_filter_checkpoint_handlers_.erase(it);
+
         data_source istream(payload);
         istream_reader source(istream);
         const auto ec = source.read_error_code();
         if (ec)
         {
-            handler->second(ec, {});
-            compact_filter_checkpoint_handlers_.erase(handler);
+            handler(ec, {});
             return;
         }
 
@@ -516,29 +1112,29 @@ void obelisk_client::attach_handlers()
         const auto version = message::compact_filter_checkpoint::version_minimum;
         if (!response.from_data(version, source.read_bytes()))
         {
-            handler->second(error::bad_stream, {});
-            compact_filter_checkpoint_handlers_.erase(handler);
+            handler(error::bad_stream, {});
             return;
         }
 
-        handler->second(ec, response);
-        compact_filter_checkpoint_handlers_.erase(handler);
+        handler(ec, response);
     };
 
     auto compact_filter_headers_handler = [this](const std::string&,
         uint32_t id, const data_chunk& payload)
     {
-        auto handler = compact_filter_headers_handlers_.find(id);
-        if (handler == compact_filter_headers_handlers_.end())
+        const auto it = compact_filter_headers_handlers_.find(id);
+        if (it == compact_filter_headers_handlers_.end())
             return;
 
+        const auto handler = it->second;
+        compact_filter_headers_handlers_.erase(it);
+
         data_source istream(payload);
         istream_reader source(istream);
         const auto ec = source.read_error_code();
         if (ec)
         {
-            handler->second(ec, {});
-            compact_filter_headers_handlers_.erase(handler);
+            handler(ec, {});
             return;
         }
 
@@ -546,38 +1142,176 @@ void obelisk_client::attach_handlers()
         const auto version = message::compact_filter_headers::version_minimum;
         if (!response.from_data(version, source.read_bytes()))
         {
-            handler->second(error::bad_stream, {});
-            compact_filter_headers_handlers_.erase(handler);
+            handler(error::bad_stream, {});
+            return;
+        }
+
+        handler(ec, response);
+    };
+
+    auto spend_handler = [this](const std::string&, uint32_t id,
+        const data_chunk& payload)
+    {
+        const auto it = spend_handlers_.find(id);
+        if (it == spend_handlers_.end())
+            return;
+
+        const auto handler = it->second;
+        spend_handlers_.erase(it);
+
+        const auto ec = read_error_code(payload, hash_size + sizeof(uint32_t));
+        if (ec)
+        {
+            handler(ec, {});
             return;
         }
 
-        handler->second(ec, response);
-        compact_filter_headers_handlers_.erase(handler);
+        uint32_t index;
+        read_4_bytes(payload, error_code_size + hash_size, index);
+        handler(ec, { read_hash(payload, error_code_size), index });
     };
 
     auto transaction_index_handler = [this](const std::string&, uint32_t id,
         const data_chunk& payload)
     {
-        auto handler = transaction_index_handlers_.find(id);
-        if (handler == transaction_index_handlers_.end())
+        const auto it = transaction_index_handlers_.find(id);
+        if (it == transaction_index_handlers_.end())
             return;
 
+        const auto handler = it->second;
+        transaction_index_handlers_.erase(it);
+
+        uint32_t block_height = 0;
+        uint32_t index = 0;
+        const auto ec = read_error_code(payload, 2 * sizeof(uint32_t));
+        if (!ec)
+        {
+            read_4_bytes(payload, error_code_size, block_height);
+            read_4_bytes(payload, error_code_size + sizeof(uint32_t), index);
+        }
+
+        handler(ec, block_height, index);
+    };
+
+    // Unspent outputs are decoded from blockchain.fetch_history4 without
+    // allocating for spent rows. A first pass counts the rows of each kind, a
+    // second collects only the spend checksums, into a vector of that size,
+    // and a third emits only the outputs without a correlated spend, found by
+    // binary search of the sorted checksums. As with history, correlation
+    // relies on the avoidance of checksum hash collisions, and each spend
+    // cancels at most one output.
+    auto unspent_handler = [this](const std::string&, uint32_t id,
+        const data_chunk& payload)
+    {
+        const auto it = unspent_handlers_.find(id);
+        if (it == unspent_handlers_.end())
+            return;
+
+        const auto handler = it->second;
+        unspent_handlers_.erase(it);
+
         data_source istream(payload);
         istream_reader source(istream);
         const auto ec = source.read_error_code();
-        const auto block_height = source.read_4_bytes_little_endian();
-        const auto index = source.read_4_bytes_little_endian();
-        handler->second(ec, block_height, index);
-        transaction_index_handlers_.erase(handler);
+        if (ec)
+        {
+            handler(ec, {});
+            return;
+        }
+
+        payment_record record;
+        size_t outputs = 0;
+        size_t spend_count = 0;
+
+        while (!source.is_exhausted())
+        {
+            if (!record.from_data(source, true))
+            {
+                handler(error::bad_stream, {});
+                return;
+            }
+
+            if (record.is_output())
+                ++outputs;
+            else
+                ++spend_count;
+        }
+
+        std::vector<uint64_t> spends;
+        spends.reserve(spend_count);
+
+        data_source spend_stream(payload);
+        istream_reader spend_source(spend_stream);
+        spend_source.read_error_code();
+
+        while (!spend_source.is_exhausted())
+        {
+            record.from_data(spend_source, true);
+            if (!record.is_output())
+                spends.push_back(record.data());
+        }
+
+        std::sort(spends.begin(), spends.end());
+        std::vector<bool> cancelled(spends.size(), false);
+
+        const auto spent = [&spends, &cancelled](const output_point& output)
+        {
+            const auto checksum = output.checksum();
+            auto spend = std::lower_bound(spends.begin(), spends.end(),
+                checksum);
+
+            for (; spend != spends.end() && *spend == checksum; ++spend)
+            {
+                const auto index = std::distance(spends.begin(), spend);
+                if (!cancelled[index])
+                {
+                    cancelled[index] = true;
+                    return true;
+                }
+            }
+
+            return false;
+        };
+
+        chain::points_value unspent;
+        unspent.points.reserve(outputs > spend_count ?
+            outputs - spend_count : 0);
+
+        data_source output_stream(payload);
+        istream_reader output_source(output_stream);
+        output_source.read_error_code();
+
+        while (!output_source.is_exhausted())
+        {
+            record.from_data(output_source, true);
+            if (!record.is_output())
+                continue;
+
+            const output_point output{ record.hash(), record.index() };
+            if (!spent(output))
+                unspent.points.emplace_back(output, record.data());
+        }
+
+        handler(error::success, unspent);
     };
 
-    auto history_handler = [this](const std::string&, uint32_t id,
-        const data_chunk& payload)
+    auto history_handler = [this, unspent_handler](const std::string& command,
+        uint32_t id, const data_chunk& payload)
     {
-        auto handler = history_handlers_.find(id);
-        if (handler == history_handlers_.end())
+        // Unspent output requests share the history command.
+        if (unspent_handlers_.find(id) != unspent_handlers_.end())
+        {
+            unspent_handler(command, id, payload);
+            return;
+        }
+
+        const auto it = history_handlers_.find(id);
+        if (it == history_handlers_.end())
             return;
 
+        const auto handler = it->second;
+        history_handlers_.erase(it);
+
         payment_record payment;
         payment_record::list records;
 
@@ -588,8 +1322,7 @@ void obelisk_client::attach_handlers()
         {
             if (!payment.from_data(source, true))
             {
-                handler->second(ec, {});
-                history_handlers_.erase(handler);
+                handler(ec, {});
                 return;
             }
 
@@ -672,13 +1405,12 @@ void obelisk_client::attach_handlers()
             if (history.spend.is_null())
                 history.spend_height = max_uint64;
 
-        handler->second(ec, result);
-        history_handlers_.erase(handler);
+        handler(ec, result);
     };
 
     // This handler locks subscription_handlers_ while running to avoid
     // subscription handler state from changing while running (called from
-    // process_response).
+    // process_response). Local handlers are invoked outside of the lock.
     auto notification_handler = [this](const std::string&, uint32_t id,
         const data_chunk& payload)
     {
@@ -692,7 +1424,12 @@ void obelisk_client::attach_handlers()
             return;
         }
 
-        auto& handler = it->second.first;
+        // Fan out to every local subscriber of the key.
+        std::vector<update_handler> handlers;
+        handlers.reserve(it->second.handlers.size());
+        for (const auto& handler: it->second.handlers)
+            handlers.push_back(handler.second);
+
         // [ code:4 ]     <- if this is nonzero then rest may be empty.
         // [ sequence:2 ] <- if out of order there was a lost message.
         // [ height:4 ]   <- 0 for unconfirmed or error tx (cannot notify genesis).
@@ -703,10 +1440,13 @@ void obelisk_client::attach_handlers()
         const auto ec = source.read_error_code();
         if (ec)
         {
-            handler(ec, {}, {}, {});
             subscription_lock_.unlock_upgrade_and_lock();
-            subscription_handlers_.erase(it);
+            remove_subscription(it);
             subscription_lock_.unlock();
+
+            for (const auto& handler: handlers)
+                handler(ec, {}, {}, {});
+
             return;
         }
 
@@ -716,10 +1456,13 @@ void obelisk_client::attach_handlers()
 
         if (!source.is_exhausted())
         {
-            handler(error::bad_stream, {}, {}, {});
             subscription_lock_.unlock_upgrade_and_lock();
-            subscription_handlers_.erase(it);
+            remove_subscription(it);
             subscription_lock_.unlock();
+
+            for (const auto& handler: handlers)
+                handler(error::bad_stream, {}, {}, {});
+
             return;
         }
 
@@ -727,7 +1470,39 @@ void obelisk_client::attach_handlers()
         ///////////////////////////////////////////////////////////////////////////
 
         // Caller must differentiate type of update if subscribed to multiple.
-        handler(ec, sequence, height, tx_hash);
+        for (const auto& handler: handlers)
+            handler(ec, sequence, height, tx_hash);
+    };
+
+    // This handler consumes the acknowledgement of a subscription renewal,
+    // otherwise the subscribe.key response is handled as a notification.
+    auto subscribe_handler = [this, notification_handler](
+        const std::string& command, uint32_t id, const data_chunk& payload)
+    {
+        // Critical Section.
+        ///////////////////////////////////////////////////////////////////////////
+        subscription_lock_.lock();
+        auto it = subscription_handlers_.find(id);
+        if (it != subscription_handlers_.end() && it->second.renewing)
+        {
+            const auto now = steady_clock::now();
+            renewal_lag_ = duration_cast<milliseconds>(now -
+                it->second.due).count();
+            schedule_renewal(id, it->second, now);
+
+            data_source istream(payload);
+            istream_reader source(istream);
+            if (!source.read_error_code())
+            {
+                subscription_lock_.unlock();
+                return;
+            }
+        }
+
+        subscription_lock_.unlock();
+        ///////////////////////////////////////////////////////////////////////////
+
+        notification_handler(command, id, payload);
     };
 
     // This handler locks subscription_handlers_ while running to avoid
@@ -769,20 +1544,31 @@ void obelisk_client::attach_handlers()
     auto hash_list_handler = [this](const std::string&, uint32_t id,
         const data_chunk& payload)
     {
-        auto handler = hash_list_handlers_.find(id);
-        if (handler == hash_list_handlers_.end())
+        const auto it = hash_list_handlers_.find(id);
+        if (it == hash_list_handlers_.end())
             return;
 
-        hash_list hashes;
+        const auto handler = it->second;
+        hash_list_handlers_.erase(it);
 
-        data_source istream(payload);
-        istream_reader source(istream);
-        const auto ec = source.read_error_code();
-        while (!source.is_exhausted())
-            hashes.push_back(source.read_hash());
+        // The hashes are contiguous, so are sized and copied at once.
+        auto ec = read_error_code(payload, 0);
+        const auto hashes_size = ec ? 0 : payload.size() - error_code_size;
+        if (hashes_size % hash_size != 0)
+            ec = error::bad_stream;
+
+        if (ec)
+        {
+            handler(ec, {});
+            return;
+        }
 
-        handler->second(ec, hashes);
-        hash_list_handlers_.erase(handler);
+        hash_list hashes(hashes_size / hash_size);
+        if (!hashes.empty())
+            std::memcpy(hashes.data(), payload.data() + error_code_size,
+                hashes_size);
+
+        handler(ec, hashes);
     };
 
 #define REGISTER_HANDLER(command, handler) \
@@ -806,9 +1592,10 @@ void obelisk_client::attach_handlers()
     REGISTER_HANDLER("blockchain.fetch_compact_filter_headers", compact_filter_headers_handler);
     REGISTER_HANDLER("blockchain.fetch_transaction_index",
         transaction_index_handler);
+    REGISTER_HANDLER("blockchain.fetch_spend", spend_handler);
     REGISTER_HANDLER("blockchain.fetch_history4", history_handler);
     REGISTER_HANDLER("blockchain.fetch_block_transaction_hashes", hash_list_handler);
-    REGISTER_HANDLER("subscribe.key", notification_handler);
+    REGISTER_HANDLER("subscribe.key", subscribe_handler);
     REGISTER_HANDLER("notification.key", notification_handler);
     REGISTER_HANDLER("unsubscribe.key", unsubscribe_handler);
     REGISTER_HANDLER("server.version", version_handler);
@@ -816,6 +1603,38 @@ void obelisk_client::attach_handlers()
 #undef REGISTER_HANDLER
 }
 
+obelisk_client::block_handler obelisk_client::cache_block(
+    block_handler handler) const
+{
+    if (!shared_cache_)
+        return handler;
+
+    const auto cache = shared_cache_;
+    return [cache, handler](const code& ec, const chain::block& block)
+    {
+        if (!ec)
+            cache->store_block(block);
+
+        handler(ec, block);
+    };
+}
+
+obelisk_client::block_header_handler obelisk_client::cache_header(
+    block_header_handler handler) const
+{
+    if (!shared_cache_)
+        return handler;
+
+    const auto cache = shared_cache_;
+    return [cache, handler](const code& ec, const chain::header& header)
+    {
+        if (!ec)
+            cache->store_header(header);
+
+        handler(ec, header);
+    };
+}
+
 void obelisk_client::handle_immediate(const std::string& command, uint32_t id,
     const code& ec)
 {
@@ -823,12 +1642,15 @@ void obelisk_client::handle_immediate(const std::string& command, uint32_t id,
     if (command_handler == command_handlers_.end())
         return;
 
-    const auto payload = build_chunk(
+    auto payload = build_chunk(
     {
         to_little_endian(static_cast<uint32_t>(ec.value()))
     });
 
     command_handler->second(command, id, payload);
+
+    if (!is_subscription(command))
+        request_ids_.release(id);
 }
 
 bool obelisk_client::requests_outstanding()
@@ -839,25 +1661,31 @@ bool obelisk_client::requests_outstanding()
         !result_handlers_.empty() ||
         !height_handlers_.empty() ||
         !transaction_index_handlers_.empty() ||
+        !spend_handlers_.empty() ||
         !block_handlers_.empty() ||
+        !block_decodes_.empty() ||
+        (block_decoder_ && block_decoder_->pending() != 0) ||
         !block_header_handlers_.empty() ||
         !transaction_handlers_.empty() ||
         !hash_list_handlers_.empty() ||
         !history_handlers_.empty() ||
+        !unspent_handlers_.empty() ||
         !version_handlers_.empty() ||
+        !payload_handlers_.empty() ||
         !compact_filter_handlers_.empty() ||
         !compact_filter_checkpoint_handlers_.empty() ||
         !compact_filter_headers_handlers_.empty();
 }
 
 // We have subscribe requests outstanding if the subscription handler map is not
-// empty.
+// empty, or if a broadcast transaction is awaiting acceptance.
 bool obelisk_client::subscribe_requests_outstanding()
 {
     // Critical Section.
     ///////////////////////////////////////////////////////////////////////////
     system::unique_lock lock(subscription_lock_);
-    return !subscription_handlers_.empty() || !unsubscription_handlers_.empty();
+    return !subscription_handlers_.empty() ||
+        !unsubscription_handlers_.empty() || !acceptances_.empty();
     ///////////////////////////////////////////////////////////////////////////
 }
 
@@ -867,22 +1695,50 @@ void obelisk_client::clear_outstanding_requests(const code& ec)
 #define INVOKE_HANDLER_1 handler.second(ec, {})
 #define INVOKE_HANDLER_2 handler.second(ec, {}, {})
 
+// Handlers may issue requests, so each map is emptied before invocation.
 #define CLEAR_OUTSTANDING(handlers, ec, handler_version) \
-    for (auto& handler: handlers) \
-        INVOKE_HANDLER_##handler_version; \
-    handlers.clear()
+    { \
+        auto outstanding = std::move(handlers); \
+        handlers.clear(); \
+        for (auto& handler: outstanding) \
+        { \
+            INVOKE_HANDLER_##handler_version; \
+            request_ids_.release(handler.first); \
+        } \
+    }
 
     // Clear the handler maps, but first fire the handlers with the
     // specified error.
     CLEAR_OUTSTANDING(result_handlers_, ec, 0);
     CLEAR_OUTSTANDING(height_handlers_, ec, 1);
     CLEAR_OUTSTANDING(transaction_index_handlers_, ec, 2);
+    CLEAR_OUTSTANDING(spend_handlers_, ec, 1);
     CLEAR_OUTSTANDING(block_handlers_, ec, 1);
     CLEAR_OUTSTANDING(block_header_handlers_, ec, 1);
     CLEAR_OUTSTANDING(transaction_handlers_, ec, 1);
     CLEAR_OUTSTANDING(hash_list_handlers_, ec, 1);
     CLEAR_OUTSTANDING(history_handlers_, ec, 1);
+    CLEAR_OUTSTANDING(unspent_handlers_, ec, 1);
     CLEAR_OUTSTANDING(version_handlers_, ec, 1);
+    CLEAR_OUTSTANDING(payload_handlers_, ec, 1);
+    CLEAR_OUTSTANDING(compact_filter_handlers_, ec, 1);
+    CLEAR_OUTSTANDING(compact_filter_checkpoint_handlers_, ec, 1);
+    CLEAR_OUTSTANDING(compact_filter_headers_handlers_, ec, 1);
+
+    // Deferred requests were cleared with their handlers.
+    deferred_requests_.clear();
+    admissions_.clear();
+    memory_reserved_ = 0;
+
+    // Completed decodes are delivered, and the remainder with the error.
+    if (block_decoder_)
+    {
+        for (const auto& decode: block_decodes_)
+            request_ids_.release(decode.first);
+
+        block_decodes_.clear();
+        block_decoder_->clear(ec);
+    }
 
 #undef CLEAR_OUTSTANDING
 #undef INVOKE_HANDLER_0
@@ -890,20 +1746,44 @@ void obelisk_client::clear_outstanding_requests(const code& ec)
 #undef INVOKE_HANDLER_2
 }
 
+// Acceptance handlers may broadcast again, so are invoked after unlocking.
 void obelisk_client::clear_outstanding_subscribe_requests(const code& ec)
 {
+    acceptance_map acceptances;
+
     // Critical Section.
     ///////////////////////////////////////////////////////////////////////////
-    system::unique_lock lock(subscription_lock_);
+    subscription_lock_.lock();
 
     for (auto& it: subscription_handlers_)
-        it.second.first(ec, {}, {}, {});
+    {
+        for (auto& handler: it.second.handlers)
+        {
+            handler.second(ec, {}, {}, {});
+            request_ids_.release(handler.first);
+        }
+
+        request_ids_.release(it.first);
+    }
     for (auto& it: unsubscription_handlers_)
+    {
         it.second.first(ec);
+        request_ids_.release(it.first);
+    }
 
+    acceptances.swap(acceptances_);
     subscription_handlers_.clear();
+    subscription_keys_.clear();
+    local_subscriptions_.clear();
+    renewals_ = renewal_queue();
     unsubscription_handlers_.clear();
+    subscription_lock_.unlock();
     ///////////////////////////////////////////////////////////////////////////
+
+    const auto now = steady_clock::now();
+    for (const auto& it: acceptances)
+        it.second.handler(ec, duration_cast<milliseconds>(
+            now - it.second.broadcast));
 }
 
 // Fetchers.
@@ -913,31 +1793,103 @@ void obelisk_client::server_version(version_handler handler)
 {
     static const std::string command = "server.version";
     static const data_chunk empty{};
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     version_handlers_[id] = handler;
-    if (!send_request(command, id, empty))
+    if (id == 0 || !send_request(command, id, empty))
         handle_immediate(command, id, error::network_unreachable);
 }
 
+void obelisk_client::send_command(payload_handler handler,
+    const std::string& command, const data_chunk& payload)
+{
+    const auto id = request_ids_.allocate();
+    payload_handlers_[id] = handler;
+    if (id == 0 || !send_request(command, id, payload))
+    {
+        payload_handlers_.erase(id);
+        request_ids_.release(id);
+        handler(error::network_unreachable, {});
+    }
+}
+
 // This will fail if a witness tx is sent to a < v3.4 (pre-witness) server.
 void obelisk_client::transaction_pool_broadcast(result_handler handler,
     const chain::transaction& tx)
 {
     static const std::string command = "transaction_pool.broadcast";
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     result_handlers_[id] = handler;
-    if (!send_request(command, id, tx.to_data(true, true)))
+    if (id == 0 || !send_request(command, id, tx.to_data(true, true)))
         handle_immediate(command, id, error::network_unreachable);
 }
 
+// Acceptance is pending from before the broadcast so that the transaction
+// cannot be missed on the stream, and no polling requests are made.
+void obelisk_client::transaction_pool_broadcast_and_await(
+    acceptance_handler handler, const chain::transaction& tx,
+    uint32_t timeout_milliseconds)
+{
+    if (!on_transaction_update_)
+    {
+        handler(error::operation_failed, milliseconds::zero());
+        return;
+    }
+
+    const auto tx_hash = tx.hash();
+    const auto now = steady_clock::now();
+    const auto deadline = now + milliseconds(timeout_milliseconds);
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    subscription_lock_.lock();
+    if (acceptances_.find(tx_hash) != acceptances_.end())
+    {
+        subscription_lock_.unlock();
+        handler(error::duplicate_transaction, milliseconds::zero());
+        return;
+    }
+
+    acceptances_[tx_hash] = { handler, now, deadline };
+    acceptance_deadlines_.emplace(deadline, tx_hash);
+    subscription_lock_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    auto on_broadcast = [this, tx_hash](const code& ec)
+    {
+        if (!ec)
+            return;
+
+        // Critical Section.
+        ///////////////////////////////////////////////////////////////////////
+        subscription_lock_.lock_upgrade();
+        const auto it = acceptances_.find(tx_hash);
+        if (it == acceptances_.end())
+        {
+            subscription_lock_.unlock_upgrade();
+            return;
+        }
+
+        const auto pending = it->second;
+        subscription_lock_.unlock_upgrade_and_lock();
+        acceptances_.erase(it);
+        subscription_lock_.unlock();
+        ///////////////////////////////////////////////////////////////////////
+
+        pending.handler(ec, duration_cast<milliseconds>(
+            steady_clock::now() - pending.broadcast));
+    };
+
+    transaction_pool_broadcast(on_broadcast, tx);
+}
+
 // This will fail if a witness tx is sent to a < v3.4 (pre-witness) server.
 void obelisk_client::transaction_pool_validate2(result_handler handler,
     const chain::transaction& tx)
 {
     static const std::string command = "transaction_pool.validate2";
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     result_handlers_[id] = handler;
-    if (!send_request(command, id, tx.to_data(true, true)))
+    if (id == 0 || !send_request(command, id, tx.to_data(true, true)))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -946,9 +1898,9 @@ void obelisk_client::transaction_pool_fetch_transaction(
 {
     static const std::string command = "transaction_pool.fetch_transaction";
     const auto data = build_chunk({ tx_hash });
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     transaction_handlers_[id] = handler;
-    if (!send_request(command, id, data))
+    if (id == 0 || !send_request(command, id, data))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -956,10 +1908,17 @@ void obelisk_client::transaction_pool_fetch_transaction2(
      transaction_handler handler, const hash_digest& tx_hash)
 {
     static const std::string command = "transaction_pool.fetch_transaction2";
+
+    if (!witness_)
+    {
+        transaction_pool_fetch_transaction(handler, tx_hash);
+        return;
+    }
+
     const auto data = build_chunk({ tx_hash });
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     transaction_handlers_[id] = handler;
-    if (!send_request(command, id, data))
+    if (id == 0 || !send_request(command, id, data))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -967,9 +1926,9 @@ void obelisk_client::blockchain_broadcast(result_handler handler,
     const chain::block& block)
 {
     static const std::string command = "blockchain.broadcast";
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     result_handlers_[id] = handler;
-    if (!send_request(command, id, block.to_data()))
+    if (id == 0 || !send_request(command, id, block.to_data()))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -977,9 +1936,9 @@ void obelisk_client::blockchain_validate(result_handler handler,
     const chain::block& block)
 {
     static const std::string command = "blockchain.validate";
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     result_handlers_[id] = handler;
-    if (!send_request(command, id, block.to_data()))
+    if (id == 0 || !send_request(command, id, block.to_data()))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -988,9 +1947,9 @@ void obelisk_client::blockchain_fetch_transaction(
 {
     static const std::string command = "blockchain.fetch_transaction";
     const auto data = build_chunk({ tx_hash });
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     transaction_handlers_[id] = handler;
-    if (!send_request(command, id, data))
+    if (id == 0 || !send_request(command, id, data))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -998,10 +1957,17 @@ void obelisk_client::blockchain_fetch_transaction2(
      transaction_handler handler, const hash_digest& tx_hash)
 {
     static const std::string command = "blockchain.fetch_transaction2";
+
+    if (!witness_)
+    {
+        blockchain_fetch_transaction(handler, tx_hash);
+        return;
+    }
+
     const auto data = build_chunk({ tx_hash });
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     transaction_handlers_[id] = handler;
-    if (!send_request(command, id, data))
+    if (id == 0 || !send_request(command, id, data))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -1009,9 +1975,9 @@ void obelisk_client::blockchain_fetch_last_height(height_handler handler)
 {
     static const std::string command = "blockchain.fetch_last_height";
     const data_chunk data{};
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     height_handlers_[id] = handler;
-    if (!send_request(command, id, data))
+    if (id == 0 || !send_request(command, id, data))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -1020,21 +1986,40 @@ void obelisk_client::blockchain_fetch_block(block_handler handler,
 {
     static const std::string command = "blockchain.fetch_block";
     const auto data = build_chunk({ to_little_endian<uint32_t>(height) });
-    const auto id = ++last_request_index_;
-    block_handlers_[id] = handler;
-    if (!send_request(command, id, data))
-        handle_immediate(command, id, error::network_unreachable);
+    const auto id = request_ids_.allocate();
+    const auto on_block = cache_block(handler);
+
+    if (block_decoder_)
+        block_decodes_[id] = block_decoder_->reserve(on_block);
+    else
+        block_handlers_[id] = on_block;
+
+    send_budgeted_request(command, id, data);
 }
 
 void obelisk_client::blockchain_fetch_block(block_handler handler,
     const hash_digest& block_hash)
 {
     static const std::string command = "blockchain.fetch_block";
+
+    chain::block cached;
+    if (shared_cache_ && shared_cache_->find_block(block_hash, cached) &&
+        (!verify_merkle_ || cached.is_valid_merkle_root()))
+    {
+        handler(error::success, cached);
+        return;
+    }
+
     const auto data = build_chunk({ block_hash });
-    const auto id = ++last_request_index_;
-    block_handlers_[id] = handler;
-    if (!send_request(command, id, data))
-        handle_immediate(command, id, error::network_unreachable);
+    const auto id = request_ids_.allocate();
+    const auto on_block = cache_block(handler);
+
+    if (block_decoder_)
+        block_decodes_[id] = block_decoder_->reserve(on_block);
+    else
+        block_handlers_[id] = on_block;
+
+    send_budgeted_request(command, id, data);
 }
 
 void obelisk_client::blockchain_fetch_block_header(
@@ -1042,9 +2027,9 @@ void obelisk_client::blockchain_fetch_block_header(
 {
     static const std::string command = "blockchain.fetch_block_header";
     const auto data = build_chunk({ to_little_endian<uint32_t>(height) });
-    const auto id = ++last_request_index_;
-    block_header_handlers_[id] = handler;
-    if (!send_request(command, id, data))
+    const auto id = request_ids_.allocate();
+    block_header_handlers_[id] = cache_header(handler);
+    if (id == 0 || !send_request(command, id, data))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -1052,10 +2037,18 @@ void obelisk_client::blockchain_fetch_block_header(block_header_handler handler,
     const hash_digest& block_hash)
 {
     static const std::string command = "blockchain.fetch_block_header";
+
+    chain::header cached;
+    if (shared_cache_ && shared_cache_->find_header(block_hash, cached))
+    {
+        handler(error::success, cached);
+        return;
+    }
+
     const auto data = build_chunk({ block_hash });
-    const auto id = ++last_request_index_;
-    block_header_handlers_[id] = handler;
-    if (!send_request(command, id, data))
+    const auto id = request_ids_.allocate();
+    block_header_handlers_[id] = cache_header(handler);
+    if (id == 0 || !send_request(command, id, data))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -1063,10 +2056,45 @@ void obelisk_client::blockchain_fetch_transaction_index(
     transaction_index_handler handler, const hash_digest& tx_hash)
 {
     static const std::string command = "blockchain.fetch_transaction_index";
+
+    size_t cached_height;
+    size_t cached_position;
+    if (index_cache_ && index_cache_->find_transaction(tx_hash,
+        cached_height, cached_position))
+    {
+        handler(error::success, cached_height, cached_position);
+        return;
+    }
+
+    auto on_index = handler;
+    if (index_cache_)
+    {
+        const auto cache = index_cache_;
+        on_index = [cache, handler, tx_hash](const code& ec, size_t height,
+            size_t position)
+        {
+            if (!ec)
+                cache->store_transaction(tx_hash, height, position);
+
+            handler(ec, height, position);
+        };
+    }
+
     const auto data = build_chunk({ tx_hash });
-    const auto id = ++last_request_index_;
-    transaction_index_handlers_[id] = handler;
-    if (!send_request(command, id, data))
+    const auto id = request_ids_.allocate();
+    transaction_index_handlers_[id] = on_index;
+    if (id == 0 || !send_request(command, id, data))
+        handle_immediate(command, id, error::network_unreachable);
+}
+
+void obelisk_client::blockchain_fetch_spend(spend_handler handler,
+    const output_point& outpoint)
+{
+    static const std::string command = "blockchain.fetch_spend";
+    const auto data = outpoint.to_data();
+    const auto id = request_ids_.allocate();
+    spend_handlers_[id] = handler;
+    if (id == 0 || !send_request(command, id, data))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -1086,10 +2114,9 @@ void obelisk_client::blockchain_fetch_history4(history_handler handler,
         to_little_endian<uint32_t>(from_height)
     });
 
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     history_handlers_[id] = handler;
-    if (!send_request(command, id, data))
-        handle_immediate(command, id, error::network_unreachable);
+    send_budgeted_request(command, id, data);
 }
 
 void obelisk_client::blockchain_fetch_unspent_outputs(
@@ -1105,36 +2132,90 @@ void obelisk_client::blockchain_fetch_unspent_outputs(
         to_little_endian<uint32_t>(from_height)
     });
 
-    auto select_from_history = [handler, satoshi, algorithm](
-        const code&, const history::list& rows)
+    auto select_from_unspent = [handler, satoshi, algorithm](
+        const code& ec, const chain::points_value& unspent)
     {
-        chain::points_value unspent;
-        unspent.points.reserve(rows.size());
-
-        for (const auto& row: rows)
-            if (row.spend.is_null())
-                unspent.points.emplace_back(row.output, row.value);
+        if (ec)
+        {
+            handler(ec, {});
+            return;
+        }
 
-        unspent.points.shrink_to_fit();
         chain::points_value selected;
         select_outputs::select(selected, unspent, satoshi, algorithm);
         handler(error::success, selected);
     };
 
-    const auto id = ++last_request_index_;
-    history_handlers_[id] = select_from_history;
-    if (!send_request(command, id, data))
-        handle_immediate(command, id, error::network_unreachable);
+    const auto id = request_ids_.allocate();
+    unspent_handlers_[id] = select_from_unspent;
+    send_budgeted_request(command, id, data);
+}
+
+void obelisk_client::blockchain_fetch_unspent_outputs(
+    points_value_handler handler, const hash_digest& key, uint64_t satoshi,
+    uint64_t cost_of_change, const asio::milliseconds& budget)
+{
+    static constexpr uint32_t from_height = 0;
+    static const std::string command = "blockchain.fetch_history4";
+
+    const auto data = build_chunk(
+    {
+        key,
+        to_little_endian<uint32_t>(from_height)
+    });
+
+    // The decoded set is indexed in place, not copied.
+    auto select_from_unspent = [handler, satoshi, cost_of_change, budget](
+        const code& ec, const chain::points_value& unspent)
+    {
+        if (ec)
+        {
+            handler(ec, {});
+            return;
+        }
+
+        chain::points_value selected;
+        if (!coin_selection(unspent).select(selected, satoshi, cost_of_change,
+            budget))
+            selected.points.clear();
+
+        handler(error::success, selected);
+    };
+
+    const auto id = request_ids_.allocate();
+    unspent_handlers_[id] = select_from_unspent;
+    send_budgeted_request(command, id, data);
 }
 
 void obelisk_client::blockchain_fetch_block_height(height_handler handler,
     const hash_digest& block_hash)
 {
     static const std::string command = "blockchain.fetch_block_height";
+
+    size_t cached_height;
+    if (index_cache_ && index_cache_->find_height(block_hash, cached_height))
+    {
+        handler(error::success, cached_height);
+        return;
+    }
+
+    auto on_height = handler;
+    if (index_cache_)
+    {
+        const auto cache = index_cache_;
+        on_height = [cache, handler, block_hash](const code& ec, size_t height)
+        {
+            if (!ec)
+                cache->store_height(block_hash, height);
+
+            handler(ec, height);
+        };
+    }
+
     const auto data = build_chunk({ block_hash });
-    const auto id = ++last_request_index_;
-    height_handlers_[id] = handler;
-    if (!send_request(command, id, data))
+    const auto id = request_ids_.allocate();
+    height_handlers_[id] = on_height;
+    if (id == 0 || !send_request(command, id, data))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -1143,9 +2224,9 @@ void obelisk_client::blockchain_fetch_block_transaction_hashes(
 {
     static const std::string command = "blockchain.fetch_block_transaction_hashes";
     const auto data = build_chunk({ to_little_endian<uint32_t>(height) });
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     hash_list_handlers_[id] = handler;
-    if (!send_request(command, id, data))
+    if (id == 0 || !send_request(command, id, data))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -1154,9 +2235,9 @@ void obelisk_client::blockchain_fetch_block_transaction_hashes(
 {
     static const std::string command = "blockchain.fetch_block_transaction_hashes";
     const auto data = build_chunk({ block_hash });
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     hash_list_handlers_[id] = handler;
-    if (!send_request(command, id, data))
+    if (id == 0 || !send_request(command, id, data))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -1169,9 +2250,9 @@ void obelisk_client::blockchain_fetch_compact_filter(
         to_little_endian<uint32_t>(height)
     });
 
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     compact_filter_handlers_[id] = handler;
-    if (!send_request(command, id, data))
+    if (id == 0 || !send_request(command, id, data))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -1185,9 +2266,9 @@ void obelisk_client::blockchain_fetch_compact_filter(
         block_hash
     });
 
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     compact_filter_handlers_[id] = handler;
-    if (!send_request(command, id, data))
+    if (id == 0 || !send_request(command, id, data))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -1202,9 +2283,9 @@ void obelisk_client::blockchain_fetch_compact_filter_headers(
         stop_hash
     });
 
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     compact_filter_headers_handlers_[id] = handler;
-    if (!send_request(command, id, data))
+    if (id == 0 || !send_request(command, id, data))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -1219,9 +2300,9 @@ void obelisk_client::blockchain_fetch_compact_filter_headers(
         to_little_endian<uint32_t>(stop_height)
     });
 
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     compact_filter_headers_handlers_[id] = handler;
-    if (!send_request(command, id, data))
+    if (id == 0 || !send_request(command, id, data))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -1235,9 +2316,9 @@ void obelisk_client::blockchain_fetch_compact_filter_checkpoint(
         stop_hash
     });
 
-    const auto id = ++last_request_index_;
+    const auto id = request_ids_.allocate();
     compact_filter_checkpoint_handlers_[id] = handler;
-    if (!send_request(command, id, data))
+    if (id == 0 || !send_request(command, id, data))
         handle_immediate(command, id, error::network_unreachable);
 }
 
@@ -1251,9 +2332,9 @@ void obelisk_client::blockchain_fetch_compact_filter_checkpoint(
 //        to_little_endian<uint32_t>(stop_height)
 //    });
 //
-//    const auto id = ++last_request_index_;
+//    const auto id = request_ids_.allocate();
 //    compact_filter_checkpoint_handlers_[id] = handler;
-//    if (!send_request(command, id, data))
+//    if (id == 0 || !send_request(command, id, data))
 //        handle_immediate(command, id, error::network_unreachable);
 //}
 
@@ -1261,22 +2342,47 @@ void obelisk_client::blockchain_fetch_compact_filter_checkpoint(
 //-----------------------------------------------------------------------------
 
 // subscribe.address is renamed to subscribe.key (v4.0), input key differs.
+// Only the first subscriber to a key subscribes with the server, subsequent
+// subscribers to the key share its notifications.
 uint32_t obelisk_client::subscribe_key(update_handler handler,
     const hash_digest& key)
 {
     static const std::string command = "subscribe.key";
-    // [ key:32 ]
-    const auto data = build_chunk({ key });
 
     // Critical Section.
     ///////////////////////////////////////////////////////////////////////////
     subscription_lock_.lock();
-    const auto id = ++last_request_index_;
-    subscription_handlers_[id] = { handler, data };
+    const auto id = request_ids_.allocate();
+    if (id == 0)
+    {
+        subscription_lock_.unlock();
+        handler(error::network_unreachable, {}, {}, {});
+        return null_subscription;
+    }
+
+    const auto existing = subscription_keys_.find(key);
+    if (existing != subscription_keys_.end())
+    {
+        const auto subscription = existing->second;
+        subscription_handlers_[subscription].handlers[id] = handler;
+        local_subscriptions_[id] = subscription;
+        subscription_lock_.unlock();
+
+        handler(error::success, {}, {}, {});
+        return id;
+    }
+
+    auto& subscription = subscription_handlers_[id];
+    subscription.key = key;
+    subscription.handlers[id] = handler;
+    subscription_keys_[key] = id;
+    local_subscriptions_[id] = id;
+    schedule_renewal(id, subscription, steady_clock::now());
     subscription_lock_.unlock();
     ///////////////////////////////////////////////////////////////////////////
 
-    if (!send_request(command, id, data, true))
+    // [ key:32 ]
+    if (!send_request(command, id, build_chunk({ key }), true))
     {
         handle_immediate(command, id, error::network_unreachable);
         return null_subscription;
@@ -1286,7 +2392,81 @@ uint32_t obelisk_client::subscribe_key(update_handler handler,
     return id;
 }
 
+// Notifications are buffered from the first after each flush until the window
+// elapses, and pending updates are flushed ahead of any subscription error
+// and upon unsubscription.
+uint32_t obelisk_client::subscribe_key(coalesced_update_handler handler,
+    const hash_digest& key, uint32_t debounce_milliseconds)
+{
+    const auto state = std::make_shared<debounce>();
+    state->handler = handler;
+    state->window = milliseconds(debounce_milliseconds);
+    state->subscription = null_subscription;
+
+    auto coalesce = [this, state](const code& ec, uint16_t sequence,
+        size_t height, const hash_digest& tx_hash)
+    {
+        if (!ec && tx_hash == null_hash)
+        {
+            state->handler(ec, {});
+            return;
+        }
+
+        // Critical Section.
+        ///////////////////////////////////////////////////////////////////////
+        update_lock_.lock();
+
+        if (ec)
+        {
+            const auto updates = std::move(state->updates);
+            state->updates.clear();
+            debounces_.erase(state->subscription);
+            update_lock_.unlock();
+
+            if (!updates.empty())
+                state->handler(error::success, updates);
+
+            state->handler(ec, {});
+            return;
+        }
+
+        // Notifications that follow unsubscription are not buffered.
+        if (debounces_.find(state->subscription) == debounces_.end())
+        {
+            update_lock_.unlock();
+            state->handler(ec, { { sequence, height, tx_hash } });
+            return;
+        }
+
+        if (state->updates.empty())
+        {
+            state->flush = steady_clock::now() + state->window;
+            flushes_.emplace(state->flush, state);
+        }
+
+        state->updates.push_back({ sequence, height, tx_hash });
+        update_lock_.unlock();
+        ///////////////////////////////////////////////////////////////////////
+    };
+
+    const auto subscription = subscribe_key(coalesce, key);
+    if (subscription == null_subscription)
+        return subscription;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    update_lock_.lock();
+    state->subscription = subscription;
+    debounces_[subscription] = state;
+    update_lock_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    return subscription;
+}
+
 // unsubscribe.address is renamed to unsubscribe.key (v4.0), input key differs.
+// The server is only unsubscribed once the last local subscriber of the key
+// has unsubscribed, otherwise the handler is invoked immediately.
 bool obelisk_client::unsubscribe_key(result_handler handler,
     uint32_t subscription)
 {
@@ -1297,21 +2477,46 @@ bool obelisk_client::unsubscribe_key(result_handler handler,
     // Critical Section.
     ///////////////////////////////////////////////////////////////////////////
     subscription_lock_.lock_upgrade();
-    auto it = subscription_handlers_.find(subscription);
-    if (it == subscription_handlers_.end())
+    const auto local = local_subscriptions_.find(subscription);
+    if (local == local_subscriptions_.end())
     {
         subscription_lock_.unlock_upgrade();
         return false;
     }
 
+    const auto server_subscription = local->second;
+    auto it = subscription_handlers_.find(server_subscription);
+    BITCOIN_ASSERT(it != subscription_handlers_.end());
+
     subscription_lock_.unlock_upgrade_and_lock();
-    const auto id = ++last_request_index_;
-    unsubscription_handlers_[id] = { handler, subscription };
-    data = it->second.second;
+    local_subscriptions_.erase(local);
+
+    if (it->second.handlers.size() > 1)
+    {
+        // The server subscription id is retained until it is removed.
+        it->second.handlers.erase(subscription);
+        if (subscription != server_subscription)
+            request_ids_.release(subscription);
+
+        subscription_lock_.unlock();
+
+        flush_unsubscribed(subscription);
+        handler(error::success);
+        return true;
+    }
+
+    // New subscribers to the key must not join the terminating subscription.
+    subscription_keys_.erase(it->second.key);
+
+    const auto id = request_ids_.allocate();
+    unsubscription_handlers_[id] = { handler, server_subscription };
+    data = build_chunk({ it->second.key });
     subscription_lock_.unlock();
     ///////////////////////////////////////////////////////////////////////////
 
-    if (!send_request(command, id, data, true))
+    flush_unsubscribed(subscription);
+
+    if (id == 0 || !send_request(command, id, data, true))
     {
         handle_immediate(command, id, error::network_unreachable);
         return false;
@@ -1335,13 +2540,31 @@ bool obelisk_client::terminate_unsubscriber(uint32_t subscription)
     }
 
     subscription_lock_.unlock_upgrade_and_lock();
-    subscription_handlers_.erase(it);
+    remove_subscription(it);
     subscription_lock_.unlock();
     ///////////////////////////////////////////////////////////////////////////
 
     return true;
 }
 
+void obelisk_client::remove_subscription(
+    subscription_handler_map::iterator it)
+{
+    const auto key = subscription_keys_.find(it->second.key);
+    if (key != subscription_keys_.end() && key->second == it->first)
+        subscription_keys_.erase(key);
+
+    for (const auto& handler: it->second.handlers)
+    {
+        local_subscriptions_.erase(handler.first);
+        request_ids_.release(handler.first);
+    }
+
+    request_ids_.release(it->first);
+
+    subscription_handlers_.erase(it);
+}
+
 
 } // namespace client
 } // namespace libbitcoin
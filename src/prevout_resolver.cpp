@@ -0,0 +1,274 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/client/prevout_resolver.hpp>
+
+#include <algorithm>
+
+using namespace bc::system;
+using namespace bc::system::chain;
+
+namespace libbitcoin {
+namespace client {
+
+prevout_resolver::prevout_resolver(obelisk_client& client,
+    size_t maximum_in_flight, size_t cache_limit)
+  : prevout_resolver(
+        [&client](obelisk_client::transaction_handler handler,
+            const hash_digest& tx_hash)
+        {
+            client.transaction_pool_fetch_transaction2(handler, tx_hash);
+        }, maximum_in_flight, cache_limit)
+{
+}
+
+prevout_resolver::prevout_resolver(fetcher fetch, size_t maximum_in_flight,
+    size_t cache_limit)
+  : fetch_(fetch),
+    maximum_in_flight_(std::max(maximum_in_flight, size_t(1))),
+    cache_limit_(cache_limit),
+    in_flight_(0),
+    pumping_(false)
+{
+}
+
+void prevout_resolver::resolve(resolution_handler handler,
+    const transaction& tx)
+{
+    auto handle_batch = [handler](const code& ec,
+        const resolution::list& resolutions)
+    {
+        handler(ec, ec ? resolution{} : resolutions.front());
+    };
+
+    resolve(handle_batch, transaction::list{ tx });
+}
+
+// Inputs with cached previous outputs are resolved immediately, and the
+// remainder are grouped by previous transaction so that each is fetched once.
+void prevout_resolver::resolve(batch_handler handler,
+    const transaction::list& txs)
+{
+    const auto job = std::make_shared<batch>();
+    job->txs = txs;
+    job->resolutions.resize(txs.size(), resolution{});
+    job->handler = handler;
+    job->complete = false;
+
+    for (uint32_t position = 0; position < txs.size(); ++position)
+    {
+        const auto& tx = txs[position];
+        if (tx.is_coinbase())
+            continue;
+
+        const auto& inputs = tx.inputs();
+        job->resolutions[position].values.resize(inputs.size(), 0);
+
+        for (uint32_t index = 0; index < inputs.size(); ++index)
+            job->missing[inputs[index].previous_output().hash()].push_back(
+                { position, index });
+    }
+
+    code ec;
+    for (auto it = job->missing.begin(); it != job->missing.end();)
+    {
+        const auto cached = cache_.find(it->first);
+        if (cached == cache_.end())
+        {
+            ++it;
+            continue;
+        }
+
+        const auto tx_hash = it++->first;
+        if (!fill(*job, tx_hash, cached->second, ec))
+        {
+            finish(*job, ec);
+            return;
+        }
+    }
+
+    if (job->missing.empty())
+    {
+        finish(*job, error::success);
+        return;
+    }
+
+    // Coalesce with fetches already queued or in flight.
+    for (const auto& entry: job->missing)
+    {
+        auto& waiters = waiting_[entry.first];
+        if (waiters.empty())
+            queue_.push_back(entry.first);
+
+        waiters.push_back(job);
+    }
+
+    pump();
+}
+
+size_t prevout_resolver::in_flight() const
+{
+    return in_flight_;
+}
+
+size_t prevout_resolver::cached() const
+{
+    return cache_.size();
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+bool prevout_resolver::fill(batch& job, const hash_digest& tx_hash,
+    const output_values& values, code& ec) const
+{
+    const auto it = job.missing.find(tx_hash);
+    if (it == job.missing.end())
+        return true;
+
+    for (const auto& position: it->second)
+    {
+        const auto& input = job.txs[position.first].inputs()[position.second];
+        const auto index = input.previous_output().index();
+
+        if (index >= values.size())
+        {
+            ec = error::not_found;
+            return false;
+        }
+
+        job.resolutions[position.first].values[position.second] =
+            values[index];
+    }
+
+    job.missing.erase(it);
+    return true;
+}
+
+void prevout_resolver::finish(batch& job, const code& ec) const
+{
+    job.complete = true;
+
+    if (ec)
+    {
+        job.handler(ec, {});
+        return;
+    }
+
+    for (size_t position = 0; position < job.txs.size(); ++position)
+    {
+        const auto& tx = job.txs[position];
+        auto& result = job.resolutions[position];
+        if (tx.is_coinbase())
+            continue;
+
+        uint64_t input_value = 0;
+        for (const auto value: result.values)
+            input_value += value;
+
+        const auto output_value = tx.total_output_value();
+        if (input_value < output_value)
+        {
+            job.handler(error::spend_exceeds_value, {});
+            return;
+        }
+
+        const auto virtual_size = (tx.weight() + 3) / 4;
+        result.fee = input_value - output_value;
+        result.fee_rate = virtual_size == 0 ? 0.0 :
+            static_cast<double>(result.fee) / virtual_size;
+    }
+
+    job.handler(error::success, job.resolutions);
+}
+
+void prevout_resolver::handle_fetch(const hash_digest& tx_hash,
+    const code& ec, const transaction& tx)
+{
+    --in_flight_;
+
+    output_values values;
+    if (!ec)
+    {
+        values.reserve(tx.outputs().size());
+        for (const auto& output: tx.outputs())
+            values.push_back(output.value());
+
+        cache(tx_hash, values);
+    }
+
+    // Waiters are taken first as their handlers may resolve again.
+    const auto waiting = waiting_.find(tx_hash);
+    const auto waiters = std::move(waiting->second);
+    waiting_.erase(waiting);
+
+    for (const auto& job: waiters)
+    {
+        if (job->complete)
+            continue;
+
+        auto error = ec;
+        if (!error)
+            fill(*job, tx_hash, values, error);
+
+        if (error || job->missing.empty())
+            finish(*job, error);
+    }
+
+    pump();
+}
+
+void prevout_resolver::cache(const hash_digest& tx_hash,
+    const output_values& values)
+{
+    if (cache_limit_ == 0 || !cache_.emplace(tx_hash, values).second)
+        return;
+
+    cache_order_.push_back(tx_hash);
+    if (cache_order_.size() > cache_limit_)
+    {
+        cache_.erase(cache_order_.front());
+        cache_order_.pop_front();
+    }
+}
+
+// Fetches may complete immediately (such as upon send failure), so this does
+// not recurse but continues the loop of the outermost invocation.
+void prevout_resolver::pump()
+{
+    if (pumping_)
+        return;
+
+    pumping_ = true;
+    while (in_flight_ < maximum_in_flight_ && !queue_.empty())
+    {
+        const auto tx_hash = queue_.front();
+        queue_.pop_front();
+        ++in_flight_;
+
+        fetch_([this, tx_hash](const code& ec, const transaction& tx)
+        {
+            handle_fetch(tx_hash, ec, tx);
+        }, tx_hash);
+    }
+
+    pumping_ = false;
+}
+
+} // namespace client
+} // namespace libbitcoin
@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/client/request_ids.hpp>
+
+#include <algorithm>
+
+using namespace bc::system;
+
+namespace libbitcoin {
+namespace client {
+
+const uint32_t request_ids::slot_bits;
+const size_t request_ids::capacity;
+const size_t request_ids::reuse_delay;
+
+static constexpr uint32_t slot_mask =
+    (uint32_t(1) << request_ids::slot_bits) - 1;
+static constexpr uint16_t generation_mask = max_uint32 >> request_ids::slot_bits;
+
+// The reserved slot zero is never allocated.
+request_ids::request_ids(size_t limit)
+  : slots_(1, { 0, false }),
+    limit_(std::min(limit, capacity)),
+    allocated_(0)
+{
+}
+
+// The slot of all ones is not used, as the id could be max_uint32.
+uint32_t request_ids::allocate()
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (allocated_ >= limit_)
+        return 0;
+
+    uint32_t index;
+    if (released_.size() > reuse_delay || (slots_.size() == slot_mask &&
+        !released_.empty()))
+    {
+        index = released_.front();
+        released_.pop_front();
+    }
+    else if (slots_.size() < slot_mask)
+    {
+        index = static_cast<uint32_t>(slots_.size());
+        slots_.push_back({ 0, false });
+    }
+    else
+    {
+        return 0;
+    }
+
+    auto& allocated = slots_[index];
+    allocated.allocated = true;
+    ++allocated_;
+    return (uint32_t(allocated.generation) << slot_bits) | index;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+bool request_ids::release(uint32_t id)
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!is_current(id))
+        return false;
+
+    const auto index = id & slot_mask;
+    auto& released = slots_[index];
+    released.allocated = false;
+    released.generation = static_cast<uint16_t>(
+        (released.generation + 1) & generation_mask);
+    released_.push_back(index);
+    --allocated_;
+    return true;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+bool request_ids::is_allocated(uint32_t id) const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+    return is_current(id);
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+size_t request_ids::size() const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+    return allocated_;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+bool request_ids::is_current(uint32_t id) const
+{
+    const auto index = id & slot_mask;
+    return index != 0 && index < slots_.size() && slots_[index].allocated &&
+        slots_[index].generation == (id >> slot_bits);
+}
+
+} // namespace client
+} // namespace libbitcoin
@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/client/response_cache.hpp>
+
+using namespace bc::system;
+using namespace std::chrono;
+
+namespace libbitcoin {
+namespace client {
+
+response_cache::response_cache(size_t capacity,
+    uint32_t time_to_live_milliseconds)
+  : capacity_(capacity),
+    time_to_live_(time_to_live_milliseconds),
+    bytes_(0)
+{
+}
+
+bool response_cache::find(const std::string& command,
+    const data_chunk& request, data_chunk& out_response)
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const auto it = entries_.find(to_key(command, request));
+    if (it == entries_.end())
+        return false;
+
+    if (steady_clock::now() >= it->second.expiry)
+    {
+        erase(it);
+        return false;
+    }
+
+    usage_.splice(usage_.begin(), usage_, it->second.usage);
+    out_response = it->second.response;
+    return true;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void response_cache::store(const std::string& command,
+    const data_chunk& request, const data_chunk& response)
+{
+    if (response.size() > capacity_)
+        return;
+
+    const auto key = to_key(command, request);
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const auto existing = entries_.find(key);
+    if (existing != entries_.end())
+        erase(existing);
+
+    while (bytes_ + response.size() > capacity_)
+        erase(entries_.find(usage_.back()));
+
+    usage_.push_front(key);
+    entries_[key] = { response, steady_clock::now() + time_to_live_,
+        usage_.begin() };
+    bytes_ += response.size();
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void response_cache::clear()
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    usage_.clear();
+    bytes_ = 0;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+size_t response_cache::size() const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+size_t response_cache::bytes() const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// Commands contain no null character, so the key is unambiguous.
+std::string response_cache::to_key(const std::string& command,
+    const data_chunk& request)
+{
+    std::string key(command);
+    key.push_back('\0');
+    key.append(request.begin(), request.end());
+    return key;
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+void response_cache::erase(entry_map::iterator it)
+{
+    bytes_ -= it->second.response.size();
+    usage_.erase(it->second.usage);
+    entries_.erase(it);
+}
+
+} // namespace client
+} // namespace libbitcoin
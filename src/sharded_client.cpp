@@ -0,0 +1,673 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/client/sharded_client.hpp>
+
+#include <algorithm>
+#include <future>
+
+using namespace bc::system;
+using namespace bc::system::chain;
+using namespace bc::system::config;
+using namespace bc::system::wallet;
+
+namespace libbitcoin {
+namespace client {
+
+// The adapter sets the deadline of each request of the client.
+sharded_client::shard::shard(int32_t retries, uint32_t timeout_milliseconds)
+  : client(retries),
+    adapter(service, client, timeout_milliseconds)
+{
+}
+
+sharded_client::sharded_client(size_t shards, int32_t retries,
+    uint32_t timeout_milliseconds)
+  : turn_(0),
+    outstanding_(0),
+    started_(false),
+    last_subscription_(0)
+{
+    const auto cores = std::max(std::thread::hardware_concurrency(), 1u);
+    const auto count = shards == 0 ? size_t(cores) : shards;
+
+    for (size_t index = 0; index < count; ++index)
+        shards_.emplace_back(new shard(retries, timeout_milliseconds));
+}
+
+sharded_client::~sharded_client()
+{
+    stop();
+}
+
+bool sharded_client::connect(const endpoint& address)
+{
+    for (const auto& target: shards_)
+        if (!target->client.connect(address))
+            return false;
+
+    return start();
+}
+
+bool sharded_client::connect(const connection_settings& settings)
+{
+    for (const auto& target: shards_)
+        if (!target->client.connect(settings))
+            return false;
+
+    return start();
+}
+
+// Queued requests are sent before outstanding requests are failed.
+void sharded_client::stop()
+{
+    if (!started_)
+        return;
+
+    for (const auto& target: shards_)
+    {
+        const auto stopping = target.get();
+        boost::asio::post(stopping->service, [stopping]()
+        {
+            stopping->adapter.stop();
+            stopping->client.wait(0);
+            stopping->client.monitor(0);
+            stopping->work.reset();
+        });
+    }
+
+    for (const auto& target: shards_)
+        target->thread.join();
+
+    started_ = false;
+}
+
+size_t sharded_client::shards() const
+{
+    return shards_.size();
+}
+
+// Configuration.
+//-----------------------------------------------------------------------------
+
+void sharded_client::set_subscription_expiration(uint32_t minutes)
+{
+    for (const auto& target: shards_)
+        target->client.set_subscription_expiration(minutes);
+}
+
+void sharded_client::set_index_cache(std::shared_ptr<index_cache> cache)
+{
+    for (const auto& target: shards_)
+        target->client.set_index_cache(cache);
+}
+
+void sharded_client::set_witness(bool witness)
+{
+    for (const auto& target: shards_)
+        target->client.set_witness(witness);
+}
+
+void sharded_client::set_decode_threads(size_t threads, bool verify_merkle)
+{
+    for (const auto& target: shards_)
+        target->client.set_decode_threads(threads, verify_merkle);
+}
+
+// A nonzero budget is not divided to zero, which is no limit.
+void sharded_client::set_memory_budget(size_t bytes)
+{
+    const auto share = bytes == 0 ? size_t(0) :
+        std::max(bytes / shards_.size(), size_t(1));
+
+    for (const auto& target: shards_)
+        target->client.set_memory_budget(share);
+}
+
+// Metrics.
+//-----------------------------------------------------------------------------
+
+size_t sharded_client::memory_usage() const
+{
+    size_t usage = 0;
+    for (const auto& target: shards_)
+        usage += target->client.memory_usage();
+
+    return usage;
+}
+
+asio::milliseconds sharded_client::renewal_lag() const
+{
+    auto lag = asio::milliseconds::zero();
+    for (const auto& target: shards_)
+        lag = std::max(lag, target->client.renewal_lag());
+
+    return lag;
+}
+
+size_t sharded_client::requests_outstanding() const
+{
+    return outstanding_.load();
+}
+
+// Fetchers.
+//-----------------------------------------------------------------------------
+
+void sharded_client::server_version(version_handler handler)
+{
+    auto& target = next();
+    post(target, [this, handler](obelisk_client& client)
+    {
+        client.server_version(track(handler));
+    });
+}
+
+void sharded_client::transaction_pool_broadcast(result_handler handler,
+    const transaction& tx)
+{
+    auto& target = next();
+    post(target, [this, handler, tx](obelisk_client& client)
+    {
+        client.transaction_pool_broadcast(track(handler), tx);
+    });
+}
+
+// Acceptance is observed on the transaction stream, and has its own timeout.
+void sharded_client::transaction_pool_broadcast_and_await(
+    acceptance_handler handler, const transaction& tx,
+    uint32_t timeout_milliseconds)
+{
+    post(*shards_.front(),
+        [handler, tx, timeout_milliseconds](obelisk_client& client)
+        {
+            client.transaction_pool_broadcast_and_await(handler, tx,
+                timeout_milliseconds);
+        });
+}
+
+void sharded_client::transaction_pool_validate2(result_handler handler,
+    const transaction& tx)
+{
+    auto& target = next();
+    post(target, [this, handler, tx](obelisk_client& client)
+    {
+        client.transaction_pool_validate2(track(handler), tx);
+    });
+}
+
+void sharded_client::transaction_pool_fetch_transaction(
+    transaction_handler handler, const hash_digest& tx_hash)
+{
+    auto& target = next();
+    post(target, [this, handler, tx_hash](obelisk_client& client)
+    {
+        client.transaction_pool_fetch_transaction(track(handler),
+            tx_hash);
+    });
+}
+
+void sharded_client::transaction_pool_fetch_transaction2(
+    transaction_handler handler, const hash_digest& tx_hash)
+{
+    auto& target = next();
+    post(target, [this, handler, tx_hash](obelisk_client& client)
+    {
+        client.transaction_pool_fetch_transaction2(track(handler),
+            tx_hash);
+    });
+}
+
+void sharded_client::blockchain_broadcast(result_handler handler,
+    const chain::block& block)
+{
+    auto& target = next();
+    post(target, [this, handler, block](obelisk_client& client)
+    {
+        client.blockchain_broadcast(track(handler), block);
+    });
+}
+
+void sharded_client::blockchain_validate(result_handler handler,
+    const chain::block& block)
+{
+    auto& target = next();
+    post(target, [this, handler, block](obelisk_client& client)
+    {
+        client.blockchain_validate(track(handler), block);
+    });
+}
+
+void sharded_client::blockchain_fetch_transaction(
+    transaction_handler handler, const hash_digest& tx_hash)
+{
+    auto& target = next();
+    post(target, [this, handler, tx_hash](obelisk_client& client)
+    {
+        client.blockchain_fetch_transaction(track(handler), tx_hash);
+    });
+}
+
+void sharded_client::blockchain_fetch_transaction2(
+    transaction_handler handler, const hash_digest& tx_hash)
+{
+    auto& target = next();
+    post(target, [this, handler, tx_hash](obelisk_client& client)
+    {
+        client.blockchain_fetch_transaction2(track(handler),
+            tx_hash);
+    });
+}
+
+void sharded_client::blockchain_fetch_last_height(height_handler handler)
+{
+    auto& target = next();
+    post(target, [this, handler](obelisk_client& client)
+    {
+        client.blockchain_fetch_last_height(track(handler));
+    });
+}
+
+void sharded_client::blockchain_fetch_block(block_handler handler,
+    uint32_t height)
+{
+    auto& target = next();
+    post(target, [this, handler, height](obelisk_client& client)
+    {
+        client.blockchain_fetch_block(track(handler), height);
+    });
+}
+
+void sharded_client::blockchain_fetch_block(block_handler handler,
+    const hash_digest& block_hash)
+{
+    auto& target = next();
+    post(target, [this, handler, block_hash](obelisk_client& client)
+    {
+        client.blockchain_fetch_block(track(handler), block_hash);
+    });
+}
+
+void sharded_client::blockchain_fetch_block_header(
+    block_header_handler handler, uint32_t height)
+{
+    auto& target = next();
+    post(target, [this, handler, height](obelisk_client& client)
+    {
+        client.blockchain_fetch_block_header(track(handler), height);
+    });
+}
+
+void sharded_client::blockchain_fetch_block_header(
+    block_header_handler handler, const hash_digest& block_hash)
+{
+    auto& target = next();
+    post(target, [this, handler, block_hash](obelisk_client& client)
+    {
+        client.blockchain_fetch_block_header(track(handler),
+            block_hash);
+    });
+}
+
+void sharded_client::blockchain_fetch_transaction_index(
+    transaction_index_handler handler, const hash_digest& tx_hash)
+{
+    auto& target = next();
+    post(target, [this, handler, tx_hash](obelisk_client& client)
+    {
+        client.blockchain_fetch_transaction_index(track(handler),
+            tx_hash);
+    });
+}
+
+void sharded_client::blockchain_fetch_spend(spend_handler handler,
+    const output_point& outpoint)
+{
+    auto& target = next();
+    post(target, [this, handler, outpoint](obelisk_client& client)
+    {
+        client.blockchain_fetch_spend(track(handler), outpoint);
+    });
+}
+
+void sharded_client::blockchain_fetch_block_height(height_handler handler,
+    const hash_digest& block_hash)
+{
+    auto& target = next();
+    post(target, [this, handler, block_hash](obelisk_client& client)
+    {
+        client.blockchain_fetch_block_height(track(handler),
+            block_hash);
+    });
+}
+
+void sharded_client::blockchain_fetch_block_transaction_hashes(
+    hash_list_handler handler, uint32_t height)
+{
+    auto& target = next();
+    post(target, [this, handler, height](obelisk_client& client)
+    {
+        client.blockchain_fetch_block_transaction_hashes(
+            track(handler), height);
+    });
+}
+
+void sharded_client::blockchain_fetch_block_transaction_hashes(
+    hash_list_handler handler, const hash_digest& block_hash)
+{
+    auto& target = next();
+    post(target, [this, handler, block_hash](obelisk_client& client)
+    {
+        client.blockchain_fetch_block_transaction_hashes(
+            track(handler), block_hash);
+    });
+}
+
+void sharded_client::blockchain_fetch_compact_filter(
+    compact_filter_handler handler, uint8_t filter_type, uint32_t height)
+{
+    auto& target = next();
+    post(target,
+        [this, handler, filter_type, height](obelisk_client& client)
+        {
+            client.blockchain_fetch_compact_filter(track(handler),
+                filter_type, height);
+        });
+}
+
+void sharded_client::blockchain_fetch_compact_filter(
+    compact_filter_handler handler, uint8_t filter_type,
+    const hash_digest& block_hash)
+{
+    auto& target = next();
+    post(target,
+        [this, handler, filter_type, block_hash](
+            obelisk_client& client)
+        {
+            client.blockchain_fetch_compact_filter(track(handler),
+                filter_type, block_hash);
+        });
+}
+
+void sharded_client::blockchain_fetch_compact_filter_headers(
+    compact_filter_headers_handler handler, uint8_t filter_type,
+    uint32_t start_height, const hash_digest& stop_hash)
+{
+    auto& target = next();
+    post(target,
+        [this, handler, filter_type, start_height, stop_hash](
+            obelisk_client& client)
+        {
+            client.blockchain_fetch_compact_filter_headers(
+                track(handler), filter_type, start_height,
+                stop_hash);
+        });
+}
+
+void sharded_client::blockchain_fetch_compact_filter_headers(
+    compact_filter_headers_handler handler, uint8_t filter_type,
+    uint32_t start_height, uint32_t stop_height)
+{
+    auto& target = next();
+    post(target,
+        [this, handler, filter_type, start_height, stop_height](
+            obelisk_client& client)
+        {
+            client.blockchain_fetch_compact_filter_headers(
+                track(handler), filter_type, start_height,
+                stop_height);
+        });
+}
+
+void sharded_client::blockchain_fetch_compact_filter_checkpoint(
+    compact_filter_checkpoint_handler handler, uint8_t filter_type,
+    const hash_digest& stop_hash)
+{
+    auto& target = next();
+    post(target,
+        [this, handler, filter_type, stop_hash](
+            obelisk_client& client)
+        {
+            client.blockchain_fetch_compact_filter_checkpoint(
+                track(handler), filter_type, stop_hash);
+        });
+}
+
+void sharded_client::blockchain_fetch_history4(history_handler handler,
+    const hash_digest& key, uint32_t from_height)
+{
+    auto& target = next();
+    post(target,
+        [this, handler, key, from_height](obelisk_client& client)
+        {
+            client.blockchain_fetch_history4(track(handler), key,
+                from_height);
+        });
+}
+
+void sharded_client::blockchain_fetch_unspent_outputs(
+    points_value_handler handler, const hash_digest& key, uint64_t satoshi,
+    select_outputs::algorithm algorithm)
+{
+    auto& target = next();
+    post(target,
+        [this, handler, key, satoshi, algorithm](
+            obelisk_client& client)
+        {
+            client.blockchain_fetch_unspent_outputs(track(handler),
+                key, satoshi, algorithm);
+        });
+}
+
+void sharded_client::blockchain_fetch_unspent_outputs(
+    points_value_handler handler, const hash_digest& key, uint64_t satoshi,
+    uint64_t cost_of_change, const asio::milliseconds& budget)
+{
+    auto& target = next();
+    post(target,
+        [this, handler, key, satoshi, cost_of_change, budget](
+            obelisk_client& client)
+        {
+            client.blockchain_fetch_unspent_outputs(track(handler),
+                key, satoshi, cost_of_change, budget);
+        });
+}
+
+// Subscribers.
+//-----------------------------------------------------------------------------
+
+uint32_t sharded_client::subscribe_key(update_handler handler,
+    const hash_digest& key)
+{
+    const auto index = select(key);
+    auto& target = *shards_[index];
+    const auto subscription = execute<uint32_t>(target,
+        [handler, key](obelisk_client& client)
+        {
+            return client.subscribe_key(handler, key);
+        });
+
+    return add_subscription(index, subscription);
+}
+
+uint32_t sharded_client::subscribe_key(coalesced_update_handler handler,
+    const hash_digest& key, uint32_t debounce_milliseconds)
+{
+    const auto index = select(key);
+    auto& target = *shards_[index];
+    const auto subscription = execute<uint32_t>(target,
+        [handler, key, debounce_milliseconds](obelisk_client& client)
+        {
+            return client.subscribe_key(handler, key, debounce_milliseconds);
+        });
+
+    return add_subscription(index, subscription);
+}
+
+bool sharded_client::subscribe_block(const endpoint& address,
+    block_update_handler on_update)
+{
+    return execute<bool>(*shards_.front(),
+        [address, on_update](obelisk_client& client)
+        {
+            return client.subscribe_block(address, on_update);
+        });
+}
+
+bool sharded_client::subscribe_block(const endpoint& address,
+    block_height_update_handler on_update)
+{
+    return execute<bool>(*shards_.front(),
+        [address, on_update](obelisk_client& client)
+        {
+            return client.subscribe_block(address, on_update);
+        });
+}
+
+bool sharded_client::subscribe_transaction(const endpoint& address,
+    transaction_update_handler on_update)
+{
+    return execute<bool>(*shards_.front(),
+        [address, on_update](obelisk_client& client)
+        {
+            return client.subscribe_transaction(address, on_update);
+        });
+}
+
+// Unsubscribers.
+//-----------------------------------------------------------------------------
+
+bool sharded_client::unsubscribe_key(result_handler handler,
+    uint32_t subscription)
+{
+    shard_subscription local;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    subscription_mutex_.lock();
+    const auto it = subscriptions_.find(subscription);
+    if (it == subscriptions_.end())
+    {
+        subscription_mutex_.unlock();
+        return false;
+    }
+
+    local = it->second;
+    subscriptions_.erase(it);
+    subscription_mutex_.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    return execute<bool>(*shards_[local.first],
+        [handler, local](obelisk_client& client)
+        {
+            return client.unsubscribe_key(handler, local.second);
+        });
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+sharded_client::shard& sharded_client::next()
+{
+    return *shards_[turn_++ % shards_.size()];
+}
+
+size_t sharded_client::select(const hash_digest& key) const
+{
+    return std::hash<hash_digest>()(key) % shards_.size();
+}
+
+void sharded_client::post(shard& target,
+    std::function<void(obelisk_client&)> work)
+{
+    const auto running = &target;
+    boost::asio::post(running->service, [running, work]()
+    {
+        work(running->client);
+        running->adapter.schedule();
+    });
+}
+
+template <typename Result>
+Result sharded_client::execute(shard& target,
+    std::function<Result(obelisk_client&)> work)
+{
+    if (!started_ || target.thread.get_id() == std::this_thread::get_id())
+    {
+        const auto result = work(target.client);
+        target.adapter.schedule();
+        return result;
+    }
+
+    const auto task = std::make_shared<std::packaged_task<Result()>>(
+        std::bind(work, std::ref(target.client)));
+    auto result = task->get_future();
+    post(target, [task](obelisk_client&)
+    {
+        (*task)();
+    });
+
+    return result.get();
+}
+
+// Requests queued before start are run by the shard once started.
+bool sharded_client::start()
+{
+    if (started_)
+        return true;
+
+    for (const auto& target: shards_)
+    {
+        const auto running = target.get();
+        running->service.restart();
+        running->work.reset(new work_guard(
+            boost::asio::make_work_guard(running->service)));
+        running->adapter.start();
+        running->thread = std::thread([running]()
+        {
+            running->service.run();
+        });
+    }
+
+    started_ = true;
+    return true;
+}
+
+// Subscription ids of shards may coincide, so each is mapped to another.
+uint32_t sharded_client::add_subscription(size_t index, uint32_t subscription)
+{
+    if (subscription == obelisk_client::null_subscription)
+        return obelisk_client::null_subscription;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(subscription_mutex_);
+
+    do
+    {
+        ++last_subscription_;
+    } while (last_subscription_ == 0 ||
+        last_subscription_ == obelisk_client::null_subscription ||
+        subscriptions_.count(last_subscription_) != 0);
+
+    subscriptions_[last_subscription_] = { index, subscription };
+    return last_subscription_;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+} // namespace client
+} // namespace libbitcoin
@@ -0,0 +1,347 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/client/shared_cache.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <bitcoin/system.hpp>
+
+using namespace bc::system;
+using namespace boost::interprocess;
+
+namespace libbitcoin {
+namespace client {
+
+// The segment is shared with other processes, so atomics must not be locks.
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+    "shared cache requires lock free atomics");
+
+static constexpr uint32_t magic = 0x63686362;
+static constexpr uint32_t version = 2;
+static constexpr uint64_t alignment = 8;
+static const auto open_timeout = std::chrono::seconds(1);
+
+// Slot states, a slot is abandoned if its entry does not fit the arena.
+static constexpr uint32_t empty = 0;
+static constexpr uint32_t writing = 1;
+static constexpr uint32_t ready = 2;
+static constexpr uint32_t abandoned = 3;
+
+// Stores probe at most this many slots, so that finds, which probe no further
+// than the greatest displacement stored, are bounded when the table is full.
+static constexpr uint64_t maximum_probes = 64;
+
+// Set to magic once initialized by the creating process.
+struct shared_cache::segment
+{
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint64_t slots;
+    uint64_t arena;
+    std::atomic<uint64_t> tail;
+    std::atomic<uint64_t> entries;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> displacement;
+};
+
+// The entry fields are written before state is set ready and never change.
+struct shared_cache::slot
+{
+    std::atomic<uint32_t> state;
+    uint32_t type;
+    hash_digest hash;
+    uint64_t offset;
+    uint64_t size;
+};
+
+static uint64_t align(uint64_t value)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Block hashes are uniformly distributed, so the first bytes suffice.
+static uint64_t position(const hash_digest& hash, uint64_t slots)
+{
+    uint64_t value = 0;
+    std::memcpy(&value, hash.data(), sizeof(value));
+    return value % slots;
+}
+
+static void raise(std::atomic<uint64_t>& value, uint64_t minimum)
+{
+    auto current = value.load(std::memory_order_relaxed);
+    while (current < minimum)
+        if (value.compare_exchange_weak(current, minimum,
+            std::memory_order_relaxed))
+            return;
+}
+
+shared_cache::shared_cache(const std::string& name, size_t slots,
+    size_t arena)
+  : segment_(nullptr), slots_(nullptr), arena_(nullptr)
+{
+    try
+    {
+        if (!open(name, std::max<size_t>(slots, 1), arena))
+            segment_ = nullptr;
+    }
+    catch (const interprocess_exception&)
+    {
+        segment_ = nullptr;
+    }
+}
+
+bool shared_cache::remove(const std::string& name)
+{
+    return shared_memory_object::remove(name.c_str());
+}
+
+bool shared_cache::valid() const
+{
+    return segment_ != nullptr;
+}
+
+bool shared_cache::find(entry type, const hash_digest& block_hash,
+    data_chunk& out_data) const
+{
+    if (!valid())
+        return false;
+
+    const auto slots = segment_->slots;
+    const auto start = position(block_hash, slots);
+    const auto probes = std::min(slots,
+        segment_->displacement.load(std::memory_order_acquire) + 1);
+
+    for (uint64_t probe = 0; probe < probes; ++probe)
+    {
+        const auto& row = slots_[(start + probe) % slots];
+        const auto state = row.state.load(std::memory_order_acquire);
+
+        if (state == empty)
+            return false;
+
+        if (state == ready && row.type == static_cast<uint32_t>(type) &&
+            row.hash == block_hash)
+        {
+            const auto begin = arena_ + row.offset;
+            out_data.assign(begin, begin + row.size);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool shared_cache::store(entry type, const hash_digest& block_hash,
+    const data_chunk& data)
+{
+    if (!valid() || data.empty())
+        return false;
+
+    data_chunk existing;
+    if (find(type, block_hash, existing))
+        return true;
+
+    // The slot is claimed before the arena, so a full table wastes no space.
+    const auto slots = segment_->slots;
+    const auto start = position(block_hash, slots);
+    const auto probes = std::min(slots, maximum_probes);
+
+    for (uint64_t probe = 0; probe < probes; ++probe)
+    {
+        auto& row = slots_[(start + probe) % slots];
+        auto state = row.state.load(std::memory_order_acquire);
+
+        if (state == empty && row.state.compare_exchange_strong(state,
+            writing, std::memory_order_acquire))
+        {
+            // Finds of other processes probe this far once it is published.
+            raise(segment_->displacement, probe);
+            return fill(row, type, block_hash, data);
+        }
+
+        // Stored by another writer since the find.
+        if (state == ready && row.type == static_cast<uint32_t>(type) &&
+            row.hash == block_hash)
+            return true;
+    }
+
+    segment_->dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool shared_cache::find_header(const hash_digest& block_hash,
+    chain::header& out_header) const
+{
+    data_chunk data;
+    return find(entry::header, block_hash, data) &&
+        out_header.from_data(data) && out_header.hash() == block_hash;
+}
+
+bool shared_cache::store_header(const chain::header& header)
+{
+    return store(entry::header, header.hash(), header.to_data());
+}
+
+bool shared_cache::find_block(const hash_digest& block_hash,
+    chain::block& out_block) const
+{
+    data_chunk data;
+    return find(entry::block, block_hash, data) &&
+        out_block.from_data(data) && out_block.hash() == block_hash;
+}
+
+bool shared_cache::store_block(const chain::block& block)
+{
+    return store(entry::block, block.hash(), block.to_data());
+}
+
+size_t shared_cache::size() const
+{
+    return valid() ? segment_->entries.load(std::memory_order_relaxed) : 0;
+}
+
+size_t shared_cache::bytes() const
+{
+    if (!valid())
+        return 0;
+
+    return std::min(segment_->tail.load(std::memory_order_relaxed),
+        segment_->arena);
+}
+
+size_t shared_cache::capacity() const
+{
+    return valid() ? segment_->arena : 0;
+}
+
+size_t shared_cache::dropped() const
+{
+    return valid() ? segment_->dropped.load(std::memory_order_relaxed) : 0;
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+// The arena is reserved only if the entry fits, so a large entry that does
+// not fit leaves room for smaller ones.
+bool shared_cache::fill(slot& row, entry type, const hash_digest& block_hash,
+    const data_chunk& data)
+{
+    const auto size = align(data.size());
+    auto offset = segment_->tail.load(std::memory_order_relaxed);
+
+    do
+    {
+        if (offset + size > segment_->arena)
+        {
+            row.state.store(abandoned, std::memory_order_release);
+            segment_->dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    } while (!segment_->tail.compare_exchange_weak(offset, offset + size,
+        std::memory_order_relaxed));
+
+    // The data is published by the release of the slot.
+    std::memcpy(arena_ + offset, data.data(), data.size());
+    row.type = static_cast<uint32_t>(type);
+    row.hash = block_hash;
+    row.offset = offset;
+    row.size = data.size();
+    row.state.store(ready, std::memory_order_release);
+    segment_->entries.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool shared_cache::open(const std::string& name, size_t slots, size_t arena)
+{
+    const auto header = align(sizeof(segment));
+    auto table = align(slots * sizeof(slot));
+    auto created = true;
+    shared_memory_object memory;
+
+    try
+    {
+        shared_memory_object file(create_only, name.c_str(), read_write);
+        file.truncate(header + table + arena);
+        memory.swap(file);
+    }
+    catch (const interprocess_exception&)
+    {
+        shared_memory_object file(open_only, name.c_str(), read_write);
+        memory.swap(file);
+        created = false;
+    }
+
+    // The creator may not yet have sized the segment.
+    const auto deadline = std::chrono::steady_clock::now() + open_timeout;
+    offset_t length = 0;
+    while (memory.get_size(length) && length < offset_t(header))
+    {
+        if (std::chrono::steady_clock::now() >= deadline)
+            return false;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    mapped_region region(memory, read_write);
+    region_.swap(region);
+
+    const auto base = static_cast<uint8_t*>(region_.get_address());
+    segment_ = reinterpret_cast<segment*>(base);
+
+    // Truncation zero fills, which is the empty state of every slot.
+    if (created)
+    {
+        segment_->version = version;
+        segment_->slots = slots;
+        segment_->arena = arena;
+        segment_->magic.store(magic, std::memory_order_release);
+    }
+
+    while (segment_->magic.load(std::memory_order_acquire) != magic)
+    {
+        if (std::chrono::steady_clock::now() >= deadline)
+            return false;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // The geometry of an existing segment is that of its creator.
+    table = align(segment_->slots * sizeof(slot));
+    if (segment_->version != version || segment_->slots == 0 ||
+        header + table + segment_->arena > region_.get_size())
+        return false;
+
+    slots_ = reinterpret_cast<slot*>(base + header);
+    arena_ = base + header + table;
+    return true;
+}
+
+} // namespace client
+} // namespace libbitcoin
@@ -0,0 +1,252 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/client/subscription_pool.hpp>
+
+#include <iterator>
+#include <utility>
+
+using namespace bc::system;
+using namespace bc::system::config;
+
+namespace libbitcoin {
+namespace client {
+
+const size_t subscription_pool::default_replicas;
+const size_t subscription_pool::default_error_limit;
+
+subscription_pool::server::server(asio::service& service, int32_t retries,
+    size_t request_limit)
+  : client(retries, request_limit),
+    adapter(service, client),
+    errors(0)
+{
+}
+
+subscription_pool::subscription_pool(asio::service& service,
+    key_update_handler handler, size_t replicas, size_t error_limit,
+    size_t request_limit)
+  : service_(service),
+    handler_(handler),
+    replicas_(replicas == 0 ? 1 : replicas),
+    error_limit_(error_limit == 0 ? 1 : error_limit),
+    request_limit_(request_limit)
+{
+}
+
+bool subscription_pool::add_server(const connection_settings& settings)
+{
+    const auto name = settings.server.to_string();
+    if (servers_.find(name) != servers_.end())
+        return false;
+
+    const auto added = std::make_shared<server>(service_, settings.retries,
+        request_limit_);
+    if (!added->client.connect(settings))
+        return false;
+
+    added->adapter.start();
+    servers_[name] = added;
+
+    for (size_t replica = 0; replica < replicas_; ++replica)
+        ring_.emplace(position(sha256_hash(to_chunk(name + "/" +
+            std::to_string(replica)))), name);
+
+    rebalance();
+    return true;
+}
+
+bool subscription_pool::remove_server(const endpoint& server)
+{
+    return remove(server.to_string());
+}
+
+bool subscription_pool::subscribe_key(const hash_digest& key)
+{
+    if (keys_.find(key) != keys_.end())
+        return false;
+
+    keys_[key].clear();
+    const auto name = owner(key);
+    if (!name.empty())
+        subscribe(key, name);
+
+    return true;
+}
+
+bool subscription_pool::unsubscribe_key(const hash_digest& key)
+{
+    const auto it = keys_.find(key);
+    if (it == keys_.end())
+        return false;
+
+    if (!it->second.empty())
+        unsubscribe(key, it->second);
+
+    keys_.erase(it);
+    return true;
+}
+
+size_t subscription_pool::servers() const
+{
+    return servers_.size();
+}
+
+size_t subscription_pool::keys() const
+{
+    return keys_.size();
+}
+
+size_t subscription_pool::keys(const endpoint& server) const
+{
+    const auto it = servers_.find(server.to_string());
+    return it == servers_.end() ? 0 : it->second->subscriptions.size();
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+uint64_t subscription_pool::position(const hash_digest& key)
+{
+    return from_little_endian_unsafe<uint64_t>(key.begin());
+}
+
+std::string subscription_pool::owner(const hash_digest& key) const
+{
+    if (ring_.empty())
+        return {};
+
+    const auto node = ring_.lower_bound(position(key));
+    return node == ring_.end() ? ring_.begin()->second : node->second;
+}
+
+// The server may be removed from its own handler, so is released later.
+bool subscription_pool::remove(const std::string& name)
+{
+    const auto it = servers_.find(name);
+    if (it == servers_.end())
+        return false;
+
+    const auto removed = it->second;
+    servers_.erase(it);
+
+    for (auto node = ring_.begin(); node != ring_.end();)
+        node = node->second == name ? ring_.erase(node) : std::next(node);
+
+    for (const auto& subscription: removed->subscriptions)
+        keys_[subscription.first].clear();
+
+    removed->subscriptions.clear();
+    removed->adapter.stop();
+    boost::asio::post(service_, [removed]() {});
+
+    rebalance();
+    return true;
+}
+
+void subscription_pool::rebalance()
+{
+    for (auto& key: keys_)
+    {
+        const auto name = owner(key.first);
+        if (name == key.second)
+            continue;
+
+        if (!key.second.empty())
+            unsubscribe(key.first, key.second);
+
+        if (!name.empty())
+            subscribe(key.first, name);
+    }
+}
+
+// The client removes a failed subscription before notifying its error.
+void subscription_pool::recover(const hash_digest& key,
+    const std::string& name)
+{
+    auto& failed = *servers_[name];
+    failed.subscriptions.erase(key);
+    keys_[key].clear();
+
+    if (++failed.errors >= error_limit_)
+    {
+        remove(name);
+        return;
+    }
+
+    const auto next = owner(key);
+    if (!next.empty())
+        subscribe(key, next);
+}
+
+// Notifications of a key that has since moved from the server are dropped.
+// Acknowledgements (null transaction hash) do not show the server to be well.
+void subscription_pool::handle_update(const code& ec, const hash_digest& key,
+    const std::string& name, uint16_t sequence, size_t height,
+    const hash_digest& tx_hash)
+{
+    const auto it = keys_.find(key);
+    if (it == keys_.end() || it->second != name)
+        return;
+
+    if (ec)
+        recover(key, name);
+    else if (tx_hash != null_hash)
+        servers_[name]->errors = 0;
+
+    handler_(ec, key, sequence, height, tx_hash);
+}
+
+void subscription_pool::subscribe(const hash_digest& key,
+    const std::string& name)
+{
+    auto& target = *servers_[name];
+    const auto notify = [this, key, name](const code& ec, uint16_t sequence,
+        size_t height, const hash_digest& tx_hash)
+    {
+        handle_update(ec, key, name, sequence, height, tx_hash);
+    };
+
+    keys_[key] = name;
+    const auto subscription = target.client.subscribe_key(notify, key);
+
+    // A failure notified before returning has already recovered the key.
+    const auto it = keys_.find(key);
+    if (subscription != obelisk_client::null_subscription &&
+        it != keys_.end() && it->second == name)
+        target.subscriptions[key] = subscription;
+
+    target.adapter.schedule();
+}
+
+void subscription_pool::unsubscribe(const hash_digest& key,
+    const std::string& name)
+{
+    auto& target = *servers_[name];
+    const auto it = target.subscriptions.find(key);
+    if (it == target.subscriptions.end())
+        return;
+
+    target.client.unsubscribe_key([](const code&) {}, it->second);
+    target.subscriptions.erase(it);
+    target.adapter.schedule();
+    keys_[key].clear();
+}
+
+} // namespace client
+} // namespace libbitcoin
@@ -0,0 +1,332 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/client/time_index.hpp>
+
+#include <algorithm>
+#include <set>
+
+using namespace bc::system;
+using namespace bc::system::chain;
+
+namespace libbitcoin {
+namespace client {
+
+static constexpr size_t unknown = max_size_t;
+
+const size_t time_index::median_time_past_interval;
+
+// The answer is in [low, high), where high is one past the top if not found.
+struct time_index::search
+{
+    height_handler handler;
+    uint32_t time;
+    size_t top;
+    size_t low;
+    size_t high;
+    std::vector<size_t> probes;
+    size_t pending;
+    code error;
+    bool complete;
+};
+
+static size_t window_start(size_t height)
+{
+    const auto preceding = time_index::median_time_past_interval - 1;
+    return height < preceding ? 0 : height - preceding;
+}
+
+time_index::time_index(obelisk_client& client, size_t batch_size)
+  : time_index(
+        [&client](obelisk_client::block_header_handler handler,
+            uint32_t height)
+        {
+            client.blockchain_fetch_block_header(handler, height);
+        },
+        [&client](obelisk_client::height_handler handler)
+        {
+            client.blockchain_fetch_last_height(handler);
+        }, batch_size)
+{
+}
+
+// Each probe requires the headers of its median time past window.
+time_index::time_index(header_fetcher fetch_header, top_fetcher fetch_top,
+    size_t batch_size)
+  : fetch_header_(fetch_header),
+    fetch_top_(fetch_top),
+    probes_(std::max(batch_size / median_time_past_interval, size_t(1))),
+    top_(unknown),
+    cached_(0)
+{
+}
+
+void time_index::find_height(height_handler handler, uint32_t time)
+{
+    const auto query = std::make_shared<search>();
+    query->handler = handler;
+    query->time = time;
+    query->pending = 0;
+    query->complete = false;
+    start(query);
+}
+
+bool time_index::median_time_past(size_t height, uint32_t& out_time) const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+
+    for (auto index = window_start(height); index <= height; ++index)
+        if (!is_cached(index))
+            return false;
+
+    out_time = median(height);
+    return true;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// Timestamps above a replaced block are no longer valid.
+void time_index::handle_block(size_t height, const block& block)
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    for (auto index = height + 1; index < timestamps_.size(); ++index)
+    {
+        if (timestamps_[index] != 0)
+        {
+            timestamps_[index] = 0;
+            --cached_;
+        }
+    }
+
+    if (timestamps_.size() <= height)
+        timestamps_.resize(height + 1, 0);
+
+    if (timestamps_[height] == 0)
+        ++cached_;
+
+    timestamps_[height] = block.header().timestamp();
+    top_ = height;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void time_index::store(size_t height, uint32_t timestamp)
+{
+    if (timestamp == 0)
+        return;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    if (timestamps_.size() <= height)
+        timestamps_.resize(height + 1, 0);
+
+    if (timestamps_[height] == 0)
+        ++cached_;
+
+    timestamps_[height] = timestamp;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+size_t time_index::size() const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+    return cached_;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+bool time_index::is_cached(size_t height) const
+{
+    return height < timestamps_.size() && timestamps_[height] != 0;
+}
+
+uint32_t time_index::median(size_t height) const
+{
+    std::vector<uint32_t> window(timestamps_.begin() + window_start(height),
+        timestamps_.begin() + height + 1);
+
+    const auto middle = window.begin() + window.size() / 2;
+    std::nth_element(window.begin(), middle, window.end());
+    return *middle;
+}
+
+void time_index::start(search_ptr query)
+{
+    size_t top;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    mutex_.lock_shared();
+    top = top_;
+    mutex_.unlock_shared();
+    ///////////////////////////////////////////////////////////////////////////
+
+    if (top != unknown)
+    {
+        query->top = top;
+        query->low = 0;
+        query->high = top + 1;
+        round(query);
+        return;
+    }
+
+    fetch_top_([this, query](const code& ec, size_t height)
+    {
+        if (ec)
+        {
+            complete(query, ec, 0);
+            return;
+        }
+
+        query->top = height;
+        query->low = 0;
+        query->high = height + 1;
+        round(query);
+    });
+}
+
+// Probes divide the range evenly, and the windows of all probes are fetched
+// together. The final rounds probe every remaining height.
+void time_index::round(search_ptr query)
+{
+    if (query->low >= query->high)
+    {
+        if (query->low > query->top)
+            complete(query, error::not_found, 0);
+        else
+            complete(query, error::success, query->low);
+
+        return;
+    }
+
+    const auto span = query->high - query->low;
+    const auto count = std::min(probes_, span);
+    query->probes.clear();
+
+    for (size_t probe = 1; probe <= count; ++probe)
+        query->probes.push_back(query->low + span * probe / (count + 1));
+
+    std::set<size_t> missing;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    mutex_.lock_shared();
+
+    for (const auto probe: query->probes)
+        for (auto height = window_start(probe); height <= probe; ++height)
+            if (!is_cached(height))
+                missing.insert(height);
+
+    mutex_.unlock_shared();
+    ///////////////////////////////////////////////////////////////////////////
+
+    if (missing.empty())
+    {
+        evaluate(query);
+        round(query);
+        return;
+    }
+
+    query->pending = missing.size();
+    query->error = error::success;
+
+    for (const auto height: missing)
+    {
+        fetch_header_([this, query, height](const code& ec,
+            const header& header)
+        {
+            if (ec)
+                query->error = ec;
+            else
+                store(height, header.timestamp());
+
+            if (--query->pending != 0)
+                return;
+
+            if (query->error)
+            {
+                complete(query, query->error, 0);
+                return;
+            }
+
+            evaluate(query);
+            round(query);
+        }, static_cast<uint32_t>(height));
+    }
+}
+
+// The range is narrowed to follow the last probe not after the time and to
+// end at the first probe after it. If a window was invalidated by a block
+// since it was fetched the range is unchanged, and the next round refetches.
+void time_index::evaluate(search_ptr query)
+{
+    std::vector<uint32_t> times;
+
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    mutex_.lock_shared();
+
+    for (const auto probe: query->probes)
+    {
+        for (auto height = window_start(probe); height <= probe; ++height)
+        {
+            if (!is_cached(height))
+            {
+                mutex_.unlock_shared();
+                return;
+            }
+        }
+
+        times.push_back(median(probe));
+    }
+
+    mutex_.unlock_shared();
+    ///////////////////////////////////////////////////////////////////////////
+
+    for (size_t index = 0; index < times.size(); ++index)
+    {
+        if (times[index] > query->time)
+        {
+            query->high = query->probes[index];
+            return;
+        }
+
+        query->low = query->probes[index] + 1;
+    }
+}
+
+void time_index::complete(search_ptr query, const code& ec, size_t height)
+{
+    if (query->complete)
+        return;
+
+    query->complete = true;
+    query->handler(ec, height);
+}
+
+} // namespace client
+} // namespace libbitcoin
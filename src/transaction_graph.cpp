@@ -0,0 +1,270 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/client/transaction_graph.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+
+using namespace bc::system;
+using namespace bc::system::chain;
+
+namespace libbitcoin {
+namespace client {
+
+// A task without an output index is a transaction fetch.
+static constexpr uint32_t no_output = max_uint32;
+
+struct transaction_graph::walk_state
+{
+    typedef std::pair<uint32_t, uint32_t> pair;
+
+    graph_handler handler;
+    direction walk_direction;
+    size_t depth;
+    std::unordered_map<hash_digest, uint32_t> visited;
+    hash_list nodes;
+    std::vector<uint32_t> depths;
+    std::vector<bool> expanded;
+    std::vector<pair> edges;
+    std::deque<pair> tasks;
+    size_t in_flight;
+    bool pumping;
+    bool complete;
+
+    // Add the node if not visited, queueing its fetch if it is to be expanded.
+    // Responses arrive out of order, so a node may be found on a shorter path
+    // after a longer one. It is then expanded again from its lower depth,
+    // unless its pending expansion is yet to read the depth.
+    uint32_t add(const hash_digest& hash, uint32_t node_depth)
+    {
+        const auto it = visited.emplace(hash,
+            static_cast<uint32_t>(nodes.size()));
+        const auto index = it.first->second;
+
+        if (it.second)
+        {
+            nodes.push_back(hash);
+            depths.push_back(node_depth);
+            expanded.push_back(false);
+
+            if (node_depth < depth)
+                tasks.emplace_back(index, no_output);
+        }
+        else if (node_depth < depths[index])
+        {
+            const auto pending = depths[index] < depth && !expanded[index];
+            depths[index] = node_depth;
+
+            if (node_depth < depth && !pending)
+                tasks.emplace_back(index, no_output);
+        }
+
+        return index;
+    }
+};
+
+transaction_graph::transaction_graph(obelisk_client& client,
+    size_t maximum_in_flight)
+  : transaction_graph(
+        [&client](obelisk_client::transaction_handler handler,
+            const hash_digest& tx_hash)
+        {
+            client.transaction_pool_fetch_transaction2(handler, tx_hash);
+        },
+        [&client](obelisk_client::spend_handler handler,
+            const output_point& outpoint)
+        {
+            client.blockchain_fetch_spend(handler, outpoint);
+        }, maximum_in_flight)
+{
+}
+
+transaction_graph::transaction_graph(transaction_fetcher fetch_transaction,
+    spend_fetcher fetch_spend, size_t maximum_in_flight)
+  : fetch_transaction_(fetch_transaction),
+    fetch_spend_(fetch_spend),
+    maximum_in_flight_(std::max(maximum_in_flight, size_t(1)))
+{
+}
+
+// The root is fetched even at depth zero, to report its existence.
+void transaction_graph::walk(graph_handler handler, const hash_digest& root,
+    direction walk_direction, size_t depth)
+{
+    const auto walk = std::make_shared<walk_state>();
+    walk->handler = handler;
+    walk->walk_direction = walk_direction;
+    walk->depth = depth;
+    walk->in_flight = 0;
+    walk->pumping = false;
+    walk->complete = false;
+
+    walk->add(root, 0);
+    if (walk->tasks.empty())
+        walk->tasks.emplace_back(0, no_output);
+
+    pump(walk);
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+// Fetches may complete immediately, so this does not recurse but continues
+// the loop of the outermost invocation, which detects completion.
+void transaction_graph::pump(walk_ptr walk)
+{
+    if (walk->pumping)
+        return;
+
+    walk->pumping = true;
+    while (!walk->complete && walk->in_flight < maximum_in_flight_ &&
+        !walk->tasks.empty())
+    {
+        const auto task = walk->tasks.front();
+        walk->tasks.pop_front();
+        ++walk->in_flight;
+
+        // Copied, as nodes may be added if the fetch completes immediately.
+        const auto node = task.first;
+        const auto hash = walk->nodes[node];
+
+        if (task.second == no_output)
+        {
+            fetch_transaction_([this, walk, node](const code& ec,
+                const transaction& tx)
+            {
+                handle_transaction(walk, node, ec, tx);
+            }, hash);
+        }
+        else
+        {
+            fetch_spend_([this, walk, node](const code& ec,
+                const input_point& spend)
+            {
+                handle_spend(walk, node, ec, spend);
+            }, { hash, task.second });
+        }
+    }
+
+    walk->pumping = false;
+
+    if (!walk->complete && walk->in_flight == 0 && walk->tasks.empty())
+        complete(walk, error::success);
+}
+
+void transaction_graph::handle_transaction(walk_ptr walk, uint32_t node,
+    const code& ec, const transaction& tx)
+{
+    --walk->in_flight;
+
+    if (walk->complete)
+        return;
+
+    if (ec)
+    {
+        complete(walk, ec);
+        return;
+    }
+
+    const auto next = walk->depths[node] + 1;
+    if (next > walk->depth)
+    {
+        pump(walk);
+        return;
+    }
+
+    walk->expanded[node] = true;
+
+    if (walk->walk_direction == direction::ancestors)
+    {
+        if (!tx.is_coinbase())
+            for (const auto& input: tx.inputs())
+                walk->edges.emplace_back(node,
+                    walk->add(input.previous_output().hash(), next));
+    }
+    else
+    {
+        const auto outputs = static_cast<uint32_t>(tx.outputs().size());
+        for (uint32_t index = 0; index < outputs; ++index)
+            walk->tasks.emplace_back(node, index);
+    }
+
+    pump(walk);
+}
+
+// An unspent output is not an error.
+void transaction_graph::handle_spend(walk_ptr walk, uint32_t node,
+    const code& ec, const input_point& spend)
+{
+    --walk->in_flight;
+
+    if (walk->complete)
+        return;
+
+    if (ec && ec != error::not_found)
+    {
+        complete(walk, ec);
+        return;
+    }
+
+    if (!ec)
+        walk->edges.emplace_back(node,
+            walk->add(spend.hash(), walk->depths[node] + 1));
+
+    pump(walk);
+}
+
+void transaction_graph::complete(walk_ptr walk, const code& ec)
+{
+    walk->complete = true;
+    walk->tasks.clear();
+
+    if (ec)
+    {
+        walk->handler(ec, {});
+        return;
+    }
+
+    // Multiple inputs or outputs may connect the same pair of transactions.
+    auto& edges = walk->edges;
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    graph result;
+    result.nodes = std::move(walk->nodes);
+    result.depths = std::move(walk->depths);
+    result.offsets.assign(result.nodes.size() + 1, 0);
+    result.edges.reserve(edges.size());
+
+    for (const auto& edge: edges)
+    {
+        ++result.offsets[edge.first + 1];
+        result.edges.push_back(edge.second);
+    }
+
+    for (size_t node = 1; node < result.offsets.size(); ++node)
+        result.offsets[node] += result.offsets[node - 1];
+
+    walk->handler(error::success, result);
+}
+
+} // namespace client
+} // namespace libbitcoin
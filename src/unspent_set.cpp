@@ -0,0 +1,294 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/client/unspent_set.hpp>
+
+#include <algorithm>
+
+#include <bitcoin/client/coin_selection.hpp>
+
+using namespace bc::system;
+using namespace bc::system::chain;
+using namespace bc::system::wallet;
+
+namespace libbitcoin {
+namespace client {
+
+const size_t unspent_set::unconfirmed;
+
+unspent_set::unspent_set(size_t applied_limit)
+  : applied_limit_(std::max(applied_limit, size_t(1))),
+    balance_(0)
+{
+}
+
+void unspent_set::load(const hash_digest& key, const history::list& rows)
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    keys_.insert(key);
+
+    // Remove from the back so that swapped entries are already visited.
+    for (auto position = entries_.size(); position > 0; --position)
+        if (entries_[position - 1].key == key)
+            remove(index_.find(unspent_.points[position - 1]));
+
+    for (const auto& row: rows)
+        if (row.spend.is_null() && !row.output.is_null())
+            add(row.output, row.value, key, row.output_height);
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+bool unspent_set::unload(const hash_digest& key)
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    if (keys_.erase(key) == 0)
+        return false;
+
+    for (auto position = entries_.size(); position > 0; --position)
+        if (entries_[position - 1].key == key)
+            remove(index_.find(unspent_.points[position - 1]));
+
+    return true;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void unspent_set::handle_transaction(const transaction& tx)
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+    apply(tx, unconfirmed);
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void unspent_set::handle_block(size_t height, const block& block)
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    for (const auto& tx: block.transactions())
+        apply(tx, height);
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+bool unspent_set::handle_update(const hash_digest& key,
+    const hash_digest& tx_hash) const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+
+    // A notification for an unwatched key or the subscription ack is moot.
+    if (tx_hash == null_hash || keys_.find(key) == keys_.end())
+        return true;
+
+    return applied_.find(tx_hash) != applied_.end();
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void unspent_set::select(points_value& out, uint64_t satoshi,
+    select_outputs::algorithm algorithm) const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+    select_outputs::select(out, unspent_, satoshi, algorithm);
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+bool unspent_set::select(points_value& out, uint64_t satoshi,
+    uint64_t cost_of_change, const asio::milliseconds& budget) const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+    return coin_selection(unspent_, descending_, balance_).select(out,
+        satoshi, cost_of_change, budget);
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+points_value unspent_set::unspent() const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+    return unspent_;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+bool unspent_set::height(const output_point& point, size_t& out_height) const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+
+    const auto it = index_.find(point);
+    if (it == index_.end())
+        return false;
+
+    out_height = entries_[it->second].height;
+    return true;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+uint64_t unspent_set::balance() const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+    return balance_;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+size_t unspent_set::size() const
+{
+    // Critical Section.
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+    return unspent_.points.size();
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+// This is the key used by subscribe_key and blockchain_fetch_history4.
+hash_digest unspent_set::to_key(const output& output)
+{
+    return sha256_hash(output.script().to_data(false));
+}
+
+// Spent outputs are removed and outputs paying watched keys added, or their
+// height updated if already present. Returns true if the set was affected.
+bool unspent_set::apply(const transaction& tx, size_t height)
+{
+    auto applied = false;
+    const auto tx_hash = tx.hash();
+
+    if (!tx.is_coinbase())
+    {
+        for (const auto& input: tx.inputs())
+        {
+            const auto it = index_.find(input.previous_output());
+            if (it != index_.end())
+            {
+                remove(it);
+                applied = true;
+            }
+        }
+    }
+
+    const auto& outputs = tx.outputs();
+    for (uint32_t index = 0; index < outputs.size(); ++index)
+    {
+        const auto key = to_key(outputs[index]);
+        if (keys_.find(key) != keys_.end())
+        {
+            add({ tx_hash, index }, outputs[index].value(), key, height);
+            applied = true;
+        }
+    }
+
+    if (applied)
+        remember(tx_hash);
+
+    return applied;
+}
+
+void unspent_set::add(const output_point& point, uint64_t value,
+    const hash_digest& key, size_t height)
+{
+    const auto it = index_.find(point);
+    if (it != index_.end())
+    {
+        entries_[it->second].height = height;
+        return;
+    }
+
+    const auto position = static_cast<uint32_t>(unspent_.points.size());
+    index_.emplace(point, position);
+    unspent_.points.emplace_back(point, value);
+    entries_.push_back({ key, height });
+    balance_ += value;
+
+    if (value != 0)
+        descending_.insert(locate(position), position);
+}
+
+// The last output is moved into the vacated position.
+void unspent_set::remove(point_index::iterator it)
+{
+    const auto position = static_cast<uint32_t>(it->second);
+    const auto last = static_cast<uint32_t>(unspent_.points.size() - 1);
+    balance_ -= unspent_.points[position].value();
+    index_.erase(it);
+
+    if (unspent_.points[position].value() != 0)
+        descending_.erase(locate(position));
+
+    if (position != last)
+    {
+        // The moved output keeps its place in the value order.
+        if (unspent_.points[last].value() != 0)
+            *locate(last) = position;
+
+        unspent_.points[position] = unspent_.points[last];
+        entries_[position] = entries_[last];
+        index_[unspent_.points[position]] = position;
+    }
+
+    unspent_.points.pop_back();
+    entries_.pop_back();
+}
+
+void unspent_set::remember(const hash_digest& tx_hash)
+{
+    if (!applied_.insert(tx_hash).second)
+        return;
+
+    applied_order_.push_back(tx_hash);
+    if (applied_order_.size() > applied_limit_)
+    {
+        applied_.erase(applied_order_.front());
+        applied_order_.pop_front();
+    }
+}
+
+// Outputs of equal value are unordered, so an indexed position is found
+// within their range, otherwise this is the end of the range.
+coin_selection::positions::iterator unspent_set::locate(uint32_t position)
+{
+    const auto range = std::equal_range(descending_.begin(),
+        descending_.end(), position, [this](uint32_t left, uint32_t right)
+        {
+            return unspent_.points[left].value() >
+                unspent_.points[right].value();
+        });
+
+    return std::find(range.first, range.second, position);
+}
+
+} // namespace client
+} // namespace libbitcoin
@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <tuple>
+#include <boost/asio/use_future.hpp>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test_suite.hpp>
+#include <bitcoin/client.hpp>
+
+using namespace bc::client;
+using namespace bc::system;
+
+BOOST_AUTO_TEST_SUITE(offline)
+
+BOOST_AUTO_TEST_CASE(asio_client__async_fetch_last_height__no_response__channel_timeout)
+{
+    asio::service service;
+    obelisk_client client(0);
+    asio_client adapter(service, client, 10);
+    adapter.start();
+
+    code result;
+    adapter.async_fetch_last_height([&](const code& ec, size_t)
+    {
+        result = ec;
+        adapter.stop();
+    });
+
+    service.run();
+    BOOST_REQUIRE_EQUAL(result, error::channel_timeout);
+    BOOST_REQUIRE(!client.requests_outstanding());
+}
+
+BOOST_AUTO_TEST_CASE(asio_client__async_fetch_last_height__use_future__channel_timeout)
+{
+    asio::service service;
+    obelisk_client client(0);
+    asio_client adapter(service, client, 10);
+    adapter.start();
+
+    auto height = adapter.async_fetch_last_height(boost::asio::use_future);
+    while (height.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready)
+        service.run_one();
+
+    adapter.stop();
+    BOOST_REQUIRE_EQUAL(std::get<0>(height.get()), error::channel_timeout);
+    BOOST_REQUIRE(!client.requests_outstanding());
+}
+
+BOOST_AUTO_TEST_CASE(asio_client__async_fetch_last_height__timeouts__ids_released)
+{
+    asio::service service;
+    obelisk_client client(0, 4);
+    asio_client adapter(service, client, 10);
+    adapter.start();
+
+    // Without release the limit of four ids would fail the later fetches.
+    size_t completed = 0;
+    std::function<void(const code&, size_t)> on_height =
+        [&](const code& ec, size_t)
+        {
+            BOOST_REQUIRE_EQUAL(ec, error::channel_timeout);
+            if (++completed < 8)
+                adapter.async_fetch_last_height(on_height);
+            else
+                adapter.stop();
+        };
+
+    adapter.async_fetch_last_height(on_height);
+    service.run();
+    BOOST_REQUIRE_EQUAL(completed, 8u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,197 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdint>
+#include <vector>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test_suite.hpp>
+#include <bitcoin/client.hpp>
+
+using namespace bc::client;
+using namespace bc::system;
+
+static data_chunk make_response(const code& ec)
+{
+    return build_chunk(
+    {
+        to_little_endian(static_cast<uint32_t>(ec.value()))
+    });
+}
+
+static data_chunk make_response(const chain::block& block)
+{
+    return build_chunk({ make_response(error::success), block.to_data() });
+}
+
+// Blocks are distinguished by the locktime of their single transaction.
+static chain::block make_block(uint32_t locktime)
+{
+    const chain::transaction::list txs{ { 1, locktime, {}, {} } };
+    const chain::block unrooted{ {}, txs };
+    return { { 1, null_hash, unrooted.generate_merkle_root(), 0, 0, 0 }, txs };
+}
+
+static void deliver_all(block_decoder& decoder)
+{
+    while (decoder.pending() != 0)
+        decoder.deliver();
+}
+
+BOOST_AUTO_TEST_SUITE(offline)
+
+BOOST_AUTO_TEST_CASE(block_decoder__deliver__reverse_responses__request_order)
+{
+    block_decoder decoder(4);
+    std::vector<size_t> order;
+    std::vector<uint64_t> tickets;
+
+    for (uint32_t request = 0; request < 16; ++request)
+        tickets.push_back(decoder.reserve([&order, request](const code& ec,
+            const chain::block& block)
+        {
+            BOOST_REQUIRE(!ec);
+            BOOST_REQUIRE(block.hash() == make_block(request).hash());
+            order.push_back(request);
+        }));
+
+    for (uint32_t request = 16; request > 0; --request)
+        decoder.decode(tickets[request - 1],
+            make_response(make_block(request - 1)));
+
+    deliver_all(decoder);
+    BOOST_REQUIRE_EQUAL(order.size(), 16u);
+    for (size_t request = 0; request < order.size(); ++request)
+        BOOST_REQUIRE_EQUAL(order[request], request);
+}
+
+BOOST_AUTO_TEST_CASE(block_decoder__deliver__incomplete_first__none)
+{
+    block_decoder decoder(2);
+    const auto first = decoder.reserve([](const code&, const chain::block&) {});
+    const auto second = decoder.reserve([](const code&, const chain::block&) {});
+
+    decoder.fail(second, error::not_found);
+    BOOST_REQUIRE_EQUAL(decoder.deliver(), 0u);
+    BOOST_REQUIRE_EQUAL(decoder.pending(), 2u);
+
+    decoder.fail(first, error::not_found);
+    BOOST_REQUIRE_EQUAL(decoder.deliver(), 2u);
+    BOOST_REQUIRE_EQUAL(decoder.pending(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(block_decoder__decode__error_response__error)
+{
+    block_decoder decoder(1);
+    code result;
+    const auto ticket = decoder.reserve([&result](const code& ec,
+        const chain::block&)
+    {
+        result = ec;
+    });
+
+    decoder.decode(ticket, make_response(error::not_found));
+    deliver_all(decoder);
+    BOOST_REQUIRE(result == error::not_found);
+}
+
+BOOST_AUTO_TEST_CASE(block_decoder__decode__verified_merkle_root__success)
+{
+    block_decoder decoder(2, true);
+    code result = error::operation_failed;
+    const auto ticket = decoder.reserve([&result](const code& ec,
+        const chain::block&)
+    {
+        result = ec;
+    });
+
+    decoder.decode(ticket, make_response(make_block(1)));
+    deliver_all(decoder);
+    BOOST_REQUIRE(!result);
+}
+
+BOOST_AUTO_TEST_CASE(block_decoder__decode__tampered_transaction__merkle_mismatch)
+{
+    const auto block = make_block(1);
+    const chain::block tampered{ block.header(), { { 1, 2, {}, {} } } };
+
+    block_decoder decoder(2, true);
+    code result;
+    const auto ticket = decoder.reserve([&result](const code& ec,
+        const chain::block&)
+    {
+        result = ec;
+    });
+
+    decoder.decode(ticket, make_response(tampered));
+    deliver_all(decoder);
+    BOOST_REQUIRE(result == error::merkle_mismatch);
+}
+
+BOOST_AUTO_TEST_CASE(block_decoder__decode__tampered_transaction_unverified__success)
+{
+    const auto block = make_block(1);
+    const chain::block tampered{ block.header(), { { 1, 2, {}, {} } } };
+
+    block_decoder decoder(2);
+    code result = error::operation_failed;
+    const auto ticket = decoder.reserve([&result](const code& ec,
+        const chain::block&)
+    {
+        result = ec;
+    });
+
+    decoder.decode(ticket, make_response(tampered));
+    deliver_all(decoder);
+    BOOST_REQUIRE(!result);
+}
+
+BOOST_AUTO_TEST_CASE(block_decoder__bytes__delivered__released)
+{
+    block_decoder decoder(1);
+    const auto first = decoder.reserve([](const code&, const chain::block&) {});
+    const auto second = decoder.reserve([](const code&, const chain::block&) {});
+
+    const auto response = make_response(make_block(2));
+    decoder.decode(second, data_chunk(response));
+    BOOST_REQUIRE_EQUAL(decoder.bytes(), response.size());
+
+    decoder.decode(first, make_response(make_block(1)));
+    deliver_all(decoder);
+    BOOST_REQUIRE_EQUAL(decoder.bytes(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(block_decoder__clear__undecoded__error)
+{
+    block_decoder decoder(1);
+    std::vector<code> results;
+    const auto handler = [&results](const code& ec, const chain::block&)
+    {
+        results.push_back(ec);
+    };
+
+    decoder.reserve(handler);
+    decoder.fail(decoder.reserve(handler), error::not_found);
+    decoder.clear(error::channel_timeout);
+
+    BOOST_REQUIRE_EQUAL(decoder.pending(), 0u);
+    BOOST_REQUIRE_EQUAL(results.size(), 2u);
+    BOOST_REQUIRE(results[0] == error::channel_timeout);
+    BOOST_REQUIRE(results[1] == error::not_found);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
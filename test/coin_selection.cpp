@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test_suite.hpp>
+#include <bitcoin/client.hpp>
+
+using namespace bc::client;
+using namespace bc::system;
+
+static chain::points_value make_unspent(const std::vector<uint64_t>& values)
+{
+    chain::points_value unspent;
+    uint32_t index = 0;
+    for (const auto value: values)
+        unspent.points.emplace_back(chain::point{ null_hash, index++ }, value);
+
+    return unspent;
+}
+
+static std::chrono::steady_clock::time_point later()
+{
+    return std::chrono::steady_clock::now() + std::chrono::seconds(10);
+}
+
+BOOST_AUTO_TEST_SUITE(offline)
+
+BOOST_AUTO_TEST_CASE(coin_selection__branch_and_bound__exact__found)
+{
+    const auto unspent = make_unspent({ 1, 2, 3, 4, 5, 30, 50 });
+    const coin_selection selection(unspent);
+
+    chain::points_value out;
+    BOOST_REQUIRE(selection.branch_and_bound(out, 39, 0, later()));
+    BOOST_REQUIRE_EQUAL(out.value(), 39u);
+}
+
+BOOST_AUTO_TEST_CASE(coin_selection__branch_and_bound__no_match__false)
+{
+    const auto unspent = make_unspent({ 10, 20, 40 });
+    const coin_selection selection(unspent);
+
+    chain::points_value out;
+    BOOST_REQUIRE(!selection.branch_and_bound(out, 25, 4, later()));
+    BOOST_REQUIRE(selection.branch_and_bound(out, 25, 5, later()));
+    BOOST_REQUIRE_EQUAL(out.value(), 30u);
+}
+
+BOOST_AUTO_TEST_CASE(coin_selection__knapsack__lowest_larger__selected)
+{
+    const auto unspent = make_unspent({ 1, 2, 100, 1000 });
+    const coin_selection selection(unspent);
+
+    chain::points_value out;
+    BOOST_REQUIRE(selection.knapsack(out, 50, later()));
+    BOOST_REQUIRE_EQUAL(out.points.size(), 1u);
+    BOOST_REQUIRE_EQUAL(out.value(), 100u);
+}
+
+BOOST_AUTO_TEST_CASE(coin_selection__select__large_set__sufficient)
+{
+    std::vector<uint64_t> values;
+    for (uint64_t value = 1; value <= 100000; ++value)
+        values.push_back(value * 7919 % 100003 + 1);
+
+    const auto unspent = make_unspent(values);
+    const coin_selection selection(unspent);
+
+    chain::points_value out;
+    BOOST_REQUIRE(selection.select(out, 1234567, 10,
+        asio::milliseconds(500)));
+    BOOST_REQUIRE_GE(out.value(), 1234567u);
+    BOOST_REQUIRE(!selection.select(out, selection.value() + 1, 0,
+        asio::milliseconds(500)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdint>
+#include <vector>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test_suite.hpp>
+#include <bitcoin/client.hpp>
+
+using namespace bc::client;
+using namespace bc::system;
+
+// Blocks are distinguished by nonce and transactions by locktime.
+static chain::transaction make_tx(uint32_t locktime)
+{
+    return { 1, locktime, {}, {} };
+}
+
+static chain::block make_block(const chain::block& parent, uint32_t nonce,
+    const chain::transaction::list& txs)
+{
+    return { { 1, parent.hash(), null_hash, 0, 0, nonce }, txs };
+}
+
+BOOST_AUTO_TEST_SUITE(offline)
+
+BOOST_AUTO_TEST_CASE(confirmation_tracker__handle_block__depths__reported_once)
+{
+    confirmation_tracker tracker;
+    const auto tx = make_tx(42);
+    std::vector<size_t> reported;
+
+    tracker.track(tx.hash(), { 1, 3 }, [&](const code& ec, size_t height,
+        size_t depth)
+    {
+        BOOST_REQUIRE(!ec);
+        BOOST_REQUIRE_EQUAL(height, 11u);
+        reported.push_back(depth);
+    });
+
+    const chain::block genesis;
+    const auto block10 = make_block(genesis, 10, {});
+    const auto block11 = make_block(block10, 11, { tx });
+    const auto block12 = make_block(block11, 12, {});
+    const auto block13 = make_block(block12, 13, {});
+
+    tracker.handle_block(10, block10);
+    BOOST_REQUIRE(reported.empty());
+    tracker.handle_block(11, block11);
+    BOOST_REQUIRE_EQUAL(reported.size(), 1u);
+    tracker.handle_block(12, block12);
+    BOOST_REQUIRE_EQUAL(reported.size(), 1u);
+    tracker.handle_block(13, block13);
+    BOOST_REQUIRE_EQUAL(reported.size(), 2u);
+    BOOST_REQUIRE_EQUAL(reported[0], 1u);
+    BOOST_REQUIRE_EQUAL(reported[1], 3u);
+    BOOST_REQUIRE_EQUAL(tracker.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(confirmation_tracker__handle_block__reorganization__rolled_back)
+{
+    confirmation_tracker tracker;
+    const auto tx = make_tx(42);
+    std::vector<size_t> reported;
+
+    tracker.track(tx.hash(), { 1, 2 }, [&](const code&, size_t,
+        size_t depth)
+    {
+        reported.push_back(depth);
+    });
+
+    const chain::block genesis;
+    const auto block10 = make_block(genesis, 10, {});
+    const auto block11 = make_block(block10, 11, { tx });
+    const auto other11 = make_block(block10, 111, {});
+    const auto other12 = make_block(other11, 112, { tx });
+
+    tracker.handle_block(10, block10);
+    tracker.handle_block(11, block11);
+    BOOST_REQUIRE_EQUAL(reported.size(), 1u);
+
+    // Block 11 is replaced by a branch that confirms the tx at height 12.
+    tracker.handle_block(11, other11);
+    BOOST_REQUIRE_EQUAL(reported.size(), 2u);
+    BOOST_REQUIRE_EQUAL(reported[1], 0u);
+
+    tracker.handle_block(12, other12);
+    BOOST_REQUIRE_EQUAL(reported.size(), 3u);
+    BOOST_REQUIRE_EQUAL(reported[2], 1u);
+    BOOST_REQUIRE_EQUAL(tracker.size(), 1u);
+    BOOST_REQUIRE_EQUAL(tracker.top_height(), 12u);
+}
+
+BOOST_AUTO_TEST_CASE(confirmation_tracker__track__known_height__reported_immediately)
+{
+    confirmation_tracker tracker;
+    const chain::block genesis;
+    const auto block10 = make_block(genesis, 10, {});
+    tracker.handle_block(10, block10);
+
+    size_t reported = 0;
+    tracker.track(make_tx(1).hash(), { 1, 2 }, [&](const code&, size_t,
+        size_t depth)
+    {
+        reported = depth;
+    }, 9);
+
+    BOOST_REQUIRE_EQUAL(reported, 2u);
+    BOOST_REQUIRE_EQUAL(tracker.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(confirmation_tracker__untrack__tracked__not_reported)
+{
+    confirmation_tracker tracker;
+    const auto tx = make_tx(7);
+    auto called = false;
+
+    tracker.track(tx.hash(), { 1 }, [&](const code&, size_t, size_t)
+    {
+        called = true;
+    });
+
+    BOOST_REQUIRE(tracker.untrack(tx.hash()));
+    BOOST_REQUIRE(!tracker.untrack(tx.hash()));
+
+    const chain::block genesis;
+    tracker.handle_block(1, make_block(genesis, 1, { tx }));
+    BOOST_REQUIRE(!called);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
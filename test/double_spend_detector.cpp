@@ -0,0 +1,162 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdint>
+#include <vector>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test_suite.hpp>
+#include <bitcoin/client.hpp>
+
+using namespace bc::client;
+using namespace bc::system;
+
+static const chain::transaction funding{ 1, 0, {}, {} };
+
+// Spenders of the same outpoint are distinguished by locktime.
+static chain::transaction make_spend(uint32_t index, uint32_t locktime)
+{
+    return { 1, locktime, { { { funding.hash(), index }, {}, 0 } }, {} };
+}
+
+BOOST_AUTO_TEST_SUITE(offline)
+
+BOOST_AUTO_TEST_CASE(double_spend_detector__handle_transaction__conflict__reported)
+{
+    double_spend_detector detector(16);
+    const auto payment = make_spend(0, 1);
+    const auto respend = make_spend(0, 2);
+    std::vector<hash_digest> conflicts;
+
+    detector.watch(payment, [&](const chain::output_point& point,
+        const hash_digest& spender, const hash_digest& conflict)
+    {
+        BOOST_REQUIRE(point == chain::output_point(funding.hash(), 0));
+        BOOST_REQUIRE(spender == payment.hash());
+        conflicts.push_back(conflict);
+    });
+
+    detector.handle_transaction(payment);
+    detector.handle_transaction(make_spend(1, 3));
+    BOOST_REQUIRE(conflicts.empty());
+
+    detector.handle_transaction(respend);
+    BOOST_REQUIRE_EQUAL(conflicts.size(), 1u);
+    BOOST_REQUIRE(conflicts.front() == respend.hash());
+    BOOST_REQUIRE_EQUAL(detector.size(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(double_spend_detector__watch__spent_before__reported_null)
+{
+    double_spend_detector detector(16);
+    detector.handle_transaction(make_spend(0, 2));
+
+    auto called = false;
+    detector.watch(make_spend(0, 1), [&](const chain::output_point&,
+        const hash_digest&, const hash_digest& conflict)
+    {
+        called = true;
+        BOOST_REQUIRE(conflict == null_hash);
+    });
+
+    BOOST_REQUIRE(called);
+}
+
+BOOST_AUTO_TEST_CASE(double_spend_detector__handle_block__confirmed__removed)
+{
+    double_spend_detector detector(16);
+    const auto payment = make_spend(0, 1);
+    const auto respend = make_spend(0, 2);
+    std::vector<hash_digest> conflicts;
+
+    detector.watch(payment, [&](const chain::output_point&,
+        const hash_digest&, const hash_digest& conflict)
+    {
+        conflicts.push_back(conflict);
+    });
+
+    for (uint32_t index = 1; index < 8; ++index)
+        detector.handle_transaction(make_spend(index, 0));
+
+    BOOST_REQUIRE_EQUAL(detector.size(), 8u);
+
+    // The respend confirms, ending the watch, and is removed from the index.
+    detector.handle_block({ {}, { respend, make_spend(3, 0) } });
+    BOOST_REQUIRE_EQUAL(conflicts.size(), 1u);
+    BOOST_REQUIRE(conflicts.front() == respend.hash());
+    BOOST_REQUIRE_EQUAL(detector.watched(), 0u);
+    BOOST_REQUIRE_EQUAL(detector.size(), 6u);
+
+    // Remaining spends are still found after deletion.
+    detector.handle_transaction(make_spend(5, 0));
+    BOOST_REQUIRE_EQUAL(detector.size(), 6u);
+}
+
+BOOST_AUTO_TEST_CASE(double_spend_detector__handle_transaction__full__oldest_evicted)
+{
+    double_spend_detector detector(4);
+
+    for (uint32_t index = 0; index < 6; ++index)
+        detector.handle_transaction(make_spend(index, 0));
+
+    BOOST_REQUIRE_EQUAL(detector.size(), 4u);
+    BOOST_REQUIRE_EQUAL(detector.capacity(), 4u);
+    BOOST_REQUIRE_EQUAL(detector.evicted(), 2u);
+
+    // The newest spend is indexed, the oldest is not.
+    std::vector<uint32_t> conflicts;
+    const auto handler = [&](const chain::output_point& point,
+        const hash_digest&, const hash_digest&)
+    {
+        conflicts.push_back(point.index());
+    };
+
+    detector.watch(make_spend(5, 1), handler);
+    detector.watch(make_spend(0, 1), handler);
+    BOOST_REQUIRE_EQUAL(conflicts.size(), 1u);
+    BOOST_REQUIRE_EQUAL(conflicts.front(), 5u);
+}
+
+BOOST_AUTO_TEST_CASE(double_spend_detector__handle_transaction__full_after_confirmation__recorded)
+{
+    double_spend_detector detector(4);
+
+    for (uint32_t index = 0; index < 4; ++index)
+        detector.handle_transaction(make_spend(index, 0));
+
+    // A confirmed spend frees its slot without an eviction.
+    detector.handle_block({ {}, { make_spend(1, 0) } });
+    detector.handle_transaction(make_spend(4, 0));
+    BOOST_REQUIRE_EQUAL(detector.size(), 4u);
+    BOOST_REQUIRE_EQUAL(detector.evicted(), 0u);
+
+    detector.handle_transaction(make_spend(5, 0));
+    BOOST_REQUIRE_EQUAL(detector.size(), 4u);
+    BOOST_REQUIRE_EQUAL(detector.evicted(), 1u);
+
+    auto called = false;
+    detector.watch(make_spend(5, 1), [&](const chain::output_point&,
+        const hash_digest&, const hash_digest& conflict)
+    {
+        called = true;
+        BOOST_REQUIRE(conflict == null_hash);
+    });
+
+    BOOST_REQUIRE(called);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
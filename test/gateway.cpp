@@ -0,0 +1,336 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test_suite.hpp>
+#include <bitcoin/client.hpp>
+#include <bitcoin/protocol.hpp>
+#include "server.hpp"
+
+using namespace bc::client;
+using namespace bc::protocol;
+using namespace bc::system;
+
+BOOST_AUTO_TEST_SUITE(offline)
+
+// Offline cases run the gateway between a local server and a local dealer,
+// each on its own ports.
+static std::string local_url(uint16_t port)
+{
+    return "tcp://127.0.0.1:" + std::to_string(port);
+}
+
+static connection_settings settings(uint16_t port)
+{
+    connection_settings value;
+    value.retries = 0;
+    value.server = config::endpoint(local_url(port));
+    return value;
+}
+
+static data_chunk error_payload(const code& ec)
+{
+    return to_chunk(to_little_endian(static_cast<uint32_t>(ec.value())));
+}
+
+static data_chunk height_payload(uint32_t height)
+{
+    return build_chunk(
+    {
+        error_payload(error::success),
+        to_little_endian(height)
+    });
+}
+
+static data_chunk notification_payload(uint16_t sequence, uint32_t height)
+{
+    return build_chunk(
+    {
+        error_payload(error::success),
+        to_little_endian(sequence),
+        to_little_endian(height),
+        sha256_hash(to_chunk(std::to_string(sequence)))
+    });
+}
+
+static bool answer_success(const test::server::request& request,
+    data_chunk& out)
+{
+    out = request.command == "blockchain.fetch_last_height" ?
+        height_payload(42) : error_payload(error::success);
+    return true;
+}
+
+static bool withhold(const test::server::request&, data_chunk&)
+{
+    return false;
+}
+
+// The first received request of the command.
+static test::server::request first_request(const test::server& server,
+    const std::string& command)
+{
+    for (const auto& request: server.received())
+        if (request.command == command)
+            return request;
+
+    return {};
+}
+
+// Runs ready handlers until the condition holds or a second elapses.
+static bool run_until(asio::service& service,
+    const std::function<bool()>& condition)
+{
+    const auto limit = std::chrono::steady_clock::now() +
+        std::chrono::seconds(1);
+
+    while (!condition())
+    {
+        if (std::chrono::steady_clock::now() >= limit)
+            return false;
+
+        service.restart();
+        service.poll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return true;
+}
+
+// A downstream client of the gateway, used only from the test thread.
+class dealer
+{
+public:
+    struct response
+    {
+        std::string command;
+        uint32_t id;
+        data_chunk payload;
+    };
+
+    dealer(uint16_t port)
+      : socket_(context_, zmq::socket::role::dealer)
+    {
+        BOOST_REQUIRE(!socket_.connect(local_url(port)));
+        poller_.add(socket_);
+    }
+
+    void send(const std::string& command, uint32_t id,
+        const data_chunk& payload)
+    {
+        zmq::message message;
+        message.enqueue(to_chunk(command));
+        message.enqueue(to_chunk(to_little_endian(id)));
+        message.enqueue(payload);
+        BOOST_REQUIRE(!socket_.send(message));
+    }
+
+    // Runs the gateway until a response is received or a second elapses.
+    bool receive(asio::service& service, response& out)
+    {
+        return run_until(service, [&]()
+        {
+            if (!poller_.wait(0).contains(socket_.id()))
+                return false;
+
+            zmq::message message;
+            return !socket_.receive(message) && message.size() == 3 &&
+                message.dequeue(out.command) && message.dequeue(out.id) &&
+                message.dequeue(out.payload);
+        });
+    }
+
+private:
+    zmq::context context_;
+    zmq::socket socket_;
+    zmq::poller poller_;
+};
+
+BOOST_AUTO_TEST_CASE(gateway__start__started__false)
+{
+    connection_settings upstream;
+    upstream.retries = 0;
+    upstream.server = config::endpoint("tcp://localhost:9091");
+    const config::endpoint downstream("tcp://127.0.0.1:9191");
+
+    asio::service service;
+    gateway local(service);
+    BOOST_REQUIRE(local.start(upstream, downstream));
+    BOOST_REQUIRE(!local.start(upstream, downstream));
+    BOOST_REQUIRE_EQUAL(local.upstream_requests(), 0u);
+    BOOST_REQUIRE_EQUAL(local.upstream_subscriptions(), 0u);
+    local.stop();
+    service.run();
+}
+
+BOOST_AUTO_TEST_CASE(gateway__query__repeated__cache_hit)
+{
+    static const std::string command = "blockchain.fetch_last_height";
+    test::server server(local_url(9329), answer_success);
+    asio::service service;
+    gateway local(service);
+    BOOST_REQUIRE(local.start(settings(9329),
+        config::endpoint(local_url(9330))));
+
+    dealer client(9330);
+    dealer::response response;
+    client.send(command, 1, {});
+    BOOST_REQUIRE(client.receive(service, response));
+    BOOST_REQUIRE_EQUAL(response.command, command);
+    BOOST_REQUIRE_EQUAL(response.id, 1u);
+    BOOST_REQUIRE(response.payload == height_payload(42));
+
+    client.send(command, 2, {});
+    BOOST_REQUIRE(client.receive(service, response));
+    BOOST_REQUIRE_EQUAL(response.id, 2u);
+    BOOST_REQUIRE(response.payload == height_payload(42));
+    BOOST_REQUIRE_EQUAL(local.cache_hits(), 1u);
+    BOOST_REQUIRE_EQUAL(local.upstream_requests(), 1u);
+    BOOST_REQUIRE_EQUAL(server.requests(command), 1u);
+    local.stop();
+}
+
+BOOST_AUTO_TEST_CASE(gateway__query__concurrent__coalesced)
+{
+    static const std::string command = "blockchain.fetch_last_height";
+    test::server server(local_url(9331), withhold);
+    asio::service service;
+    gateway local(service);
+    BOOST_REQUIRE(local.start(settings(9331),
+        config::endpoint(local_url(9332))));
+
+    dealer first(9332);
+    dealer second(9332);
+    first.send(command, 1, {});
+    second.send(command, 2, {});
+    BOOST_REQUIRE(run_until(service, [&]()
+    {
+        return local.coalesced() == 1 && server.requests(command) == 1;
+    }));
+
+    server.notify(first_request(server, command), command, height_payload(42));
+
+    dealer::response response;
+    BOOST_REQUIRE(first.receive(service, response));
+    BOOST_REQUIRE_EQUAL(response.id, 1u);
+    BOOST_REQUIRE(response.payload == height_payload(42));
+    BOOST_REQUIRE(second.receive(service, response));
+    BOOST_REQUIRE_EQUAL(response.id, 2u);
+    BOOST_REQUIRE(response.payload == height_payload(42));
+    BOOST_REQUIRE_EQUAL(local.upstream_requests(), 1u);
+    local.stop();
+}
+
+BOOST_AUTO_TEST_CASE(gateway__query__no_response__waiters_timed_out)
+{
+    static const std::string command = "blockchain.fetch_last_height";
+    test::server server(local_url(9333), withhold);
+    asio::service service;
+    gateway local(service, 1000, 1000, 10, 10);
+    BOOST_REQUIRE(local.start(settings(9333),
+        config::endpoint(local_url(9334))));
+
+    dealer first(9334);
+    dealer second(9334);
+    first.send(command, 1, {});
+    second.send(command, 2, {});
+
+    dealer::response response;
+    BOOST_REQUIRE(first.receive(service, response));
+    BOOST_REQUIRE(response.payload == error_payload(error::channel_timeout));
+    BOOST_REQUIRE(second.receive(service, response));
+    BOOST_REQUIRE(response.payload == error_payload(error::channel_timeout));
+    BOOST_REQUIRE_EQUAL(local.coalesced(), 1u);
+
+    // The entry is erased, so the query is sent upstream again.
+    first.send(command, 3, {});
+    BOOST_REQUIRE(first.receive(service, response));
+    BOOST_REQUIRE_EQUAL(response.id, 3u);
+    BOOST_REQUIRE_EQUAL(local.upstream_requests(), 2u);
+    BOOST_REQUIRE_EQUAL(server.requests(command), 2u);
+    local.stop();
+}
+
+BOOST_AUTO_TEST_CASE(gateway__subscribe__two_subscribers__fanned_out)
+{
+    static const auto key = sha256_hash(to_chunk(std::string("key")));
+    test::server server(local_url(9335), answer_success);
+    asio::service service;
+    gateway local(service);
+    BOOST_REQUIRE(local.start(settings(9335),
+        config::endpoint(local_url(9336))));
+
+    dealer first(9336);
+    dealer second(9336);
+    dealer::response response;
+    first.send("subscribe.key", 1, to_chunk(key));
+    BOOST_REQUIRE(first.receive(service, response));
+    BOOST_REQUIRE_EQUAL(response.command, "subscribe.key");
+    BOOST_REQUIRE(response.payload == error_payload(error::success));
+
+    second.send("subscribe.key", 2, to_chunk(key));
+    BOOST_REQUIRE(second.receive(service, response));
+    BOOST_REQUIRE(response.payload == error_payload(error::success));
+    BOOST_REQUIRE_EQUAL(local.upstream_subscriptions(), 1u);
+    BOOST_REQUIRE_EQUAL(server.requests("subscribe.key"), 1u);
+
+    server.notify(first_request(server, "subscribe.key"), "notification.key",
+        notification_payload(0, 42));
+
+    BOOST_REQUIRE(first.receive(service, response));
+    BOOST_REQUIRE_EQUAL(response.command, "notification.key");
+    BOOST_REQUIRE_EQUAL(response.id, 1u);
+    BOOST_REQUIRE(response.payload == notification_payload(0, 42));
+    BOOST_REQUIRE(second.receive(service, response));
+    BOOST_REQUIRE_EQUAL(response.command, "notification.key");
+    BOOST_REQUIRE_EQUAL(response.id, 2u);
+    BOOST_REQUIRE(response.payload == notification_payload(0, 42));
+    local.stop();
+}
+
+BOOST_AUTO_TEST_CASE(gateway__subscribe__expired__swept)
+{
+    static const auto key = sha256_hash(to_chunk(std::string("key")));
+    test::server server(local_url(9337), answer_success);
+    asio::service service;
+    gateway local(service, 1000, 1000, 0);
+    BOOST_REQUIRE(local.start(settings(9337),
+        config::endpoint(local_url(9338))));
+
+    dealer client(9338);
+    client.send("subscribe.key", 1, to_chunk(key));
+    BOOST_REQUIRE(run_until(service, [&]()
+    {
+        return server.requests("subscribe.key") == 1;
+    }));
+
+    BOOST_REQUIRE(run_until(service, [&]()
+    {
+        return local.upstream_subscriptions() == 0 &&
+            server.requests("unsubscribe.key") == 1;
+    }));
+
+    local.stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdint>
+#include <cstdio>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test_suite.hpp>
+#include <bitcoin/client.hpp>
+
+using namespace bc::client;
+using namespace bc::system;
+
+// Blocks are distinguished by nonce and transactions by locktime.
+static chain::block make_block(const chain::block& parent, uint32_t nonce,
+    const chain::transaction::list& txs)
+{
+    return { { 1, parent.hash(), null_hash, 0, 0, nonce }, txs };
+}
+
+BOOST_AUTO_TEST_SUITE(offline)
+
+BOOST_AUTO_TEST_CASE(index_cache__handle_block__looked_up_transactions__found)
+{
+    index_cache cache;
+    const chain::transaction other{ 1, 6, {}, {} };
+    const chain::transaction tx{ 1, 7, {}, {} };
+    const auto block = make_block({}, 1, { other, tx });
+
+    size_t height;
+    size_t position;
+    BOOST_REQUIRE(!cache.find_transaction(tx.hash(), height, position));
+    cache.handle_block(10, block);
+
+    BOOST_REQUIRE(cache.find_height(block.hash(), height));
+    BOOST_REQUIRE_EQUAL(height, 10u);
+    BOOST_REQUIRE(cache.find_transaction(tx.hash(), height, position));
+    BOOST_REQUIRE_EQUAL(height, 10u);
+    BOOST_REQUIRE_EQUAL(position, 1u);
+    BOOST_REQUIRE(!cache.find_transaction(other.hash(), height, position));
+    BOOST_REQUIRE_EQUAL(cache.size(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(index_cache__store__top_unknown__not_cached)
+{
+    index_cache cache;
+    cache.store_height(sha256_hash({ 1 }), 5);
+    cache.store_transaction(sha256_hash({ 2 }), 5, 0);
+
+    size_t height;
+    size_t position;
+    BOOST_REQUIRE_EQUAL(cache.size(), 0u);
+    BOOST_REQUIRE(!cache.find_height(sha256_hash({ 1 }), height));
+    BOOST_REQUIRE(!cache.find_transaction(sha256_hash({ 2 }), height,
+        position));
+
+    cache.handle_block(10, make_block({}, 10, {}));
+    cache.store_height(sha256_hash({ 1 }), 5);
+    BOOST_REQUIRE(cache.find_height(sha256_hash({ 1 }), height));
+    BOOST_REQUIRE_EQUAL(height, 5u);
+}
+
+BOOST_AUTO_TEST_CASE(index_cache__store__capacity__oldest_evicted)
+{
+    index_cache cache(100, 3);
+    const auto block = make_block({}, 10, {});
+    cache.handle_block(10, block);
+
+    for (uint8_t key = 1; key <= 4; ++key)
+        cache.store_transaction(sha256_hash({ key }), 5, key);
+
+    size_t height;
+    size_t position;
+    BOOST_REQUIRE_EQUAL(cache.size(), 3u);
+    BOOST_REQUIRE(!cache.find_height(block.hash(), height));
+    BOOST_REQUIRE(!cache.find_transaction(sha256_hash({ 1 }), height,
+        position));
+    BOOST_REQUIRE(cache.find_transaction(sha256_hash({ 4 }), height,
+        position));
+    BOOST_REQUIRE_EQUAL(position, 4u);
+}
+
+BOOST_AUTO_TEST_CASE(index_cache__handle_block__wanted_seen__not_counted)
+{
+    index_cache cache(100, 3);
+    const chain::transaction tx1{ 1, 1, {}, {} };
+    const chain::transaction tx2{ 1, 2, {}, {} };
+    const chain::transaction tx3{ 1, 3, {}, {} };
+    const chain::transaction tx4{ 1, 4, {}, {} };
+    const auto block10 = make_block({}, 10, { tx2 });
+    const auto block11 = make_block(block10, 11, { tx1 });
+
+    size_t height;
+    size_t position;
+    BOOST_REQUIRE(!cache.find_transaction(tx1.hash(), height, position));
+    BOOST_REQUIRE(!cache.find_transaction(tx2.hash(), height, position));
+    BOOST_REQUIRE(!cache.find_transaction(tx3.hash(), height, position));
+    cache.handle_block(10, block10);
+
+    // The seen transaction no longer displaces the oldest looked up one.
+    BOOST_REQUIRE(!cache.find_transaction(tx4.hash(), height, position));
+    cache.handle_block(11, block11);
+    BOOST_REQUIRE(cache.find_transaction(tx1.hash(), height, position));
+    BOOST_REQUIRE_EQUAL(height, 11u);
+}
+
+BOOST_AUTO_TEST_CASE(index_cache__handle_block__reorganization__invalidated)
+{
+    index_cache cache(2);
+    const chain::transaction tx{ 1, 7, {}, {} };
+    const auto block10 = make_block({}, 10, {});
+    const auto block11 = make_block(block10, 11, { tx });
+    const auto other11 = make_block(block10, 111, {});
+
+    size_t height;
+    size_t position;
+    BOOST_REQUIRE(!cache.find_transaction(tx.hash(), height, position));
+    cache.handle_block(10, block10);
+    cache.handle_block(11, block11);
+    cache.store_height(sha256_hash({ 1 }), 11);
+    BOOST_REQUIRE(cache.find_transaction(tx.hash(), height, position));
+
+    cache.handle_block(11, other11);
+    BOOST_REQUIRE(!cache.find_transaction(tx.hash(), height, position));
+    BOOST_REQUIRE(!cache.find_height(block11.hash(), height));
+    BOOST_REQUIRE(!cache.find_height(sha256_hash({ 1 }), height));
+    BOOST_REQUIRE(cache.find_height(block10.hash(), height));
+}
+
+BOOST_AUTO_TEST_CASE(index_cache__save__final_entries__loaded)
+{
+    const auto path = "index_cache__save__final_entries__loaded.bin";
+    const chain::transaction tx{ 1, 7, {}, {} };
+    const auto block1 = make_block({}, 1, { tx });
+    const auto block2 = make_block(block1, 2, {});
+    const auto block3 = make_block(block2, 3, {});
+
+    index_cache cache(2);
+    size_t height;
+    size_t position;
+    BOOST_REQUIRE(!cache.find_transaction(tx.hash(), height, position));
+    cache.handle_block(1, block1);
+    cache.handle_block(2, block2);
+    cache.handle_block(3, block3);
+    BOOST_REQUIRE(cache.save(path));
+
+    index_cache loaded;
+    BOOST_REQUIRE(loaded.load(path));
+    std::remove(path);
+
+    // Only block 1 and its transaction are final, served once a top is known.
+    BOOST_REQUIRE_EQUAL(loaded.size(), 2u);
+    BOOST_REQUIRE(!loaded.find_transaction(tx.hash(), height, position));
+    loaded.handle_block(3, block3);
+    BOOST_REQUIRE(loaded.find_transaction(tx.hash(), height, position));
+    BOOST_REQUIRE_EQUAL(height, 1u);
+    BOOST_REQUIRE(!loaded.find_height(block2.hash(), height));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -16,12 +16,22 @@
  * You should have received a copy of the GNU Affero General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <chrono>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <poll.h>
+#endif
 #include <boost/test/test_tools.hpp>
 #include <boost/test/unit_test_suite.hpp>
 #include <bitcoin/client.hpp>
 #include <bitcoin/protocol.hpp>
+#include "server.hpp"
 
 using namespace bc::client;
 using namespace bc::protocol;
@@ -53,6 +63,1071 @@ BOOST_AUTO_TEST_CASE(client__dummy_test__ok)
 
 BOOST_AUTO_TEST_SUITE_END()
 
+// Offline cases run against a local server, each on its own port.
+static std::string local_url(uint16_t port)
+{
+    return "tcp://127.0.0.1:" + std::to_string(port);
+}
+
+static data_chunk success_payload()
+{
+    return to_chunk(to_little_endian(static_cast<uint32_t>(error::success)));
+}
+
+static bool answer_success(const test::server::request&, data_chunk& out)
+{
+    out = success_payload();
+    return true;
+}
+
+// Processes ready messages until the condition holds or a second elapses.
+static bool process_until(obelisk_client& client,
+    const std::function<bool()>& condition)
+{
+    const auto limit = std::chrono::steady_clock::now() +
+        std::chrono::seconds(1);
+
+    while (!condition())
+    {
+        if (std::chrono::steady_clock::now() >= limit)
+            return false;
+
+        client.process_ready();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return true;
+}
+
+static hash_digest spread_key(uint8_t high, uint8_t low)
+{
+    hash_digest key{};
+    key[0] = high;
+    key[1] = low;
+    return key;
+}
+
+static data_chunk notification_payload(uint16_t sequence, uint32_t height)
+{
+    return build_chunk(
+    {
+        to_little_endian(static_cast<uint32_t>(error::success)),
+        to_little_endian(sequence),
+        to_little_endian(height),
+        sha256_hash(to_chunk(std::to_string(sequence)))
+    });
+}
+
+static data_chunk error_payload(const code& ec)
+{
+    return to_chunk(to_little_endian(static_cast<uint32_t>(ec.value())));
+}
+
+// The first received request of the command.
+static test::server::request first_request(const test::server& server,
+    const std::string& command)
+{
+    for (const auto& request: server.received())
+        if (request.command == command)
+            return request;
+
+    return {};
+}
+
+static chain::transaction make_transaction(uint64_t value)
+{
+    return { 1, 0, {}, { { value, chain::script() } } };
+}
+
+static chain::transaction make_witness_transaction(uint64_t value)
+{
+    const chain::input input{ { sha256_hash({ 0x01 }), 0 }, {},
+        chain::witness(data_stack{ { 0x2a } }), 0 };
+    return { 1, 0, { input }, { { value, chain::script() } } };
+}
+
+// [ kind:1 ][ point:36 ][ height:4 ][ data:8 ]
+static data_chunk history_row(bool output, const chain::output_point& point,
+    uint64_t data)
+{
+    return build_chunk(
+    {
+        to_array(output ? 0 : 1),
+        point.hash(),
+        to_little_endian(point.index()),
+        to_little_endian<uint32_t>(42),
+        to_little_endian(data)
+    });
+}
+
+// A block whose header commits to its transaction.
+static chain::block committed_block()
+{
+    const chain::transaction::list txs{ { 1, 1, {}, {} } };
+    const chain::header header{ 1, null_hash,
+        chain::block{ {}, txs }.generate_merkle_root(), 0, 0, 0 };
+
+    return { header, txs };
+}
+
+// A block whose header commits to another transaction than it carries.
+static data_chunk tampered_block_payload()
+{
+    const chain::block tampered{ committed_block().header(),
+        { { 1, 2, {}, {} } } };
+    return build_chunk({ success_payload(), tampered.to_data() });
+}
+
+// Fixed-width responses, each truncated by the given number of bytes.
+static bool answer_fixed_width(const test::server::request& request,
+    data_chunk& out, size_t truncated)
+{
+    const auto hash = sha256_hash({ 0x2a });
+    if (request.command == "blockchain.fetch_last_height")
+        out = build_chunk({ success_payload(),
+            to_little_endian<uint32_t>(42) });
+    else if (request.command == "blockchain.fetch_spend")
+        out = build_chunk({ success_payload(), hash,
+            to_little_endian<uint32_t>(7) });
+    else if (request.command == "blockchain.fetch_transaction_index")
+        out = build_chunk({ success_payload(),
+            to_little_endian<uint32_t>(42), to_little_endian<uint32_t>(7) });
+    else
+        out = build_chunk({ success_payload(), hash, hash });
+
+    out.resize(out.size() - truncated);
+    return true;
+}
+
+// Fetches each fixed-width response, returning the codes in request order.
+static std::vector<code> fetch_fixed_width(obelisk_client& client)
+{
+    const auto hash = sha256_hash({ 0x2a });
+    std::vector<code> results;
+
+    client.blockchain_fetch_last_height([&](const code& ec, size_t height)
+    {
+        results.push_back(ec);
+        BOOST_REQUIRE(ec || height == 42u);
+    });
+
+    client.blockchain_fetch_spend([&](const code& ec,
+        const chain::input_point& point)
+    {
+        results.push_back(ec);
+        BOOST_REQUIRE(ec || (point.hash() == hash && point.index() == 7u));
+    }, { null_hash, 0 });
+
+    client.blockchain_fetch_transaction_index([&](const code& ec,
+        size_t height, size_t position)
+    {
+        results.push_back(ec);
+        BOOST_REQUIRE(ec || (height == 42u && position == 7u));
+    }, null_hash);
+
+    client.blockchain_fetch_block_transaction_hashes([&](const code& ec,
+        const hash_list& hashes)
+    {
+        results.push_back(ec);
+        BOOST_REQUIRE(ec || (hashes.size() == 2 && hashes.front() == hash));
+    }, null_hash);
+
+    process_until(client, [&]() { return results.size() == 4; });
+    return results;
+}
+
+#ifndef _WIN32
+// True if any of the descriptors becomes readable within the timeout.
+static bool readable(
+    const std::vector<obelisk_client::file_descriptor>& descriptors,
+    int timeout_milliseconds)
+{
+    std::vector<pollfd> polled;
+    for (const auto descriptor: descriptors)
+        polled.push_back({ descriptor, POLLIN, 0 });
+
+    return ::poll(polled.data(), polled.size(), timeout_milliseconds) > 0;
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE(offline)
+
+BOOST_AUTO_TEST_CASE(obelisk_client__subscribe_key__renewal__third_quarter_of_period)
+{
+    const test::server server(local_url(9301), answer_success);
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9301))));
+    client.set_subscription_expiration(asio::milliseconds(800));
+
+    const auto ignore = [](const code&, uint16_t, size_t, const hash_digest&) {};
+    client.subscribe_key(ignore, spread_key(0xff, 0xff));
+    const auto last = client.process_ready();
+    BOOST_REQUIRE_GT(last.count(), 550);
+    BOOST_REQUIRE_LE(last.count(), 600);
+
+    client.subscribe_key(ignore, spread_key(0x00, 0x00));
+    const auto first = client.process_ready();
+    BOOST_REQUIRE_GT(first.count(), 350);
+    BOOST_REQUIRE_LE(first.count(), 400);
+
+    const auto start = std::chrono::steady_clock::now();
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        return server.requests("subscribe.key") == 3;
+    }));
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    BOOST_REQUIRE(elapsed >= std::chrono::milliseconds(350));
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__subscribe_key__zero_expiration__not_renewed)
+{
+    const test::server server(local_url(9302), answer_success);
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9302))));
+    client.set_subscription_expiration(asio::milliseconds::zero());
+
+    client.subscribe_key([](const code&, uint16_t, size_t,
+        const hash_digest&) {}, spread_key(0x00, 0x00));
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        return server.requests("subscribe.key") == 1;
+    }));
+
+    BOOST_REQUIRE(client.process_ready() == asio::milliseconds::max());
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__renewal_lag__delayed_acknowledgement__updated)
+{
+    static constexpr auto delay = 50;
+    std::vector<test::server::request> renewals;
+    std::mutex mutex;
+
+    // The subscription is acknowledged, its renewal is withheld.
+    test::server server(local_url(9303),
+        [&](const test::server::request& request, data_chunk& out)
+        {
+            if (!request.delimited)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                renewals.push_back(request);
+                return false;
+            }
+
+            out = success_payload();
+            return true;
+        });
+
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9303))));
+    client.set_subscription_expiration(asio::milliseconds(40));
+    BOOST_REQUIRE(client.renewal_lag() == asio::milliseconds::zero());
+
+    client.subscribe_key([](const code&, uint16_t, size_t,
+        const hash_digest&) {}, spread_key(0x00, 0x00));
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return !renewals.empty();
+    }));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        server.notify(renewals.front(), "subscribe.key", success_payload());
+    }
+
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        return client.renewal_lag() != asio::milliseconds::zero();
+    }));
+
+    BOOST_REQUIRE_GE(client.renewal_lag().count(), delay);
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__subscribe_key__debounced_burst__coalesced)
+{
+    test::server server(local_url(9304), answer_success);
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9304))));
+
+    std::vector<obelisk_client::key_update::list> calls;
+    client.subscribe_key([&](const code& ec,
+        const obelisk_client::key_update::list& updates)
+    {
+        BOOST_REQUIRE(!ec);
+        if (!updates.empty())
+            calls.push_back(updates);
+    }, spread_key(0x00, 0x00), 50);
+
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        return server.requests("subscribe.key") == 1;
+    }));
+
+    const auto origin = first_request(server, "subscribe.key");
+    for (uint16_t sequence = 0; sequence < 3; ++sequence)
+        server.notify(origin, "notification.key",
+            notification_payload(sequence, 42));
+
+    BOOST_REQUIRE(process_until(client, [&]() { return !calls.empty(); }));
+    BOOST_REQUIRE_EQUAL(calls.size(), 1u);
+    BOOST_REQUIRE_EQUAL(calls.front().size(), 3u);
+    BOOST_REQUIRE_EQUAL(calls.front()[2].sequence, 2u);
+    BOOST_REQUIRE_EQUAL(calls.front()[2].height, 42u);
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__subscribe_key__debounced_error__flushed_first)
+{
+    test::server server(local_url(9305), answer_success);
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9305))));
+
+    std::vector<std::pair<code, size_t>> calls;
+    client.subscribe_key([&](const code& ec,
+        const obelisk_client::key_update::list& updates)
+    {
+        if (ec || !updates.empty())
+            calls.emplace_back(ec, updates.size());
+    }, spread_key(0x00, 0x00), 10000);
+
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        return server.requests("subscribe.key") == 1;
+    }));
+
+    const auto origin = first_request(server, "subscribe.key");
+    server.notify(origin, "notification.key", notification_payload(0, 42));
+    server.notify(origin, "notification.key", notification_payload(1, 42));
+    server.notify(origin, "notification.key", error_payload(error::not_found));
+
+    BOOST_REQUIRE(process_until(client, [&]() { return calls.size() == 2; }));
+    BOOST_REQUIRE(!calls[0].first);
+    BOOST_REQUIRE_EQUAL(calls[0].second, 2u);
+    BOOST_REQUIRE_EQUAL(calls[1].first, error::not_found);
+    BOOST_REQUIRE_EQUAL(calls[1].second, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__unsubscribe_key__debounced__flushed)
+{
+    test::server server(local_url(9306), answer_success);
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9306))));
+
+    // A plain subscriber to the key shows when notifications have arrived.
+    size_t notified = 0;
+    client.subscribe_key([&](const code&, uint16_t, size_t,
+        const hash_digest& tx_hash)
+    {
+        if (tx_hash != null_hash)
+            ++notified;
+    }, spread_key(0x00, 0x00));
+
+    size_t flushed = 0;
+    const auto subscription = client.subscribe_key([&](const code& ec,
+        const obelisk_client::key_update::list& updates)
+    {
+        BOOST_REQUIRE(!ec);
+        flushed += updates.size();
+    }, spread_key(0x00, 0x00), 10000);
+
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        return server.requests("subscribe.key") == 1;
+    }));
+
+    const auto origin = first_request(server, "subscribe.key");
+    server.notify(origin, "notification.key", notification_payload(0, 42));
+    server.notify(origin, "notification.key", notification_payload(1, 42));
+    BOOST_REQUIRE(process_until(client, [&]() { return notified == 2; }));
+    BOOST_REQUIRE_EQUAL(flushed, 0u);
+
+    code result(error::operation_failed);
+    BOOST_REQUIRE(client.unsubscribe_key([&](const code& ec)
+    {
+        result = ec;
+    }, subscription));
+
+    BOOST_REQUIRE(!result);
+    BOOST_REQUIRE_EQUAL(flushed, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__subscribe_key__local_subscribers__one_server_subscription)
+{
+    test::server server(local_url(9347), answer_success);
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9347))));
+
+    size_t first_notified = 0;
+    const auto first = client.subscribe_key([&](const code& ec, uint16_t,
+        size_t, const hash_digest& tx_hash)
+    {
+        BOOST_REQUIRE(!ec);
+        if (tx_hash != null_hash)
+            ++first_notified;
+    }, spread_key(0x00, 0x00));
+
+    size_t second_notified = 0;
+    const auto second = client.subscribe_key([&](const code& ec, uint16_t,
+        size_t, const hash_digest& tx_hash)
+    {
+        BOOST_REQUIRE(!ec);
+        if (tx_hash != null_hash)
+            ++second_notified;
+    }, spread_key(0x00, 0x00));
+
+    BOOST_REQUIRE(first != second);
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        return server.requests("subscribe.key") == 1;
+    }));
+
+    const auto origin = first_request(server, "subscribe.key");
+    server.notify(origin, "notification.key", notification_payload(0, 42));
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        return first_notified == 1 && second_notified == 1;
+    }));
+
+    // Only the last local unsubscribe reaches the server.
+    code result(error::operation_failed);
+    BOOST_REQUIRE(client.unsubscribe_key([&](const code& ec)
+    {
+        result = ec;
+    }, first));
+
+    BOOST_REQUIRE(!result);
+    server.notify(origin, "notification.key", notification_payload(1, 42));
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        return second_notified == 2;
+    }));
+    BOOST_REQUIRE_EQUAL(first_notified, 1u);
+    BOOST_REQUIRE_EQUAL(server.requests("unsubscribe.key"), 0u);
+
+    result = error::operation_failed;
+    BOOST_REQUIRE(client.unsubscribe_key([&](const code& ec)
+    {
+        result = ec;
+    }, second));
+
+    BOOST_REQUIRE(process_until(client, [&]() { return !result; }));
+    BOOST_REQUIRE_EQUAL(server.requests("unsubscribe.key"), 1u);
+    BOOST_REQUIRE_EQUAL(server.requests("subscribe.key"), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__transaction_pool_broadcast_and_await__streamed__accepted)
+{
+    test::server server(local_url(9307), answer_success, local_url(9308));
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9307))));
+    BOOST_REQUIRE(client.subscribe_transaction(config::endpoint(
+        local_url(9308)), [](const chain::transaction&) {}));
+
+    const auto tx = make_transaction(1000);
+    auto called = false;
+    code result(error::operation_failed);
+    client.transaction_pool_broadcast_and_await([&](const code& ec,
+        const asio::milliseconds&)
+    {
+        called = true;
+        result = ec;
+    }, tx, 10000);
+
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        return server.requests("transaction_pool.broadcast") == 1;
+    }));
+
+    // Published repeatedly, as the stream may not yet be connected.
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        server.publish({ to_chunk(to_little_endian<uint16_t>(0)),
+            tx.to_data(true, true) });
+        return called;
+    }));
+
+    BOOST_REQUIRE(!result);
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__transaction_pool_broadcast_and_await__not_streamed__channel_timeout)
+{
+    test::server server(local_url(9309), answer_success, local_url(9310));
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9309))));
+    BOOST_REQUIRE(client.subscribe_transaction(config::endpoint(
+        local_url(9310)), [](const chain::transaction&) {}));
+
+    std::vector<code> results;
+    const auto handler = [&](const code& ec, const asio::milliseconds&)
+    {
+        results.push_back(ec);
+    };
+
+    client.transaction_pool_broadcast_and_await(handler, make_transaction(1),
+        20);
+    client.transaction_pool_broadcast_and_await(handler, make_transaction(2),
+        40);
+    client.transaction_pool_broadcast_and_await(handler, make_transaction(2),
+        40);
+    BOOST_REQUIRE_EQUAL(results.size(), 1u);
+    BOOST_REQUIRE_EQUAL(results.front(), error::duplicate_transaction);
+
+    BOOST_REQUIRE(process_until(client, [&]() { return results.size() == 3; }));
+    BOOST_REQUIRE_EQUAL(results[1], error::channel_timeout);
+    BOOST_REQUIRE_EQUAL(results[2], error::channel_timeout);
+    BOOST_REQUIRE(client.process_ready() == asio::milliseconds::max());
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__transaction_pool_broadcast_and_await__monitor_timeout__retried)
+{
+    test::server server(local_url(9340), answer_success, local_url(9341));
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9340))));
+    BOOST_REQUIRE(client.subscribe_transaction(config::endpoint(
+        local_url(9341)), [](const chain::transaction&) {}));
+
+    // The handler broadcasts again from within the clearing of the monitor.
+    std::vector<code> results;
+    obelisk_client::acceptance_handler handler = [&](const code& ec,
+        const asio::milliseconds&)
+    {
+        results.push_back(ec);
+        if (results.size() == 1)
+            client.transaction_pool_broadcast_and_await(handler,
+                make_transaction(1), 10000);
+    };
+
+    client.transaction_pool_broadcast_and_await(handler, make_transaction(1),
+        10000);
+    client.monitor(10);
+    BOOST_REQUIRE_EQUAL(results.size(), 1u);
+    BOOST_REQUIRE_EQUAL(results.front(), error::channel_timeout);
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        return server.requests("transaction_pool.broadcast") == 2;
+    }));
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__transaction_pool_broadcast_and_await__rejected__error)
+{
+    test::server server(local_url(9311),
+        [](const test::server::request&, data_chunk& out)
+        {
+            out = error_payload(error::operation_failed);
+            return true;
+        });
+
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9311))));
+    BOOST_REQUIRE(client.subscribe_transaction(config::endpoint(
+        local_url(9312)), [](const chain::transaction&) {}));
+
+    auto called = false;
+    code result;
+    client.transaction_pool_broadcast_and_await([&](const code& ec,
+        const asio::milliseconds&)
+    {
+        called = true;
+        result = ec;
+    }, make_transaction(1000), 10000);
+
+    BOOST_REQUIRE(process_until(client, [&]() { return called; }));
+    BOOST_REQUIRE_EQUAL(result, error::operation_failed);
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__blockchain_fetch_unspent_outputs__spent__filtered)
+{
+    const chain::output_point first{ sha256_hash({ 0x01 }), 0 };
+    const chain::output_point second{ sha256_hash({ 0x01 }), 1 };
+    const chain::output_point spender{ sha256_hash({ 0x02 }), 0 };
+
+    test::server server(local_url(9313),
+        [&](const test::server::request&, data_chunk& out)
+        {
+            out = build_chunk(
+            {
+                success_payload(),
+                history_row(true, first, 100),
+                history_row(true, second, 200),
+                history_row(false, spender, second.checksum())
+            });
+
+            return true;
+        });
+
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9313))));
+
+    std::vector<chain::points_value> results;
+    const auto handler = [&](const code& ec, const chain::points_value& value)
+    {
+        BOOST_REQUIRE(!ec);
+        results.push_back(value);
+    };
+
+    client.blockchain_fetch_unspent_outputs(handler, null_hash, 100,
+        wallet::select_outputs::algorithm::greedy);
+    client.blockchain_fetch_unspent_outputs(handler, null_hash, 150,
+        wallet::select_outputs::algorithm::greedy);
+    BOOST_REQUIRE(process_until(client, [&]() { return results.size() == 2; }));
+
+    BOOST_REQUIRE_EQUAL(results[0].points.size(), 1u);
+    BOOST_REQUIRE(results[0].points.front() == first);
+    BOOST_REQUIRE_EQUAL(results[0].value(), 100u);
+    BOOST_REQUIRE(results[1].points.empty());
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__blockchain_fetch_unspent_outputs__coin_selection__spent_excluded)
+{
+    const chain::output_point first{ sha256_hash({ 0x01 }), 0 };
+    const chain::output_point second{ sha256_hash({ 0x01 }), 1 };
+    const chain::output_point third{ sha256_hash({ 0x01 }), 2 };
+    const chain::output_point spender{ sha256_hash({ 0x02 }), 0 };
+
+    test::server server(local_url(9348),
+        [&](const test::server::request&, data_chunk& out)
+        {
+            out = build_chunk(
+            {
+                success_payload(),
+                history_row(true, first, 100),
+                history_row(true, second, 250),
+                history_row(true, third, 50),
+                history_row(false, spender, second.checksum())
+            });
+
+            return true;
+        });
+
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9348))));
+
+    std::vector<chain::points_value> results;
+    const auto handler = [&](const code& ec, const chain::points_value& value)
+    {
+        BOOST_REQUIRE(!ec);
+        results.push_back(value);
+    };
+
+    client.blockchain_fetch_unspent_outputs(handler, null_hash, 150, 0,
+        asio::milliseconds(100));
+    client.blockchain_fetch_unspent_outputs(handler, null_hash, 200, 0,
+        asio::milliseconds(100));
+    BOOST_REQUIRE(process_until(client, [&]() { return results.size() == 2; }));
+
+    BOOST_REQUIRE_EQUAL(results[0].points.size(), 2u);
+    BOOST_REQUIRE_EQUAL(results[0].value(), 150u);
+    BOOST_REQUIRE(results[1].points.empty());
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__blockchain_fetch_unspent_outputs__server_error__error)
+{
+    test::server server(local_url(9314),
+        [](const test::server::request&, data_chunk& out)
+        {
+            out = error_payload(error::not_found);
+            return true;
+        });
+
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9314))));
+
+    auto called = false;
+    code result;
+    client.blockchain_fetch_unspent_outputs([&](const code& ec,
+        const chain::points_value& value)
+    {
+        called = true;
+        result = ec;
+        BOOST_REQUIRE(value.points.empty());
+    }, null_hash, 100, wallet::select_outputs::algorithm::greedy);
+
+    BOOST_REQUIRE(process_until(client, [&]() { return called; }));
+    BOOST_REQUIRE_EQUAL(result, error::not_found);
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__blockchain_fetch_last_height__fetch_from_completion__completed)
+{
+    static constexpr size_t nested = 64;
+    test::server server(local_url(9315),
+        [](const test::server::request&, data_chunk& out)
+        {
+            out = build_chunk({ success_payload(),
+                to_little_endian<uint32_t>(42) });
+            return true;
+        });
+
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9315))));
+
+    // The first completion issues enough requests to rehash the handler map.
+    size_t completed = 0;
+    std::function<void(const code&, size_t)> on_height =
+        [&](const code& ec, size_t height)
+        {
+            BOOST_REQUIRE(!ec);
+            BOOST_REQUIRE_EQUAL(height, 42u);
+            if (++completed == 1)
+                for (size_t request = 0; request < nested; ++request)
+                    client.blockchain_fetch_last_height(on_height);
+        };
+
+    client.blockchain_fetch_last_height(on_height);
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        return completed == nested + 1;
+    }));
+
+    BOOST_REQUIRE_EQUAL(server.requests("blockchain.fetch_last_height"),
+        nested + 1);
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__wait__timeout_fetch_from_completion__completed)
+{
+    test::server server(local_url(9316),
+        [](const test::server::request&, data_chunk&)
+        {
+            return false;
+        });
+
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9316))));
+
+    // Requests issued by a failed handler are failed in turn by wait(0).
+    std::vector<code> results;
+    client.blockchain_fetch_last_height([&](const code& ec, size_t)
+    {
+        results.push_back(ec);
+        client.blockchain_fetch_last_height([&](const code& ec, size_t)
+        {
+            results.push_back(ec);
+        });
+    });
+
+    client.wait(10);
+    BOOST_REQUIRE_EQUAL(results.size(), 1u);
+    BOOST_REQUIRE_EQUAL(results.front(), error::channel_timeout);
+
+    client.wait(0);
+    BOOST_REQUIRE_EQUAL(results.size(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__blockchain_fetch_transaction2__witness_free__original_command)
+{
+    const auto tx = make_witness_transaction(1000);
+    test::server server(local_url(9319),
+        [&](const test::server::request&, data_chunk& out)
+        {
+            out = build_chunk({ success_payload(), tx.to_data(true, false) });
+            return true;
+        });
+
+    obelisk_client client(0);
+    client.set_witness(false);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9319))));
+
+    auto called = false;
+    chain::transaction result;
+    client.blockchain_fetch_transaction2([&](const code& ec,
+        const chain::transaction& fetched)
+    {
+        BOOST_REQUIRE(!ec);
+        called = true;
+        result = fetched;
+    }, tx.hash());
+
+    BOOST_REQUIRE(process_until(client, [&]() { return called; }));
+    BOOST_REQUIRE_EQUAL(server.requests("blockchain.fetch_transaction"), 1u);
+    BOOST_REQUIRE(result.hash() == tx.hash());
+    BOOST_REQUIRE(!result.is_segregated());
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__subscribe_transaction__witness_free__witness_skipped)
+{
+    test::server server(local_url(9320), answer_success, local_url(9321));
+    obelisk_client client(0);
+    client.set_witness(false);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9320))));
+
+    auto called = false;
+    chain::transaction result;
+    BOOST_REQUIRE(client.subscribe_transaction(config::endpoint(
+        local_url(9321)), [&](const chain::transaction& streamed)
+        {
+            called = true;
+            result = streamed;
+        }));
+
+    // Published repeatedly, as the stream may not yet be connected.
+    const auto tx = make_witness_transaction(1000);
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        server.publish({ to_chunk(to_little_endian<uint16_t>(0)),
+            tx.to_data(true, true) });
+        return called;
+    }));
+
+    BOOST_REQUIRE(result.hash() == tx.hash());
+    BOOST_REQUIRE(!result.is_segregated());
+    BOOST_REQUIRE_EQUAL(result.inputs().size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__fixed_width_responses__well_formed__round_trip)
+{
+    test::server server(local_url(9322),
+        [](const test::server::request& request, data_chunk& out)
+        {
+            return answer_fixed_width(request, out, 0);
+        });
+
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9322))));
+
+    const auto results = fetch_fixed_width(client);
+    BOOST_REQUIRE_EQUAL(results.size(), 4u);
+    for (const auto& result: results)
+        BOOST_REQUIRE_EQUAL(result, error::success);
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__fixed_width_responses__truncated__bad_stream)
+{
+    test::server server(local_url(9323),
+        [](const test::server::request& request, data_chunk& out)
+        {
+            return answer_fixed_width(request, out, 1);
+        });
+
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9323))));
+
+    const auto results = fetch_fixed_width(client);
+    BOOST_REQUIRE_EQUAL(results.size(), 4u);
+    for (const auto& result: results)
+        BOOST_REQUIRE_EQUAL(result, error::bad_stream);
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__set_memory_budget__over_budget__deferred_until_released)
+{
+    test::server server(local_url(9324),
+        [](const test::server::request&, data_chunk&)
+        {
+            return false;
+        });
+
+    obelisk_client client(0);
+    client.set_memory_budget(1);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9324))));
+
+    size_t completed = 0;
+    const auto handler = [&](const code& ec, const chain::block&)
+    {
+        BOOST_REQUIRE(!ec);
+        ++completed;
+    };
+
+    // The first request is admitted regardless of the budget.
+    client.blockchain_fetch_block(handler, 1);
+    client.blockchain_fetch_block(handler, 2);
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        return server.requests("blockchain.fetch_block") == 1;
+    }));
+
+    BOOST_REQUIRE(!process_until(client, [&]()
+    {
+        return server.requests("blockchain.fetch_block") == 2;
+    }));
+
+    // A small response does not lower the estimate below its initial value.
+    const auto reserved = client.memory_usage();
+    server.notify(first_request(server, "blockchain.fetch_block"),
+        "blockchain.fetch_block",
+        build_chunk({ success_payload(), chain::block{}.to_data() }));
+
+    BOOST_REQUIRE(process_until(client, [&]()
+    {
+        return server.requests("blockchain.fetch_block") == 2;
+    }));
+
+    BOOST_REQUIRE_EQUAL(completed, 1u);
+    BOOST_REQUIRE_EQUAL(client.memory_usage(), reserved);
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__request_limit__exceeded__network_unreachable)
+{
+    test::server server(local_url(9325),
+        [](const test::server::request&, data_chunk&)
+        {
+            return false;
+        });
+
+    obelisk_client client(0, 2);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9325))));
+
+    std::vector<code> results;
+    const auto on_height = [&](const code& ec, size_t)
+    {
+        results.push_back(ec);
+    };
+
+    client.blockchain_fetch_last_height(on_height);
+    client.blockchain_fetch_history4([&](const code& ec,
+        const bc::client::history::list&)
+    {
+        results.push_back(ec);
+    }, null_hash, 0);
+
+    // Failed without sending, whether budgeted, queried or subscribed.
+    client.blockchain_fetch_last_height(on_height);
+    client.blockchain_fetch_block([&](const code& ec, const chain::block&)
+    {
+        results.push_back(ec);
+    }, 42);
+
+    const auto subscription = client.subscribe_key([&](const code& ec,
+        uint16_t, size_t, const hash_digest&)
+    {
+        results.push_back(ec);
+    }, null_hash);
+
+    BOOST_REQUIRE(subscription == obelisk_client::null_subscription);
+    BOOST_REQUIRE_EQUAL(results.size(), 3u);
+    for (const auto& result: results)
+        BOOST_REQUIRE_EQUAL(result, error::network_unreachable);
+}
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(obelisk_client__file_descriptors__queued_request__readable_and_forwarded)
+{
+    test::server server(local_url(9326),
+        [](const test::server::request&, data_chunk&)
+        {
+            return false;
+        });
+
+    obelisk_client client(0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9326))));
+    const auto descriptors = client.file_descriptors();
+    BOOST_REQUIRE(!descriptors.empty());
+
+    // Drained, nothing is readable until a request is queued to the router.
+    BOOST_REQUIRE(client.process_ready() == asio::milliseconds::max());
+    BOOST_REQUIRE(!readable(descriptors, 0));
+
+    client.blockchain_fetch_last_height([](const code&, size_t) {});
+    BOOST_REQUIRE(readable(descriptors, 1000));
+    BOOST_REQUIRE_EQUAL(server.requests("blockchain.fetch_last_height"), 0u);
+
+    // The request is forwarded without blocking on its (withheld) response.
+    const auto start = std::chrono::steady_clock::now();
+    BOOST_REQUIRE(client.process_ready() == asio::milliseconds::max());
+    BOOST_REQUIRE(std::chrono::steady_clock::now() - start <
+        std::chrono::milliseconds(100));
+
+    const auto limit = std::chrono::steady_clock::now() +
+        std::chrono::seconds(1);
+    while (server.requests("blockchain.fetch_last_height") == 0 &&
+        std::chrono::steady_clock::now() < limit)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    BOOST_REQUIRE_EQUAL(server.requests("blockchain.fetch_last_height"), 1u);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(obelisk_client__blockchain_fetch_block__tampered_inline__merkle_mismatch)
+{
+    test::server server(local_url(9317),
+        [](const test::server::request&, data_chunk& out)
+        {
+            out = tampered_block_payload();
+            return true;
+        });
+
+    obelisk_client client(0);
+    client.set_decode_threads(0, true);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9317))));
+
+    auto called = false;
+    code result;
+    client.blockchain_fetch_block([&](const code& ec, const chain::block&)
+    {
+        called = true;
+        result = ec;
+    }, 42);
+
+    BOOST_REQUIRE(process_until(client, [&]() { return called; }));
+    BOOST_REQUIRE_EQUAL(result, error::merkle_mismatch);
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__blockchain_fetch_block__tampered_decoded__merkle_mismatch)
+{
+    test::server server(local_url(9318),
+        [](const test::server::request&, data_chunk& out)
+        {
+            out = tampered_block_payload();
+            return true;
+        });
+
+    obelisk_client client(0);
+    client.set_decode_threads(2, true);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9318))));
+
+    auto called = false;
+    code result;
+    client.blockchain_fetch_block([&](const code& ec, const chain::block&)
+    {
+        called = true;
+        result = ec;
+    }, 42);
+
+    BOOST_REQUIRE(process_until(client, [&]() { return called; }));
+    BOOST_REQUIRE_EQUAL(result, error::merkle_mismatch);
+}
+
+BOOST_AUTO_TEST_CASE(obelisk_client__blockchain_fetch_block__tampered_shared__fetched)
+{
+    static const std::string name = "libbitcoin_client_test_shared_cache_4";
+    const auto committed = committed_block();
+    test::server server(local_url(9339),
+        [&](const test::server::request&, data_chunk& out)
+        {
+            out = build_chunk({ success_payload(), committed.to_data() });
+            return true;
+        });
+
+    // The tampered block is cached under the hash of its header.
+    const chain::block tampered{ committed.header(), { { 1, 2, {}, {} } } };
+    shared_cache::remove(name);
+    const auto cache = std::make_shared<shared_cache>(name, 16, 4096);
+    BOOST_REQUIRE(cache->store(shared_cache::entry::block, tampered.hash(),
+        tampered.to_data()));
+
+    obelisk_client client(0);
+    client.set_decode_threads(0, true);
+    client.set_shared_cache(cache);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9339))));
+
+    auto called = false;
+    code result;
+    chain::block fetched;
+    client.blockchain_fetch_block([&](const code& ec,
+        const chain::block& block)
+    {
+        called = true;
+        result = ec;
+        fetched = block;
+    }, committed.hash());
+
+    BOOST_REQUIRE(process_until(client, [&]() { return called; }));
+    BOOST_REQUIRE_EQUAL(result, error::success);
+    BOOST_REQUIRE(fetched.is_valid_merkle_root());
+    BOOST_REQUIRE_EQUAL(server.requests("blockchain.fetch_block"), 1u);
+    BOOST_REQUIRE(shared_cache::remove(name));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
 BOOST_AUTO_TEST_SUITE(network)
 
 BOOST_AUTO_TEST_CASE(client__fetch_history4__test)
@@ -104,6 +1179,47 @@ BOOST_AUTO_TEST_CASE(client__subscribe_key__test_ok_and_timeout)
     BOOST_REQUIRE_EQUAL(id, 1);
 }
 
+BOOST_AUTO_TEST_CASE(client__subscribe_key__shared_key_test)
+{
+    CLIENT_TEST_SETUP;
+
+    size_t first_called = 0;
+    size_t second_called = 0;
+
+    auto on_first = [&first_called](const code&, uint16_t, size_t,
+        const hash_digest&)
+    {
+        ++first_called;
+    };
+
+    auto on_second = [&second_called](const code&, uint16_t, size_t,
+        const hash_digest&)
+    {
+        ++second_called;
+    };
+
+    const auto first = client.subscribe_key(on_first, hash_literal(test_key));
+    const auto second = client.subscribe_key(on_second, hash_literal(test_key));
+    BOOST_REQUIRE(first != second);
+
+    // Unsubscribing a shared subscriber completes without the server.
+    auto unsubscribed = false;
+    auto on_unsubscribed = [&unsubscribed](const code& ec)
+    {
+        unsubscribed = (ec == error::success);
+    };
+
+    BOOST_REQUIRE(client.unsubscribe_key(on_unsubscribed, second));
+    BOOST_REQUIRE(unsubscribed);
+
+    client.monitor(0);
+
+    // Each was called for subscription success and then for timeout, except
+    // that the unsubscribed handler was not called for timeout.
+    BOOST_REQUIRE_EQUAL(first_called, 2u);
+    BOOST_REQUIRE_EQUAL(second_called, 1u);
+}
+
 BOOST_AUTO_TEST_CASE(client__unsubscribe_key__test_ok)
 {
     CLIENT_TEST_SETUP;
@@ -196,6 +1312,27 @@ BOOST_AUTO_TEST_CASE(client__fetch_transaction2__test)
     BOOST_REQUIRE_EQUAL(received_hash, expected_hash);
 }
 
+BOOST_AUTO_TEST_CASE(client__fetch_transaction2__witness_free_test)
+{
+    CLIENT_TEST_SETUP;
+    client.set_witness(false);
+
+    const std::string expected_hash = std::string(test_tx_hash);
+
+    std::string received_hash;
+    const auto on_done = [&received_hash](const code& ec, const chain::transaction& tx)
+    {
+        BOOST_REQUIRE_EQUAL(ec, error::success);
+        if (ec == error::success)
+            received_hash = encode_hash(tx.hash());
+    };
+
+    client.blockchain_fetch_transaction2(on_done, hash_literal(test_tx_hash));
+    client.wait();
+
+    BOOST_REQUIRE_EQUAL(received_hash, expected_hash);
+}
+
 BOOST_AUTO_TEST_CASE(client__fetch_unspent_outputs__test)
 {
     CLIENT_TEST_SETUP;
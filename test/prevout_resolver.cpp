@@ -0,0 +1,154 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test_suite.hpp>
+#include <bitcoin/client.hpp>
+
+using namespace bc::client;
+using namespace bc::system;
+
+typedef std::pair<obelisk_client::transaction_handler, hash_digest> request;
+
+// Previous transactions are distinguished by locktime.
+static const chain::transaction previous1{ 1, 1, {},
+    { { 1000, {} }, { 2000, {} } } };
+static const chain::transaction previous2{ 1, 2, {}, { { 5000, {} } } };
+
+// Fetches are held until completed by the test.
+struct fixture
+{
+    std::vector<request> requests;
+
+    prevout_resolver::fetcher fetcher()
+    {
+        return [this](obelisk_client::transaction_handler handler,
+            const hash_digest& tx_hash)
+        {
+            requests.emplace_back(handler, tx_hash);
+        };
+    }
+
+    void complete_all()
+    {
+        std::unordered_map<hash_digest, chain::transaction> known
+        {
+            { previous1.hash(), previous1 },
+            { previous2.hash(), previous2 }
+        };
+
+        while (!requests.empty())
+        {
+            const auto next = requests.front();
+            requests.erase(requests.begin());
+            const auto it = known.find(next.second);
+            if (it == known.end())
+                next.first(error::not_found, {});
+            else
+                next.first(error::success, it->second);
+        }
+    }
+};
+
+static chain::transaction make_spend(uint32_t locktime, uint64_t value)
+{
+    return
+    {
+        1, locktime,
+        {
+            { { previous1.hash(), 1 }, {}, 0 },
+            { { previous2.hash(), 0 }, {}, 0 }
+        },
+        { { value, {} } }
+    };
+}
+
+BOOST_FIXTURE_TEST_SUITE(offline, fixture)
+
+BOOST_AUTO_TEST_CASE(prevout_resolver__resolve__batch__fees_and_coalesced)
+{
+    prevout_resolver resolver(fetcher(), 1);
+    const chain::transaction::list txs
+    {
+        make_spend(10, 6000), make_spend(11, 6500)
+    };
+
+    auto called = false;
+    resolver.resolve([&](const code& ec,
+        const prevout_resolver::resolution::list& resolutions)
+    {
+        called = true;
+        BOOST_REQUIRE(!ec);
+        BOOST_REQUIRE_EQUAL(resolutions.size(), 2u);
+        BOOST_REQUIRE_EQUAL(resolutions[0].values[0], 2000u);
+        BOOST_REQUIRE_EQUAL(resolutions[0].values[1], 5000u);
+        BOOST_REQUIRE_EQUAL(resolutions[0].fee, 1000u);
+        BOOST_REQUIRE_EQUAL(resolutions[1].fee, 500u);
+        BOOST_REQUIRE_GT(resolutions[0].fee_rate, 0.0);
+    }, txs);
+
+    // Only one of the two distinct previous transactions is in flight.
+    BOOST_REQUIRE_EQUAL(requests.size(), 1u);
+    BOOST_REQUIRE_EQUAL(resolver.in_flight(), 1u);
+
+    complete_all();
+    BOOST_REQUIRE(called);
+    BOOST_REQUIRE_EQUAL(resolver.cached(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(prevout_resolver__resolve__cached__no_fetch)
+{
+    prevout_resolver resolver(fetcher());
+    resolver.resolve([](const code&, const prevout_resolver::resolution&) {},
+        make_spend(10, 6000));
+    complete_all();
+
+    auto fee = uint64_t(0);
+    resolver.resolve([&](const code& ec,
+        const prevout_resolver::resolution& result)
+    {
+        BOOST_REQUIRE(!ec);
+        fee = result.fee;
+    }, make_spend(12, 6900));
+
+    BOOST_REQUIRE(requests.empty());
+    BOOST_REQUIRE_EQUAL(fee, 100u);
+}
+
+BOOST_AUTO_TEST_CASE(prevout_resolver__resolve__missing__error)
+{
+    prevout_resolver resolver(fetcher());
+    const chain::transaction orphan{ 1, 0,
+        { { { null_hash, 0 }, {}, 0 } }, {} };
+
+    code result;
+    resolver.resolve([&](const code& ec, const prevout_resolver::resolution&)
+    {
+        result = ec;
+    }, orphan);
+
+    complete_all();
+    BOOST_REQUIRE(result == error::not_found);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
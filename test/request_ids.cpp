@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdint>
+#include <unordered_set>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test_suite.hpp>
+#include <bitcoin/client.hpp>
+
+using namespace bc::client;
+using namespace bc::system;
+
+BOOST_AUTO_TEST_SUITE(offline)
+
+BOOST_AUTO_TEST_CASE(request_ids__allocate__first__one)
+{
+    request_ids ids;
+    BOOST_REQUIRE_EQUAL(ids.allocate(), 1u);
+    BOOST_REQUIRE_EQUAL(ids.allocate(), 2u);
+    BOOST_REQUIRE_EQUAL(ids.size(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(request_ids__allocate__limit__zero)
+{
+    request_ids ids(2);
+    const auto first = ids.allocate();
+    BOOST_REQUIRE_NE(first, 0u);
+    BOOST_REQUIRE_NE(ids.allocate(), 0u);
+    BOOST_REQUIRE_EQUAL(ids.allocate(), 0u);
+    BOOST_REQUIRE(ids.release(first));
+    BOOST_REQUIRE_NE(ids.allocate(), 0u);
+    BOOST_REQUIRE_EQUAL(ids.size(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(request_ids__release__stale__false)
+{
+    request_ids ids;
+    const auto id = ids.allocate();
+    BOOST_REQUIRE(ids.is_allocated(id));
+    BOOST_REQUIRE(ids.release(id));
+    BOOST_REQUIRE(!ids.is_allocated(id));
+    BOOST_REQUIRE(!ids.release(id));
+    BOOST_REQUIRE(!ids.is_allocated(0));
+    BOOST_REQUIRE_EQUAL(ids.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(request_ids__allocate__reused_slot__new_generation)
+{
+    request_ids ids;
+    std::unordered_set<uint32_t> seen;
+
+    // Each allocation is released, so slots are reused after the delay.
+    for (size_t count = 0; count <= request_ids::reuse_delay; ++count)
+    {
+        const auto id = ids.allocate();
+        BOOST_REQUIRE(seen.insert(id).second);
+        BOOST_REQUIRE(ids.release(id));
+    }
+
+    // The first slot is reused with the next generation.
+    const auto reused = ids.allocate();
+    BOOST_REQUIRE(seen.insert(reused).second);
+    BOOST_REQUIRE_EQUAL(reused, (1u << request_ids::slot_bits) + 1u);
+    BOOST_REQUIRE(!ids.is_allocated(1));
+    BOOST_REQUIRE(ids.is_allocated(reused));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
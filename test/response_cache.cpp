@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <thread>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test_suite.hpp>
+#include <bitcoin/client.hpp>
+
+using namespace bc::client;
+using namespace bc::system;
+
+BOOST_AUTO_TEST_SUITE(offline)
+
+static const std::string command = "blockchain.fetch_block_header";
+
+BOOST_AUTO_TEST_CASE(response_cache__find__stored__response)
+{
+    response_cache cache(1000, 60000);
+    const data_chunk request{ 1, 2, 3 };
+    const data_chunk response{ 0, 0, 0, 0, 42 };
+    cache.store(command, request, response);
+
+    data_chunk out;
+    BOOST_REQUIRE(cache.find(command, request, out));
+    BOOST_REQUIRE(out == response);
+    BOOST_REQUIRE(!cache.find(command, { 1, 2 }, out));
+    BOOST_REQUIRE(!cache.find("blockchain.fetch_block", request, out));
+    BOOST_REQUIRE_EQUAL(cache.bytes(), response.size());
+}
+
+BOOST_AUTO_TEST_CASE(response_cache__store__over_capacity__least_recent_evicted)
+{
+    response_cache cache(10, 60000);
+    const data_chunk response(4, 0);
+    cache.store(command, { 1 }, response);
+    cache.store(command, { 2 }, response);
+
+    data_chunk out;
+    BOOST_REQUIRE(cache.find(command, { 1 }, out));
+    cache.store(command, { 3 }, response);
+    BOOST_REQUIRE(cache.find(command, { 1 }, out));
+    BOOST_REQUIRE(!cache.find(command, { 2 }, out));
+    BOOST_REQUIRE(cache.find(command, { 3 }, out));
+    BOOST_REQUIRE_EQUAL(cache.size(), 2u);
+    BOOST_REQUIRE_EQUAL(cache.bytes(), 8u);
+
+    cache.store(command, { 4 }, data_chunk(11, 0));
+    BOOST_REQUIRE(!cache.find(command, { 4 }, out));
+}
+
+BOOST_AUTO_TEST_CASE(response_cache__find__expired__false)
+{
+    response_cache cache(1000, 1);
+    cache.store(command, { 1 }, { 0, 0, 0, 0 });
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    data_chunk out;
+    BOOST_REQUIRE(!cache.find(command, { 1 }, out));
+    BOOST_REQUIRE_EQUAL(cache.size(), 0u);
+    BOOST_REQUIRE_EQUAL(cache.bytes(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
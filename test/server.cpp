@@ -0,0 +1,167 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "server.hpp"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <bitcoin/protocol.hpp>
+#include <bitcoin/system.hpp>
+
+using namespace bc::protocol;
+using namespace bc::system;
+
+namespace test {
+
+static constexpr int32_t poll_milliseconds = 1;
+
+server::server(const std::string& endpoint, responder respond,
+    const std::string& stream)
+  : respond_(respond), stopped_(false), started_(false)
+{
+    thread_ = std::thread([=]() { run(endpoint, stream); });
+
+    // Sockets are bound on the server thread before clients connect.
+    while (!started_)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+server::~server()
+{
+    stopped_ = true;
+    thread_.join();
+}
+
+void server::notify(const request& origin, const std::string& command,
+    const data_chunk& payload)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    notifications_.push_back({ origin, { command, payload } });
+}
+
+void server::publish(const data_stack& frames)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    publications_.push_back(frames);
+}
+
+size_t server::requests(const std::string& command) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto count = counts_.find(command);
+    return count == counts_.end() ? 0 : count->second;
+}
+
+std::vector<server::request> server::received() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return received_;
+}
+
+// private
+//-----------------------------------------------------------------------------
+
+// The sockets are used only by the server thread.
+void server::run(const std::string& endpoint, const std::string& stream)
+{
+    zmq::socket router(context_, zmq::socket::role::router);
+    zmq::socket publisher(context_, zmq::socket::role::publisher);
+    const auto bound = !router.bind(endpoint) &&
+        (stream.empty() || !publisher.bind(stream));
+    started_ = true;
+
+    if (!bound)
+        return;
+
+    zmq::poller poller;
+    poller.add(router);
+
+    while (!stopped_)
+    {
+        decltype(notifications_) notifications;
+        decltype(publications_) publications;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            notifications.swap(notifications_);
+            publications.swap(publications_);
+        }
+
+        for (const auto& notification: notifications)
+            reply(router, notification.first, notification.second.first,
+                notification.second.second);
+
+        for (const auto& frames: publications)
+        {
+            zmq::message message;
+            for (const auto& frame: frames)
+                message.enqueue(frame);
+
+            publisher.send(message);
+        }
+
+        if (!poller.wait(poll_milliseconds).contains(router.id()))
+            continue;
+
+        zmq::message message;
+        if (router.receive(message))
+            continue;
+
+        request origin;
+        origin.delimited = false;
+        origin.id = 0;
+        message.dequeue(origin.identity);
+
+        if (message.size() == 4)
+        {
+            message.dequeue();
+            origin.delimited = true;
+        }
+
+        if (!message.dequeue(origin.command) || !message.dequeue(origin.id) ||
+            !message.dequeue(origin.payload))
+            continue;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            received_.push_back(origin);
+            ++counts_[origin.command];
+        }
+
+        data_chunk payload;
+        if (respond_(origin, payload))
+            reply(router, origin, origin.command, payload);
+    }
+}
+
+void server::reply(zmq::socket& router, const request& origin,
+    const std::string& command, const data_chunk& payload)
+{
+    zmq::message message;
+    message.enqueue(origin.identity);
+
+    if (origin.delimited)
+        message.enqueue();
+
+    message.enqueue(to_chunk(command));
+    message.enqueue(to_chunk(to_little_endian(origin.id)));
+    message.enqueue(payload);
+    router.send(message);
+}
+
+} // namespace test
@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_CLIENT_TEST_SERVER_HPP
+#define LIBBITCOIN_CLIENT_TEST_SERVER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <bitcoin/protocol.hpp>
+#include <bitcoin/system.hpp>
+
+namespace test {
+
+/// A server which answers requests on its own thread, for offline tests.
+class server
+{
+public:
+    struct request
+    {
+        bc::system::data_chunk identity;
+        bool delimited;
+        std::string command;
+        uint32_t id;
+        bc::system::data_chunk payload;
+    };
+
+    /// Sets the response payload, or returns false to withhold it.
+    typedef std::function<bool(const request&,
+        bc::system::data_chunk& out_payload)> responder;
+
+    /// Binds a router to endpoint and, if not empty, a publisher to stream.
+    server(const std::string& endpoint, responder respond,
+        const std::string& stream="");
+    ~server();
+
+    /// Sends an unsolicited message to the origin of an earlier request.
+    void notify(const request& origin, const std::string& command,
+        const bc::system::data_chunk& payload);
+
+    /// Publishes a stream message of the given frames.
+    void publish(const bc::system::data_stack& frames);
+
+    /// The number of requests received of the command.
+    size_t requests(const std::string& command) const;
+
+    /// The requests received, in order.
+    std::vector<request> received() const;
+
+private:
+    typedef std::function<void()> action;
+
+    void run(const std::string& endpoint, const std::string& stream);
+    void reply(bc::protocol::zmq::socket& router, const request& origin,
+        const std::string& command, const bc::system::data_chunk& payload);
+
+    responder respond_;
+    std::atomic<bool> stopped_;
+    std::atomic<bool> started_;
+
+    mutable std::mutex mutex_;
+    std::vector<request> received_;
+    std::unordered_map<std::string, size_t> counts_;
+    std::vector<std::pair<request, std::pair<std::string,
+        bc::system::data_chunk>>> notifications_;
+    std::vector<bc::system::data_stack> publications_;
+
+    bc::protocol::zmq::context context_;
+    std::thread thread_;
+};
+
+} // namespace test
+
+#endif
@@ -0,0 +1,229 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <string>
+#include <thread>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test_suite.hpp>
+#include <bitcoin/client.hpp>
+#include "server.hpp"
+
+using namespace bc::client;
+using namespace bc::system;
+
+BOOST_AUTO_TEST_SUITE(offline)
+
+static std::string local_url(uint16_t port)
+{
+    return "tcp://127.0.0.1:" + std::to_string(port);
+}
+
+static data_chunk error_payload(const code& ec)
+{
+    return to_chunk(to_little_endian(static_cast<uint32_t>(ec.value())));
+}
+
+static bool answer_success(const test::server::request& request,
+    data_chunk& out)
+{
+    out = request.command == "blockchain.fetch_last_height" ?
+        build_chunk({ error_payload(error::success),
+            to_little_endian<uint32_t>(42) }) :
+        error_payload(error::success);
+    return true;
+}
+
+// Shards run on their own threads, so their effects are awaited.
+static bool wait_until(const std::function<bool()>& condition)
+{
+    const auto limit = std::chrono::steady_clock::now() +
+        std::chrono::seconds(1);
+
+    while (!condition())
+    {
+        if (std::chrono::steady_clock::now() >= limit)
+            return false;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(sharded_client__shards__zero__at_least_one)
+{
+    sharded_client client(0);
+    BOOST_REQUIRE_GE(client.shards(), 1u);
+    BOOST_REQUIRE_EQUAL(client.requests_outstanding(), 0u);
+    BOOST_REQUIRE_EQUAL(client.memory_usage(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(sharded_client__unsubscribe_key__unknown__false)
+{
+    sharded_client client(2);
+    BOOST_REQUIRE(!client.unsubscribe_key([](const code&) {}, 42));
+}
+
+BOOST_AUTO_TEST_CASE(sharded_client__blockchain_fetch_last_height__no_response__channel_timeout)
+{
+    static const config::endpoint server("tcp://localhost:9091");
+    sharded_client client(2, 0, 10);
+    BOOST_REQUIRE(client.connect(server));
+
+    std::promise<code> first;
+    std::promise<code> second;
+    client.blockchain_fetch_last_height([&](const code& ec, size_t)
+    {
+        first.set_value(ec);
+    });
+    client.blockchain_fetch_last_height([&](const code& ec, size_t)
+    {
+        second.set_value(ec);
+    });
+
+    BOOST_REQUIRE_EQUAL(first.get_future().get(), error::channel_timeout);
+    BOOST_REQUIRE_EQUAL(second.get_future().get(), error::channel_timeout);
+    BOOST_REQUIRE_EQUAL(client.requests_outstanding(), 0u);
+    client.stop();
+}
+
+BOOST_AUTO_TEST_CASE(sharded_client__blockchain_fetch_last_height__four__spread_over_shards)
+{
+    test::server server(local_url(9344), answer_success);
+    sharded_client client(2, 0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9344))));
+
+    // Handlers run on the threads of the shards, so only count results.
+    std::promise<void> done;
+    std::atomic<size_t> completed(0);
+    std::atomic<size_t> answered(0);
+    for (size_t fetch = 0; fetch < 4; ++fetch)
+    {
+        client.blockchain_fetch_last_height([&](const code& ec, size_t height)
+        {
+            if (!ec && height == 42)
+                ++answered;
+
+            if (++completed == 4)
+                done.set_value();
+        });
+    }
+
+    done.get_future().get();
+    client.stop();
+    BOOST_REQUIRE_EQUAL(answered.load(), 4u);
+
+    // Each shard has its own connection, so its own identity.
+    std::map<data_chunk, size_t> shards;
+    for (const auto& request: server.received())
+        ++shards[request.identity];
+
+    BOOST_REQUIRE_EQUAL(shards.size(), 2u);
+    BOOST_REQUIRE_EQUAL(shards.begin()->second, 2u);
+    BOOST_REQUIRE_EQUAL(shards.rbegin()->second, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(sharded_client__subscribe_key__two_subscribers__one_server_subscription)
+{
+    static const auto key = sha256_hash(to_chunk(std::string("key")));
+    test::server server(local_url(9345), answer_success);
+    sharded_client client(4, 0);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9345))));
+
+    const auto ignore = [](const code&, uint16_t, size_t, const hash_digest&)
+    {
+    };
+
+    const auto first = client.subscribe_key(ignore, key);
+    const auto second = client.subscribe_key(ignore, key);
+    BOOST_REQUIRE(first != obelisk_client::null_subscription);
+    BOOST_REQUIRE(second != obelisk_client::null_subscription);
+    BOOST_REQUIRE(first != second);
+    BOOST_REQUIRE(wait_until([&]()
+    {
+        return server.requests("subscribe.key") == 1;
+    }));
+
+    // Both subscribers of the key are on the one shard of the key.
+    BOOST_REQUIRE(client.unsubscribe_key([](const code&) {}, first));
+    BOOST_REQUIRE(client.unsubscribe_key([](const code&) {}, second));
+    BOOST_REQUIRE(!client.unsubscribe_key([](const code&) {}, second));
+    BOOST_REQUIRE(wait_until([&]()
+    {
+        return server.requests("unsubscribe.key") == 1;
+    }));
+
+    client.stop();
+    BOOST_REQUIRE_EQUAL(server.requests("subscribe.key"), 1u);
+    std::map<data_chunk, size_t> shards;
+    for (const auto& request: server.received())
+        ++shards[request.identity];
+
+    BOOST_REQUIRE_EQUAL(shards.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(sharded_client__blockchain_fetch_block__withheld__usage_aggregated)
+{
+    static const std::string command = "blockchain.fetch_block";
+    test::server server(local_url(9346),
+        [](const test::server::request&, data_chunk&)
+        {
+            return false;
+        });
+
+    sharded_client client(2, 0);
+    client.set_memory_budget(100000000);
+    BOOST_REQUIRE(client.connect(config::endpoint(local_url(9346))));
+
+    std::promise<void> done;
+    std::atomic<size_t> completed(0);
+    std::atomic<size_t> not_found(0);
+    for (size_t fetch = 0; fetch < 2; ++fetch)
+    {
+        client.blockchain_fetch_block([&](const code& ec, const chain::block&)
+        {
+            if (ec == error::not_found)
+                ++not_found;
+
+            if (++completed == 2)
+                done.set_value();
+        }, sha256_hash(to_chunk(std::to_string(fetch))));
+    }
+
+    BOOST_REQUIRE(wait_until([&]() { return server.requests(command) == 2; }));
+    BOOST_REQUIRE_EQUAL(client.requests_outstanding(), 2u);
+    BOOST_REQUIRE_GT(client.memory_usage(), 0u);
+
+    for (const auto& request: server.received())
+        server.notify(request, command, error_payload(error::not_found));
+
+    done.get_future().get();
+    BOOST_REQUIRE_EQUAL(not_found.load(), 2u);
+    BOOST_REQUIRE_EQUAL(client.requests_outstanding(), 0u);
+    BOOST_REQUIRE(wait_until([&]() { return client.memory_usage() == 0; }));
+    client.stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,141 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstddef>
+#include <string>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test_suite.hpp>
+#include <bitcoin/client.hpp>
+
+using namespace bc::client;
+using namespace bc::system;
+
+BOOST_AUTO_TEST_SUITE(offline)
+
+static hash_digest key(size_t index)
+{
+    return sha256_hash(to_chunk(std::to_string(index)));
+}
+
+BOOST_AUTO_TEST_CASE(shared_cache__store__second_instance__found)
+{
+    static const std::string name = "libbitcoin_client_test_shared_cache_1";
+    static const data_chunk data{ 0x01, 0x02, 0x03 };
+    shared_cache::remove(name);
+
+    shared_cache first(name, 16, 1024);
+    shared_cache second(name);
+    BOOST_REQUIRE(first.valid());
+    BOOST_REQUIRE(second.valid());
+    BOOST_REQUIRE_EQUAL(second.capacity(), 1024u);
+
+    data_chunk out;
+    BOOST_REQUIRE(!second.find(shared_cache::entry::block, key(0), out));
+    BOOST_REQUIRE(first.store(shared_cache::entry::block, key(0), data));
+    BOOST_REQUIRE(second.find(shared_cache::entry::block, key(0), out));
+    BOOST_REQUIRE(out == data);
+    BOOST_REQUIRE(!second.find(shared_cache::entry::header, key(0), out));
+
+    BOOST_REQUIRE(second.store(shared_cache::entry::block, key(0), data));
+    BOOST_REQUIRE_EQUAL(first.size(), 1u);
+    BOOST_REQUIRE_EQUAL(second.bytes(), 8u);
+    BOOST_REQUIRE(shared_cache::remove(name));
+}
+
+BOOST_AUTO_TEST_CASE(shared_cache__store__full__dropped)
+{
+    static const std::string name = "libbitcoin_client_test_shared_cache_2";
+    static const data_chunk data(16, 0x2a);
+    shared_cache::remove(name);
+
+    shared_cache cache(name, 2, 1024);
+    BOOST_REQUIRE(cache.valid());
+    BOOST_REQUIRE(cache.store(shared_cache::entry::header, key(0), data));
+    BOOST_REQUIRE(cache.store(shared_cache::entry::header, key(1), data));
+    BOOST_REQUIRE(!cache.store(shared_cache::entry::header, key(2), data));
+    BOOST_REQUIRE(!cache.store(shared_cache::entry::block, key(3),
+        data_chunk(2048, 0x2a)));
+    BOOST_REQUIRE_EQUAL(cache.size(), 2u);
+    BOOST_REQUIRE_EQUAL(cache.dropped(), 2u);
+
+    data_chunk out;
+    BOOST_REQUIRE(cache.find(shared_cache::entry::header, key(1), out));
+    BOOST_REQUIRE(!cache.find(shared_cache::entry::header, key(2), out));
+    BOOST_REQUIRE(shared_cache::remove(name));
+}
+
+BOOST_AUTO_TEST_CASE(shared_cache__store__arena_full__smaller_stored)
+{
+    static const std::string name = "libbitcoin_client_test_shared_cache_5";
+    shared_cache::remove(name);
+
+    shared_cache cache(name, 16, 64);
+    BOOST_REQUIRE(cache.valid());
+    BOOST_REQUIRE(cache.store(shared_cache::entry::block, key(0),
+        data_chunk(48, 0x2a)));
+    BOOST_REQUIRE(!cache.store(shared_cache::entry::block, key(1),
+        data_chunk(32, 0x2a)));
+    BOOST_REQUIRE(cache.store(shared_cache::entry::block, key(2),
+        data_chunk(16, 0x2a)));
+    BOOST_REQUIRE_EQUAL(cache.bytes(), 64u);
+    BOOST_REQUIRE_EQUAL(cache.dropped(), 1u);
+
+    data_chunk out;
+    BOOST_REQUIRE(!cache.find(shared_cache::entry::block, key(1), out));
+    BOOST_REQUIRE(cache.find(shared_cache::entry::block, key(2), out));
+    BOOST_REQUIRE(shared_cache::remove(name));
+}
+
+BOOST_AUTO_TEST_CASE(shared_cache__store__table_full__arena_unused)
+{
+    static const std::string name = "libbitcoin_client_test_shared_cache_6";
+    static const data_chunk data(16, 0x2a);
+    shared_cache::remove(name);
+
+    shared_cache cache(name, 2, 1024);
+    BOOST_REQUIRE(cache.valid());
+    BOOST_REQUIRE(cache.store(shared_cache::entry::header, key(0), data));
+    BOOST_REQUIRE(cache.store(shared_cache::entry::header, key(1), data));
+    BOOST_REQUIRE(!cache.store(shared_cache::entry::header, key(2), data));
+    BOOST_REQUIRE_EQUAL(cache.bytes(), 32u);
+
+    data_chunk out;
+    BOOST_REQUIRE(!cache.find(shared_cache::entry::header, key(2), out));
+    BOOST_REQUIRE(shared_cache::remove(name));
+}
+
+BOOST_AUTO_TEST_CASE(shared_cache__find_header__hash_mismatch__false)
+{
+    static const std::string name = "libbitcoin_client_test_shared_cache_3";
+    static const chain::header header{ 1, null_hash, null_hash, 0, 0, 0 };
+    shared_cache::remove(name);
+
+    shared_cache cache(name, 16, 1024);
+    BOOST_REQUIRE(cache.valid());
+    BOOST_REQUIRE(cache.store(shared_cache::entry::header, key(0),
+        header.to_data()));
+
+    chain::header out;
+    BOOST_REQUIRE(!cache.find_header(key(0), out));
+    BOOST_REQUIRE(cache.store_header(header));
+    BOOST_REQUIRE(cache.find_header(header.hash(), out));
+    BOOST_REQUIRE(out == header);
+    BOOST_REQUIRE(shared_cache::remove(name));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
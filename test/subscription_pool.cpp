@@ -0,0 +1,252 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test_suite.hpp>
+#include <bitcoin/client.hpp>
+#include "server.hpp"
+
+using namespace bc::client;
+using namespace bc::system;
+
+BOOST_AUTO_TEST_SUITE(offline)
+
+static const config::endpoint first_server("tcp://localhost:9091");
+static const config::endpoint second_server("tcp://localhost:9092");
+
+static connection_settings settings(const config::endpoint& server)
+{
+    connection_settings value;
+    value.retries = 0;
+    value.server = server;
+    return value;
+}
+
+static hash_digest key(size_t index)
+{
+    return sha256_hash(to_chunk(std::to_string(index)));
+}
+
+static void ignore(const code&, const hash_digest&, uint16_t, size_t,
+    const hash_digest&)
+{
+}
+
+static std::string local_url(uint16_t port)
+{
+    return "tcp://127.0.0.1:" + std::to_string(port);
+}
+
+static bool answer_success(const test::server::request&, data_chunk& out)
+{
+    out = to_chunk(to_little_endian(static_cast<uint32_t>(error::success)));
+    return true;
+}
+
+static data_chunk error_payload(const code& ec)
+{
+    return to_chunk(to_little_endian(static_cast<uint32_t>(ec.value())));
+}
+
+// The last received request of the command.
+static test::server::request last_request(const test::server& server,
+    const std::string& command)
+{
+    test::server::request last;
+    for (const auto& request: server.received())
+        if (request.command == command)
+            last = request;
+
+    return last;
+}
+
+// Runs ready handlers until the condition holds or a second elapses.
+static bool run_until(asio::service& service,
+    const std::function<bool()>& condition)
+{
+    const auto limit = std::chrono::steady_clock::now() +
+        std::chrono::seconds(1);
+
+    while (!condition())
+    {
+        if (std::chrono::steady_clock::now() >= limit)
+            return false;
+
+        service.restart();
+        service.poll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(subscription_pool__subscribe_key__no_server__deferred)
+{
+    asio::service service;
+    subscription_pool pool(service, ignore);
+    BOOST_REQUIRE(pool.subscribe_key(key(0)));
+    BOOST_REQUIRE(!pool.subscribe_key(key(0)));
+    BOOST_REQUIRE_EQUAL(pool.keys(), 1u);
+
+    BOOST_REQUIRE(pool.add_server(settings(first_server)));
+    BOOST_REQUIRE_EQUAL(pool.keys(first_server), 1u);
+    BOOST_REQUIRE(pool.unsubscribe_key(key(0)));
+    BOOST_REQUIRE(!pool.unsubscribe_key(key(0)));
+    BOOST_REQUIRE_EQUAL(pool.keys(first_server), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(subscription_pool__add_server__rebalance__keys_shared)
+{
+    static const size_t count = 200;
+    asio::service service;
+    subscription_pool pool(service, ignore);
+    BOOST_REQUIRE(pool.add_server(settings(first_server)));
+
+    for (size_t index = 0; index < count; ++index)
+        BOOST_REQUIRE(pool.subscribe_key(key(index)));
+
+    BOOST_REQUIRE_EQUAL(pool.keys(first_server), count);
+    BOOST_REQUIRE(pool.add_server(settings(second_server)));
+    BOOST_REQUIRE(!pool.add_server(settings(second_server)));
+    BOOST_REQUIRE_EQUAL(pool.servers(), 2u);
+    BOOST_REQUIRE_GT(pool.keys(first_server), 0u);
+    BOOST_REQUIRE_GT(pool.keys(second_server), 0u);
+    BOOST_REQUIRE_EQUAL(pool.keys(first_server) + pool.keys(second_server),
+        count);
+}
+
+BOOST_AUTO_TEST_CASE(subscription_pool__remove_server__rebalance__keys_moved)
+{
+    static const size_t count = 200;
+    asio::service service;
+    subscription_pool pool(service, ignore);
+    BOOST_REQUIRE(pool.add_server(settings(first_server)));
+    BOOST_REQUIRE(pool.add_server(settings(second_server)));
+
+    for (size_t index = 0; index < count; ++index)
+        BOOST_REQUIRE(pool.subscribe_key(key(index)));
+
+    BOOST_REQUIRE(pool.remove_server(second_server));
+    BOOST_REQUIRE(!pool.remove_server(second_server));
+    BOOST_REQUIRE_EQUAL(pool.servers(), 1u);
+    BOOST_REQUIRE_EQUAL(pool.keys(first_server), count);
+    BOOST_REQUIRE_EQUAL(pool.keys(second_server), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(subscription_pool__subscribe_key__error__resubscribed)
+{
+    test::server server(local_url(9327), answer_success);
+    const config::endpoint endpoint(local_url(9327));
+    asio::service service;
+
+    size_t errors = 0;
+    subscription_pool pool(service, [&](const code& ec, const hash_digest&,
+        uint16_t, size_t, const hash_digest&)
+    {
+        if (ec)
+            ++errors;
+    });
+
+    BOOST_REQUIRE(pool.add_server(settings(endpoint)));
+    BOOST_REQUIRE(pool.subscribe_key(key(0)));
+    BOOST_REQUIRE(run_until(service, [&]()
+    {
+        return server.requests("subscribe.key") == 1;
+    }));
+
+    server.notify(last_request(server, "subscribe.key"), "notification.key",
+        error_payload(error::not_found));
+    BOOST_REQUIRE(run_until(service, [&]()
+    {
+        return server.requests("subscribe.key") == 2;
+    }));
+
+    BOOST_REQUIRE_EQUAL(errors, 1u);
+    BOOST_REQUIRE_EQUAL(pool.servers(), 1u);
+    BOOST_REQUIRE_EQUAL(pool.keys(endpoint), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(subscription_pool__subscribe_key__repeated_errors__server_removed)
+{
+    test::server server(local_url(9328), answer_success);
+    const config::endpoint endpoint(local_url(9328));
+    asio::service service;
+
+    size_t errors = 0;
+    subscription_pool pool(service, [&](const code& ec, const hash_digest&,
+        uint16_t, size_t, const hash_digest&)
+    {
+        if (ec)
+            ++errors;
+    }, subscription_pool::default_replicas, 2);
+
+    BOOST_REQUIRE(pool.add_server(settings(endpoint)));
+    BOOST_REQUIRE(pool.subscribe_key(key(0)));
+
+    for (size_t attempt = 1; attempt <= 2; ++attempt)
+    {
+        BOOST_REQUIRE(run_until(service, [&]()
+        {
+            return server.requests("subscribe.key") == attempt;
+        }));
+
+        server.notify(last_request(server, "subscribe.key"),
+            "notification.key", error_payload(error::not_found));
+    }
+
+    BOOST_REQUIRE(run_until(service, [&]() { return pool.servers() == 0; }));
+    BOOST_REQUIRE_EQUAL(errors, 2u);
+    BOOST_REQUIRE_EQUAL(pool.keys(), 1u);
+    BOOST_REQUIRE_EQUAL(pool.keys(endpoint), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(subscription_pool__subscribe_key__ids_exhausted__server_removed)
+{
+    test::server server(local_url(9342), answer_success);
+    const config::endpoint endpoint(local_url(9342));
+    asio::service service;
+
+    size_t errors = 0;
+    subscription_pool pool(service, [&](const code& ec, const hash_digest&,
+        uint16_t, size_t, const hash_digest&)
+    {
+        if (ec)
+            ++errors;
+    }, subscription_pool::default_replicas,
+        subscription_pool::default_error_limit, 2);
+
+    // The third key fails before subscribe returns, as do its retries.
+    BOOST_REQUIRE(pool.add_server(settings(endpoint)));
+    BOOST_REQUIRE(pool.subscribe_key(key(0)));
+    BOOST_REQUIRE(pool.subscribe_key(key(1)));
+    BOOST_REQUIRE_EQUAL(pool.keys(endpoint), 2u);
+    BOOST_REQUIRE(pool.subscribe_key(key(2)));
+
+    BOOST_REQUIRE_EQUAL(errors, subscription_pool::default_error_limit);
+    BOOST_REQUIRE_EQUAL(pool.servers(), 0u);
+    BOOST_REQUIRE_EQUAL(pool.keys(), 3u);
+    BOOST_REQUIRE_EQUAL(pool.keys(endpoint), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test_suite.hpp>
+#include <bitcoin/client.hpp>
+
+using namespace bc::client;
+using namespace bc::system;
+
+static const size_t top = 999;
+
+// Timestamps increase by ten with jitter, so are not monotonic.
+static uint32_t timestamp(size_t height)
+{
+    return static_cast<uint32_t>(1000 + 10 * height + (height % 7) * 13);
+}
+
+static uint32_t expected_median(size_t height)
+{
+    std::vector<uint32_t> window;
+    for (auto index = height < 10 ? 0 : height - 10; index <= height; ++index)
+        window.push_back(timestamp(index));
+
+    std::sort(window.begin(), window.end());
+    return window[window.size() / 2];
+}
+
+struct fixture
+{
+    size_t fetches = 0;
+
+    time_index::header_fetcher fetch_header()
+    {
+        return [this](obelisk_client::block_header_handler handler,
+            uint32_t height)
+        {
+            ++fetches;
+            handler(error::success, { 1, null_hash, null_hash,
+                timestamp(height), 0, 0 });
+        };
+    }
+
+    time_index::top_fetcher fetch_top()
+    {
+        return [](obelisk_client::height_handler handler)
+        {
+            handler(error::success, top);
+        };
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(offline, fixture)
+
+BOOST_AUTO_TEST_CASE(time_index__find_height__median_time_past__first_after)
+{
+    time_index index(fetch_header(), fetch_top());
+
+    for (const uint32_t time: { 0u, 1500u, 5000u, 9000u, 10980u })
+    {
+        size_t expected = 0;
+        while (expected <= top && expected_median(expected) <= time)
+            ++expected;
+
+        auto called = false;
+        index.find_height([&](const code& ec, size_t height)
+        {
+            called = true;
+            BOOST_REQUIRE(!ec);
+            BOOST_REQUIRE_EQUAL(height, expected);
+        }, time);
+
+        BOOST_REQUIRE(called);
+    }
+
+    // Only windows around probes are fetched.
+    BOOST_REQUIRE_LT(fetches, top / 2);
+    BOOST_REQUIRE_EQUAL(index.size(), fetches);
+}
+
+BOOST_AUTO_TEST_CASE(time_index__find_height__after_top__not_found)
+{
+    time_index index(fetch_header(), fetch_top());
+    code result;
+    index.find_height([&](const code& ec, size_t)
+    {
+        result = ec;
+    }, max_uint32);
+
+    BOOST_REQUIRE(result == error::not_found);
+}
+
+BOOST_AUTO_TEST_CASE(time_index__median_time_past__cached__median)
+{
+    time_index index(fetch_header(), fetch_top());
+    for (size_t height = 0; height <= 20; ++height)
+        index.store(height, timestamp(height));
+
+    uint32_t time;
+    BOOST_REQUIRE(index.median_time_past(20, time));
+    BOOST_REQUIRE_EQUAL(time, expected_median(20));
+    BOOST_REQUIRE(!index.median_time_past(21, time));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
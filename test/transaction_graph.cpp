@@ -0,0 +1,204 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test_suite.hpp>
+#include <bitcoin/client.hpp>
+
+using namespace bc::client;
+using namespace bc::system;
+
+// Transactions are distinguished by locktime: b spends a:0, c spends a:1 and
+// b:0, and both outputs of c are unspent.
+static const chain::transaction tx_a{ 1, 1, {}, { { 1, {} }, { 2, {} } } };
+static const chain::transaction tx_b{ 1, 2,
+    { { { tx_a.hash(), 0 }, {}, 0 } }, { { 1, {} } } };
+static const chain::transaction tx_c{ 1, 3,
+    { { { tx_a.hash(), 1 }, {}, 0 }, { { tx_b.hash(), 0 }, {}, 0 } },
+    { { 1, {} }, { 2, {} } } };
+
+static void fetch_transaction(obelisk_client::transaction_handler handler,
+    const hash_digest& tx_hash)
+{
+    for (const auto& tx: { tx_a, tx_b, tx_c })
+    {
+        if (tx.hash() == tx_hash)
+        {
+            handler(error::success, tx);
+            return;
+        }
+    }
+
+    handler(error::not_found, {});
+}
+
+static void fetch_spend(obelisk_client::spend_handler handler,
+    const chain::output_point& outpoint)
+{
+    for (const auto& tx: { tx_b, tx_c })
+    {
+        const auto& inputs = tx.inputs();
+        for (uint32_t index = 0; index < inputs.size(); ++index)
+        {
+            if (inputs[index].previous_output() == outpoint)
+            {
+                handler(error::success, { tx.hash(), index });
+                return;
+            }
+        }
+    }
+
+    handler(error::not_found, {});
+}
+
+static bool has_edge(const transaction_graph::graph& result,
+    const hash_digest& from, const hash_digest& to)
+{
+    for (uint32_t node = 0; node < result.nodes.size(); ++node)
+        if (result.nodes[node] == from)
+            for (auto edge = result.offsets[node];
+                edge < result.offsets[node + 1]; ++edge)
+                if (result.nodes[result.edges[edge]] == to)
+                    return true;
+
+    return false;
+}
+
+BOOST_AUTO_TEST_SUITE(offline)
+
+BOOST_AUTO_TEST_CASE(transaction_graph__walk__ancestors__subgraph)
+{
+    transaction_graph walker(fetch_transaction, fetch_spend, 1);
+    auto called = false;
+
+    walker.walk([&](const code& ec, const transaction_graph::graph& result)
+    {
+        called = true;
+        BOOST_REQUIRE(!ec);
+        BOOST_REQUIRE_EQUAL(result.nodes.size(), 3u);
+        BOOST_REQUIRE(result.nodes[0] == tx_c.hash());
+        BOOST_REQUIRE_EQUAL(result.edges.size(), 3u);
+        BOOST_REQUIRE(has_edge(result, tx_c.hash(), tx_a.hash()));
+        BOOST_REQUIRE(has_edge(result, tx_c.hash(), tx_b.hash()));
+        BOOST_REQUIRE(has_edge(result, tx_b.hash(), tx_a.hash()));
+    }, tx_c.hash(), transaction_graph::direction::ancestors, 2);
+
+    BOOST_REQUIRE(called);
+}
+
+BOOST_AUTO_TEST_CASE(transaction_graph__walk__descendants_depth_one__children)
+{
+    transaction_graph walker(fetch_transaction, fetch_spend);
+    auto called = false;
+
+    walker.walk([&](const code& ec, const transaction_graph::graph& result)
+    {
+        called = true;
+        BOOST_REQUIRE(!ec);
+        BOOST_REQUIRE_EQUAL(result.nodes.size(), 3u);
+        BOOST_REQUIRE_EQUAL(result.edges.size(), 2u);
+        BOOST_REQUIRE(has_edge(result, tx_a.hash(), tx_b.hash()));
+        BOOST_REQUIRE(has_edge(result, tx_a.hash(), tx_c.hash()));
+        BOOST_REQUIRE(!has_edge(result, tx_b.hash(), tx_c.hash()));
+    }, tx_a.hash(), transaction_graph::direction::descendants, 1);
+
+    BOOST_REQUIRE(called);
+}
+
+BOOST_AUTO_TEST_CASE(transaction_graph__walk__missing_root__error)
+{
+    transaction_graph walker(fetch_transaction, fetch_spend);
+    code result;
+
+    walker.walk([&](const code& ec, const transaction_graph::graph&)
+    {
+        result = ec;
+    }, null_hash, transaction_graph::direction::ancestors, 3);
+
+    BOOST_REQUIRE(result == error::not_found);
+}
+
+BOOST_AUTO_TEST_CASE(transaction_graph__walk__shorter_path_later__expanded)
+{
+    // r spends a:0 and b:0, a spends c:0, c spends x:0, b spends x:1 and x
+    // spends y:0, so x is at depth 3 through a and c but 2 through b.
+    static const chain::transaction y{ 1, 10, {}, { { 1, {} } } };
+    static const chain::transaction x{ 1, 11,
+        { { { y.hash(), 0 }, {}, 0 } }, { { 1, {} }, { 2, {} } } };
+    static const chain::transaction c{ 1, 12,
+        { { { x.hash(), 0 }, {}, 0 } }, { { 1, {} } } };
+    static const chain::transaction a{ 1, 13,
+        { { { c.hash(), 0 }, {}, 0 } }, { { 1, {} } } };
+    static const chain::transaction b{ 1, 14,
+        { { { x.hash(), 1 }, {}, 0 } }, { { 1, {} } } };
+    static const chain::transaction r{ 1, 15,
+        { { { a.hash(), 0 }, {}, 0 }, { { b.hash(), 0 }, {}, 0 } },
+        { { 1, {} } } };
+
+    typedef std::pair<obelisk_client::transaction_handler, hash_digest> fetch;
+    std::vector<fetch> pending;
+
+    transaction_graph walker([&](obelisk_client::transaction_handler handler,
+        const hash_digest& tx_hash)
+    {
+        pending.emplace_back(handler, tx_hash);
+    }, fetch_spend, 4);
+
+    auto called = false;
+    walker.walk([&](const code& ec, const transaction_graph::graph& result)
+    {
+        called = true;
+        BOOST_REQUIRE(!ec);
+        BOOST_REQUIRE_EQUAL(result.nodes.size(), 6u);
+        BOOST_REQUIRE(has_edge(result, x.hash(), y.hash()));
+
+        for (uint32_t node = 0; node < result.nodes.size(); ++node)
+        {
+            if (result.nodes[node] == x.hash())
+                BOOST_REQUIRE_EQUAL(result.depths[node], 2u);
+
+            if (result.nodes[node] == y.hash())
+                BOOST_REQUIRE_EQUAL(result.depths[node], 3u);
+        }
+    }, r.hash(), transaction_graph::direction::ancestors, 3);
+
+    // Fetches complete in order, except that of b, which completes last.
+    while (!pending.empty())
+    {
+        auto next = std::find_if(pending.begin(), pending.end(),
+            [](const fetch& value) { return value.second != b.hash(); });
+
+        if (next == pending.end())
+            next = pending.begin();
+
+        const auto fetched = *next;
+        pending.erase(next);
+
+        for (const auto& tx: { y, x, c, a, b, r })
+            if (tx.hash() == fetched.second)
+                fetched.first(error::success, tx);
+    }
+
+    BOOST_REQUIRE(called);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
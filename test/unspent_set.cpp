@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) 2011-2019 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdint>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test_suite.hpp>
+#include <bitcoin/client.hpp>
+
+using namespace bc::client;
+using namespace bc::system;
+
+static const chain::script watched_script{ { 0x51 }, false };
+static const auto watched_key = sha256_hash(watched_script.to_data(false));
+static const hash_digest funding_hash = sha256_hash({ 0x42 });
+
+static history make_row(uint32_t index, uint64_t value, bool spent)
+{
+    const chain::input_point spend = spent ?
+        chain::input_point{ sha256_hash({ 0x43 }), 0 } :
+        chain::input_point{ null_hash, chain::point::null_index };
+
+    return { { funding_hash, index }, 10, value, spend, spent ? 11 : max_uint64 };
+}
+
+BOOST_AUTO_TEST_SUITE(offline)
+
+BOOST_AUTO_TEST_CASE(unspent_set__load__history__unspent_only)
+{
+    unspent_set set;
+    set.load(watched_key, { make_row(0, 100, false), make_row(1, 200, true),
+        make_row(2, 300, false) });
+
+    BOOST_REQUIRE_EQUAL(set.size(), 2u);
+    BOOST_REQUIRE_EQUAL(set.balance(), 400u);
+
+    // Reloading replaces the outputs of the key.
+    set.load(watched_key, { make_row(2, 300, false) });
+    BOOST_REQUIRE_EQUAL(set.size(), 1u);
+    BOOST_REQUIRE_EQUAL(set.balance(), 300u);
+}
+
+BOOST_AUTO_TEST_CASE(unspent_set__handle_transaction__spend_and_receive__updated)
+{
+    unspent_set set;
+    set.load(watched_key, { make_row(0, 100, false), make_row(1, 200, false) });
+
+    const chain::transaction tx
+    {
+        1, 0,
+        { { { funding_hash, 0 }, {}, 0 } },
+        { { 50, watched_script }, { 40, chain::script{ { 0x52 }, false } } }
+    };
+
+    set.handle_transaction(tx);
+    BOOST_REQUIRE_EQUAL(set.size(), 2u);
+    BOOST_REQUIRE_EQUAL(set.balance(), 250u);
+    BOOST_REQUIRE(set.handle_update(watched_key, tx.hash()));
+    BOOST_REQUIRE(!set.handle_update(watched_key, sha256_hash({ 0x44 })));
+
+    size_t height = 0;
+    BOOST_REQUIRE(set.height({ tx.hash(), 0 }, height));
+    BOOST_REQUIRE_EQUAL(height, unspent_set::unconfirmed);
+
+    set.handle_block(12, { {}, { tx } });
+    BOOST_REQUIRE(set.height({ tx.hash(), 0 }, height));
+    BOOST_REQUIRE_EQUAL(height, 12u);
+    BOOST_REQUIRE_EQUAL(set.size(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(unspent_set__select__sufficient__selected)
+{
+    unspent_set set;
+    set.load(watched_key, { make_row(0, 100, false), make_row(1, 200, false) });
+
+    chain::points_value selected;
+    set.select(selected, 250);
+    BOOST_REQUIRE_GE(selected.value(), 250u);
+
+    BOOST_REQUIRE(set.unload(watched_key));
+    BOOST_REQUIRE_EQUAL(set.size(), 0u);
+    BOOST_REQUIRE_EQUAL(set.balance(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(unspent_set__select__after_updates__exact_match)
+{
+    unspent_set set;
+    set.load(watched_key, { make_row(0, 100, false), make_row(1, 0, false),
+        make_row(2, 300, false), make_row(3, 100, false),
+        make_row(4, 700, false) });
+
+    // Spending moves the last output into the vacated position.
+    const chain::transaction tx
+    {
+        1, 0,
+        { { { funding_hash, 0 }, {}, 0 }, { { funding_hash, 2 }, {}, 0 } },
+        { { 250, watched_script } }
+    };
+
+    set.handle_transaction(tx);
+    BOOST_REQUIRE_EQUAL(set.size(), 4u);
+    BOOST_REQUIRE_EQUAL(set.balance(), 1050u);
+
+    chain::points_value selected;
+    BOOST_REQUIRE(set.select(selected, 350, 0, asio::milliseconds(100)));
+    BOOST_REQUIRE_EQUAL(selected.value(), 350u);
+    BOOST_REQUIRE_EQUAL(selected.points.size(), 2u);
+
+    BOOST_REQUIRE(set.select(selected, 1050, 0, asio::milliseconds(100)));
+    BOOST_REQUIRE_EQUAL(selected.points.size(), 3u);
+    BOOST_REQUIRE(!set.select(selected, 1051, 0, asio::milliseconds(100)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()